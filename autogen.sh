@@ -1,7 +1,8 @@
 #!/bin/sh
 
+libtoolize --copy
 #aclocal
 aclocal -I /usr/local/share/aclocal
-automake --add-missing --copy
 autoheader
+automake --add-missing --copy
 autoconf
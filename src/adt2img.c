@@ -26,11 +26,13 @@
 #    include "config.h"
 #endif
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "depack_adt.h"
+#include "detect.h"
 #include "file_functions.h"
 #include "param.h"
+#include "applets.h"
 
 /*--- Defines ---*/
 
@@ -43,22 +45,30 @@
 #define ADT_DEPACKED_TIM 1 /* tim image, saved as is */
 #define ADT_DEPACKED_UNK 2 /* other type, saved as raw */
 
-/*--- Variables ---*/
+/*--- Functions prototypes ---*/
 
-/* Keep ADT raw images depacked as is
+/* noreorg: keep ADT raw images depacked as is
  * Some RE2 PC versions do not organize them as 256x256 block+64x128 blocks
  */
-static int noreorg = 0;
-
-/*--- Functions prototypes ---*/
-
-int convert_image(const char* filename, const char* outputName, int offset);
+static int convert_image(
+    applet_context_t* ctxt, const char* filename, const char* outputName, int offset, int noreorg);
 
 /*--- Functions ---*/
 
+#ifndef MULTICALL
 int main(int argc, char** argv) {
+    return adt2img_main(argc, argv);
+}
+#endif
+
+int adt2img_main(int argc, char** argv) {
+    return adt2img_main_ctxt(NULL, argc, argv);
+}
+
+int adt2img_main_ctxt(applet_context_t* ctxt, int argc, char** argv) {
     int retval;
     int offset = -1;
+    int noreorg = 0;
 
     const char* output = "output";
     const char* adt = "input.adt";
@@ -93,55 +103,56 @@ int main(int argc, char** argv) {
         offset = atoi(argv[offset + 1]);
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Can not initialize SDL: %s\n", SDL_GetError());
-        return 1;
-    }
-    atexit(SDL_Quit);
-
-    retval = convert_image(adt, output, offset);
+    retval = convert_image(ctxt, adt, output, offset, noreorg);
 
-    SDL_Quit();
     return retval;
 }
 
-int convert_image(const char* filename, const char* outputName, int offset) {
+static int convert_image(
+    applet_context_t* ctxt, const char* filename, const char* outputName, int offset, int noreorg) {
     Uint8* dstBuffer = NULL;
-    int dstBufLen = 0;
+    size_t dstBufLen = 0;
     int retval = 1;
 
-    FILE* src = fopen(filename, "rb");
+    rw_t* src = rw_from_file(filename, "rb");
     if (!src) {
         printf("Can not open %s for reading\n", filename);
         return retval;
     }
 
     if (offset > 0) {
-        fseek(src, offset, SEEK_SET);
+        rw_seek(src, offset, RW_SEEK_SET);
     }
 
-    adt_depack(src, &dstBuffer, &dstBufLen);
-    fclose(src);
+    if (ctxt && !ctxt->adt) {
+        ctxt->adt = adt_context_create();
+    }
+    if (ctxt && ctxt->adt) {
+        adt_depack_ctxt(ctxt->adt, src, &dstBuffer, &dstBufLen);
+    } else {
+        adt_depack(src, &dstBuffer, &dstBufLen);
+    }
+    rw_close(src);
 
-    printf("Read %d bytes from blocks\n", dstBufLen);
+    printf("Read %" PRIu64 " bytes from blocks\n", (Uint64) dstBufLen);
 
     Uint32* tmpBufferPtr = (Uint32*) dstBuffer;
-    Uint32 missingBytes = dstBufLen;
+    size_t missingBytes = dstBufLen;
     while (missingBytes >= 2) {
         /*
         if (dstBufLen == 320 * 256 * 2) {
           Uint32* tmp = (Uint32*)dstBuffer;
-          Uint32 offset = SDL_SwapLE32(tmp[0]);
+          Uint32 offset = rw_swap_le32(tmp[0]);
 
           if (offset < dstBufLen) {
             // Search header for TIM image
             offset >>= 2;
-            if (SDL_SwapLE32(tmp[offset]) != MAGIC_TIM) {
+            if (rw_swap_le32(tmp[offset]) != MAGIC_TIM) {
               img_type = ADT_DEPACKED_RAW;
             }
-            else if ((SDL_SwapLE32(tmp[offset + 1]) != TIM_TYPE_4)
-              && (SDL_SwapLE32(tmp[offset + 1]) != TIM_TYPE_8)
-              && (SDL_SwapLE32(tmp[offset + 1]) != TIM_TYPE_16))
+            else if ((rw_swap_le32(tmp[offset + 1]) != TIM_TYPE_4)
+              && (rw_swap_le32(tmp[offset + 1]) != TIM_TYPE_8)
+              && (rw_swap_le32(tmp[offset + 1]) != TIM_TYPE_16))
             {
               img_type = ADT_DEPACKED_RAW;
             }
@@ -152,27 +163,42 @@ int convert_image(const char* filename, const char* outputName, int offset) {
         }
         */
 
-        int img_type = ADT_DEPACKED_UNK;
-        if (SDL_SwapLE32(tmpBufferPtr[0]) == MAGIC_TIM &&
-            (SDL_SwapLE32(tmpBufferPtr[1]) == TIM_TYPE_4 || SDL_SwapLE32(tmpBufferPtr[1]) == TIM_TYPE_8 ||
-                SDL_SwapLE32(tmpBufferPtr[1]) == TIM_TYPE_16)) {
+        int img_type = ADT_DEPACKED_RAW;
+        if (detect_format((Uint8*) tmpBufferPtr, missingBytes, missingBytes, NULL) == DETECT_TIM) {
             img_type = ADT_DEPACKED_TIM;
-        } else {
-            img_type = ADT_DEPACKED_RAW;
         }
 
         switch (img_type) {
         case ADT_DEPACKED_RAW: {
             /* Raw image, save as BMP */
             printf("Saving depacked raw at %d\n", (Uint32) tmpBufferPtr - (Uint32) dstBuffer);
-            SDL_Surface* image = adt_surface((Uint16*) tmpBufferPtr, noreorg ^ 1);
-            if (image) {
-                save_bmp(outputName, image);
-                SDL_FreeSurface(image);
+            Uint16* reorg = NULL;
+            bmp_image_t image;
+
+            memset(&image, 0, sizeof(image));
+            image.width = 320;
+            image.height = 240;
+            image.format = BMP_PS1_15;
+            image.pixels = (Uint8*) tmpBufferPtr;
+            image.pitch = 320 * 2;
+            if (!noreorg) {
+                reorg = (Uint16*) malloc(320 * 240 * 2);
+                if (reorg) {
+                    adt_reorganize((Uint16*) tmpBufferPtr, reorg);
+                }
+                image.pixels = (Uint8*) reorg;
+            }
+
+            if (image.pixels) {
+                save_bmp(outputName, &image);
+                free(reorg);
 
                 retval = 0;
                 tmpBufferPtr += ((256 * 256 * 2) + (128 * 128 * 2)) / 4;
                 missingBytes -= ((256 * 256 * 2) + (128 * 128 * 2));
+            } else {
+                fprintf(stderr, "Can not allocate memory for image\n");
+                missingBytes = 0;
             }
         } break;
         case ADT_DEPACKED_TIM: {
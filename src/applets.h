@@ -0,0 +1,71 @@
+/*
+    Entry points of tools
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef APPLETS_H
+#define APPLETS_H
+
+/*
+    Each tool is built alone with a main() calling its entry point, or
+    with MULTICALL defined, in the reevengi binary. convert is only built
+    in reevengi.
+*/
+
+/*--- Types ---*/
+
+/*
+    Depacker contexts of a thread running batch jobs. A tool creates the
+    ones it needs, they are reused by next jobs of the thread and destroyed
+    when it ends.
+*/
+typedef struct {
+    struct adt_context_s* adt;
+    struct pak_context_s* pak;
+    struct pak_pack_context_s* pack;
+} applet_context_t;
+
+/*--- Functions ---*/
+
+/*
+    Tools using a depacker context also have an entry point taking the
+    contexts to reuse, their _main() function uses temporary ones.
+*/
+int adt2img_main_ctxt(applet_context_t* ctxt, int argc, char** argv);
+int convert_main_ctxt(applet_context_t* ctxt, int argc, char** argv);
+int file2pak_main_ctxt(applet_context_t* ctxt, int argc, char** argv);
+int pak2tim_main_ctxt(applet_context_t* ctxt, int argc, char** argv);
+
+int adt2img_main(int argc, char** argv);
+int bss2bmp_main(int argc, char** argv);
+int bsssld2tim_main(int argc, char** argv);
+int convert_main(int argc, char** argv);
+int pak2tim_main(int argc, char** argv);
+int pix2bmp_main(int argc, char** argv);
+int ptc2bmp_main(int argc, char** argv);
+int rgb2bmp_main(int argc, char** argv);
+int rofs_main(int argc, char** argv);
+int sld_main(int argc, char** argv);
+int bin_main(int argc, char** argv);
+int iso_search_main(int argc, char** argv);
+int file2pak_main(int argc, char** argv);
+int emd2xml_main(int argc, char** argv);
+int md5db_main(int argc, char** argv);
+int sig_search_main(int argc, char** argv);
+
+#endif /* APPLETS_H */
@@ -0,0 +1,992 @@
+/*
+    Detect format of files, and convert them to BMP images or XML models.
+    Directories are walked, and their files converted on several threads.
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#include "rw.h"
+#include "thread.h"
+
+#include "bmp.h"
+#include "detect.h"
+#include "depack_adt.h"
+#include "depack_pak.h"
+#include "depack_rofs.h"
+#include "depack_sld.h"
+#include "bin_index.h"
+#include "convert.h"
+#include "param.h"
+#include "applets.h"
+
+/*--- Defines ---*/
+
+/* Files up to this length are read in memory, longer ones are archives */
+#define MAX_MEMORY_LENGTH (16 << 20)
+
+#define BSS_FRAME_SIZE 0x8000 /* RE2 frames, RE3 ones are twice as long */
+
+#define SLD_HEADER_SIZE 8
+
+#define ADT_RAW_LENGTH ((256 * 256 * 2) + (128 * 128 * 2))
+
+#define MAX_THREADS 64
+#define MAX_DEPTH   32 /* Of directories */
+
+/*--- Types ---*/
+
+/* Depacker contexts are created when first needed, then reused */
+typedef struct {
+    const char* dirname; /* Output directory */
+    pak_context_t* pak;
+    adt_context_t* adt;
+    int skip_unknown; /* Walking a directory, not all files are convertible */
+} convert_context_t;
+
+typedef struct {
+    char* filename;
+    char* dirname; /* Output directory, same tree as input one */
+    char* name;    /* Output name, without extension */
+    Sint64 length;
+} walk_job_t;
+
+/* Jobs of a thread, which takes them from head, others steal from tail */
+typedef struct {
+    int* jobs;
+    int head, tail;
+    mutex_t* lock;
+} walk_queue_t;
+
+typedef struct {
+    walk_job_t* jobs;
+    int num_jobs, max_jobs;
+    walk_queue_t queues[MAX_THREADS];
+    int num_queues;
+    int retval;
+    mutex_t* lock; /* For retval */
+    struct stat output; /* Output directory, not walked if inside input one */
+} walk_context_t;
+
+typedef struct {
+    walk_context_t* walk;
+    int queue;
+} walk_thread_t;
+
+/*--- Functions prototypes ---*/
+
+static int convert_path(convert_context_t* ctxt, const char* filename, const char* name);
+static int convert_data(convert_context_t* ctxt, const char* name, int format, Uint8* data, size_t length);
+static int convert_bss(convert_context_t* ctxt, const char* name, Uint8* data, size_t length);
+static int convert_pak(convert_context_t* ctxt, const char* name, Uint8* data, size_t length);
+static int convert_sld(convert_context_t* ctxt, const char* name, Uint8* data, size_t length);
+static int convert_adt(convert_context_t* ctxt, const char* name, Uint8* data, size_t length);
+static int convert_rofs(convert_context_t* ctxt, const char* name, const char* filename);
+static int convert_bin(convert_context_t* ctxt, const char* name, const char* filename);
+static int get_name(char* name, size_t size, const char* filename, int keep_dirs);
+static int get_member_name(char* name, size_t size, const char* archive, const char* filename);
+static int name_too_long(int length, size_t size, const char* name);
+
+static int convert_dir(const char* dirname, const char* path, int count);
+static int walk_dir(walk_context_t* walk, const char* path, const char* dirname, int depth);
+static char* join_path(const char* dir, const char* name);
+static int walk_job_compare(const void* a, const void* b);
+static int walk_name_compare(const void* a, const void* b);
+static int walk_rename(walk_context_t* walk);
+static int walk_next_job(walk_context_t* walk, int queue);
+static int walk_thread(void* data);
+
+/*--- Functions ---*/
+
+int convert_main(int argc, char** argv) {
+    return convert_main_ctxt(NULL, argc, argv);
+}
+
+int convert_main_ctxt(applet_context_t* actxt, int argc, char** argv) {
+    convert_context_t ctxt;
+    struct stat st;
+    int i, count = 0, retval;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s [-o dir] [-j threads] /path/to/filename\n", argv[0]);
+        return 1;
+    }
+
+    memset(&ctxt, 0, sizeof(ctxt));
+    ctxt.dirname = ".";
+    i = param_check("-o", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        ctxt.dirname = argv[i + 1];
+        mkdir(ctxt.dirname, 0755);
+    }
+    i = param_check("-j", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        count = atoi(argv[i + 1]);
+    }
+
+    /* Parser is not cleaned up, other jobs of a batch may use it */
+    convert_init();
+
+    if ((stat(argv[argc - 1], &st) == 0) && S_ISDIR(st.st_mode)) {
+        return convert_dir(ctxt.dirname, argv[argc - 1], count);
+    }
+
+    /* Depackers of a batch thread are kept for its next jobs */
+    if (actxt) {
+        ctxt.pak = actxt->pak;
+        ctxt.adt = actxt->adt;
+    }
+
+    retval = convert_path(&ctxt, argv[argc - 1], NULL);
+
+    if (actxt) {
+        actxt->pak = ctxt.pak;
+        actxt->adt = ctxt.adt;
+    } else {
+        pak_context_destroy(ctxt.pak);
+        adt_context_destroy(ctxt.adt);
+    }
+
+    return retval;
+}
+
+/*
+    Read start of file, or whole file if short, to detect its format.
+    Output name is got from filename if NULL.
+*/
+static int convert_path(convert_context_t* ctxt, const char* filename, const char* name) {
+    rw_t* src;
+    Uint8* data;
+    Sint64 length;
+    size_t avail;
+    char file_name[512];
+    int format, retval = 1;
+
+    src = rw_from_file(filename, "rb");
+    if (!src) {
+        fprintf(stderr, "Can not open %s for reading\n", filename);
+        return retval;
+    }
+
+    length = rw_seek(src, 0, RW_SEEK_END);
+    rw_seek(src, 0, RW_SEEK_SET);
+    if (length <= 0) {
+        rw_close(src);
+        if (ctxt->skip_unknown) {
+            return 0;
+        }
+        fprintf(stderr, "%s: empty file\n", filename);
+        return retval;
+    }
+
+    avail = (length <= MAX_MEMORY_LENGTH ? (size_t) length : DETECT_WINDOW);
+    data = (Uint8*) malloc(avail);
+    if (!data) {
+        fprintf(stderr, "Can not allocate %" PRIu64 " bytes in memory\n", (Uint64) avail);
+        rw_close(src);
+        return retval;
+    }
+    if (rw_read(src, data, avail, 1) != 1) {
+        fprintf(stderr, "Can not read %s\n", filename);
+        free(data);
+        rw_close(src);
+        return retval;
+    }
+    rw_close(src);
+
+    format = detect_format(data, avail, length, filename);
+    if (format != DETECT_UNKNOWN) {
+        printf("%s: %s\n", filename, detect_name(format));
+    }
+
+    if (!name) {
+        if (get_name(file_name, sizeof(file_name), filename, 0)) {
+            free(data);
+            return retval;
+        }
+        name = file_name;
+    }
+    switch (format) {
+    case DETECT_ROFS:
+        retval = convert_rofs(ctxt, name, filename);
+        break;
+    case DETECT_BIN:
+        retval = convert_bin(ctxt, name, filename);
+        break;
+    case DETECT_UNKNOWN:
+        if (ctxt->skip_unknown) {
+            retval = 0;
+            break;
+        }
+        fprintf(stderr, "%s: unknown format\n", filename);
+        break;
+    default:
+        if ((Sint64) avail < length) {
+            fprintf(stderr, "%s: file too long\n", filename);
+            break;
+        }
+        retval = convert_data(ctxt, name, format, data, avail);
+        break;
+    }
+
+    free(data);
+    return retval;
+}
+
+/* Formats which can be converted from memory */
+static int convert_data(convert_context_t* ctxt, const char* name, int format, Uint8* data, size_t length) {
+    if (length > 0xffffffffUL) {
+        return 1;
+    }
+
+    switch (format) {
+    case DETECT_TIM:
+        return convert_file(ctxt->dirname, name, CONVERT_TIM, data, (Uint32) length);
+    case DETECT_EMD1:
+    case DETECT_EMD2:
+    case DETECT_EMD3:
+        return convert_file(ctxt->dirname, name, CONVERT_EMD, data, (Uint32) length);
+    case DETECT_BSS:
+        return convert_bss(ctxt, name, data, length);
+    case DETECT_PAK:
+        return convert_pak(ctxt, name, data, length);
+    case DETECT_SLD:
+        return convert_sld(ctxt, name, data, length);
+    case DETECT_ADT:
+        return convert_adt(ctxt, name, data, length);
+    }
+
+    fprintf(stderr, "%s: %s files can not be converted from an archive\n", name, detect_name(format));
+    return 1;
+}
+
+/* Each frame starts at a multiple of BSS_FRAME_SIZE */
+static int convert_bss(convert_context_t* ctxt, const char* name, Uint8* data, size_t length) {
+    char frame_name[512];
+    size_t offset;
+    int frame = 0, retval = 0;
+
+    for (offset = 0; offset < length; offset += BSS_FRAME_SIZE) {
+        if (detect_format(&data[offset], length - offset, length - offset, NULL) != DETECT_BSS) {
+            continue;
+        }
+
+        if (name_too_long(snprintf(frame_name, sizeof(frame_name), "%s_%03d", name, frame++),
+                sizeof(frame_name), name)) {
+            retval = 1;
+            continue;
+        }
+        if (convert_file(ctxt->dirname, frame_name, CONVERT_BSS, &data[offset], (Uint32) (length - offset))) {
+            retval = 1;
+        }
+    }
+
+    return retval;
+}
+
+/* Depacked to a TIM image */
+static int convert_pak(convert_context_t* ctxt, const char* name, Uint8* data, size_t length) {
+    rw_t* src;
+    Uint8* dstBuffer;
+    size_t dstBufLen;
+    int retval = 1;
+
+    if (!ctxt->pak) {
+        ctxt->pak = pak_context_create();
+        if (!ctxt->pak) {
+            fprintf(stderr, "Can not allocate memory for depacker\n");
+            return retval;
+        }
+    }
+
+    src = rw_from_mem(data, length);
+    if (!src) {
+        return retval;
+    }
+    pak_depack_ctxt(ctxt->pak, src, &dstBuffer, &dstBufLen);
+    rw_close(src);
+
+    if (dstBuffer && dstBufLen) {
+        retval = convert_file(ctxt->dirname, name, CONVERT_TIM, dstBuffer, (Uint32) dstBufLen);
+    } else {
+        fprintf(stderr, "%s: error depacking file\n", name);
+    }
+    free(dstBuffer);
+
+    return retval;
+}
+
+/* Each file of archive is depacked to a TIM image */
+static int convert_sld(convert_context_t* ctxt, const char* name, Uint8* data, size_t length) {
+    char file_name[512];
+    size_t offset = 0;
+    int i = 0, retval = 0;
+
+    while (offset + SLD_HEADER_SIZE <= length) {
+        const Uint8* header = &data[offset];
+        Uint32 fileLen = header[4] | (header[5] << 8) | (header[6] << 16) | ((Uint32) header[7] << 24);
+
+        if (fileLen) {
+            Uint8* dstBuffer;
+            size_t dstBufLen, srcLen;
+
+            if (fileLen < SLD_HEADER_SIZE) {
+                fprintf(stderr, "%s: file %d: invalid length\n", name, i);
+                return 1;
+            }
+
+            /* Last file may be truncated */
+            srcLen = fileLen - SLD_HEADER_SIZE;
+            if (fileLen > length - offset) {
+                srcLen = length - offset - SLD_HEADER_SIZE;
+            }
+
+            sld_depack_mem(&data[offset + SLD_HEADER_SIZE], srcLen, &dstBuffer, &dstBufLen);
+            if (dstBuffer && dstBufLen) {
+                if (name_too_long(snprintf(file_name, sizeof(file_name), "%s_%02x", name, i),
+                        sizeof(file_name), name)
+                    || convert_file(ctxt->dirname, file_name, CONVERT_TIM, dstBuffer, (Uint32) dstBufLen)) {
+                    retval = 1;
+                }
+            } else {
+                fprintf(stderr, "%s: file %d: can not depack\n", name, i);
+                retval = 1;
+            }
+            free(dstBuffer);
+        }
+
+        /* Next file */
+        offset += (fileLen ? fileLen : SLD_HEADER_SIZE);
+        i++;
+    }
+
+    return retval;
+}
+
+/* Raw 16 bits images, saved as BMP, or TIM images */
+static int convert_adt(convert_context_t* ctxt, const char* name, Uint8* data, size_t length) {
+    rw_t* src;
+    Uint8 *dstBuffer, *image_data;
+    size_t dstBufLen, offset = 0;
+    char image_name[512], bmp_name[512];
+    int i = 0, name_length, retval = 0;
+
+    if (!ctxt->adt) {
+        ctxt->adt = adt_context_create();
+        if (!ctxt->adt) {
+            fprintf(stderr, "Can not allocate memory for depacker\n");
+            return 1;
+        }
+    }
+
+    src = rw_from_mem(data, length);
+    if (!src) {
+        return 1;
+    }
+    adt_depack_ctxt(ctxt->adt, src, &dstBuffer, &dstBufLen);
+    rw_close(src);
+
+    if (!dstBuffer || !dstBufLen) {
+        fprintf(stderr, "%s: error depacking file\n", name);
+        free(dstBuffer);
+        return 1;
+    }
+
+    while (offset < dstBufLen) {
+        image_data = &dstBuffer[offset];
+
+        if (i == 0) {
+            name_length = snprintf(image_name, sizeof(image_name), "%s", name);
+        } else {
+            name_length = snprintf(image_name, sizeof(image_name), "%s_%d", name, i);
+        }
+        i++;
+        if (name_too_long(name_length, sizeof(image_name), name)) {
+            retval = 1;
+            break;
+        }
+
+        if (detect_format(image_data, dstBufLen - offset, dstBufLen - offset, NULL) == DETECT_TIM) {
+            if (convert_file(ctxt->dirname, image_name, CONVERT_TIM, image_data, (Uint32) (dstBufLen - offset))) {
+                retval = 1;
+            }
+            break;
+        }
+        if (dstBufLen - offset < ADT_RAW_LENGTH) {
+            break;
+        }
+
+        /* 256x256 block, then 64x128 blocks */
+        {
+            Uint16* reorg;
+            bmp_image_t image;
+
+            reorg = (Uint16*) malloc(320 * 240 * 2);
+            if (!reorg) {
+                fprintf(stderr, "Can not allocate memory for image\n");
+                retval = 1;
+                break;
+            }
+            adt_reorganize((Uint16*) image_data, reorg);
+
+            memset(&image, 0, sizeof(image));
+            image.width = 320;
+            image.height = 240;
+            image.format = BMP_PS1_15;
+            image.pixels = (Uint8*) reorg;
+            image.pitch = 320 * 2;
+
+            if (name_too_long(
+                    snprintf(bmp_name, sizeof(bmp_name), "%s/%s.bmp", ctxt->dirname, image_name),
+                    sizeof(bmp_name), image_name)) {
+                retval = 1;
+            } else if (bmp_save(bmp_name, &image)) {
+                fprintf(stderr, "%s: can not convert\n", image_name);
+                retval = 1;
+            }
+            free(reorg);
+        }
+        offset += ADT_RAW_LENGTH;
+    }
+
+    free(dstBuffer);
+    return retval;
+}
+
+/* Files are read depacked from archive, then converted by their format */
+static int convert_rofs(convert_context_t* ctxt, const char* name, const char* filename) {
+    rofs_t* rofs;
+    char file_name[512];
+    int i, format, retval = 0;
+
+    rofs = rofs_open(filename);
+    if (!rofs) {
+        return 1;
+    }
+
+    for (i = 0; i < rofs_num_files(rofs); i++) {
+        rofs_file_t* file = rofs_file(rofs, i);
+        const char* entry_name;
+        Uint32 length;
+        Uint8* data;
+
+        if (!file || (rofs_file_length(file) == 0)) {
+            continue;
+        }
+        entry_name = rofs_file_name(file);
+        length = rofs_file_length(file);
+
+        data = (Uint8*) malloc(length);
+        if (!data) {
+            fprintf(stderr, "Can not allocate %d bytes in memory\n", length);
+            retval = 1;
+            continue;
+        }
+        if (rofs_read(file, 0, data, length) != length) {
+            fprintf(stderr, "%s: can not read\n", entry_name);
+            retval = 1;
+            free(data);
+            continue;
+        }
+
+        format = detect_format(data, length, length, entry_name);
+        if (format != DETECT_UNKNOWN) {
+            printf("%s/%s: %s\n", filename, entry_name, detect_name(format));
+
+            if (get_member_name(file_name, sizeof(file_name), name, entry_name)
+                || convert_data(ctxt, file_name, format, data, length)) {
+                retval = 1;
+            }
+        }
+        free(data);
+    }
+
+    rofs_close(rofs);
+    return retval;
+}
+
+/* Files follow their header, named from it or from their offset */
+static int convert_bin(convert_context_t* ctxt, const char* name, const char* filename) {
+    bin_index_t* index;
+    rw_t* src;
+    char file_name[512];
+    int i, format, too_long, retval = 0;
+
+    index = bin_index_open(filename);
+    if (!index) {
+        return 1;
+    }
+    src = rw_from_file(filename, "rb");
+    if (!src) {
+        fprintf(stderr, "Can not open %s for reading\n", filename);
+        bin_index_close(index);
+        return 1;
+    }
+
+    for (i = 0; i < index->num_entries; i++) {
+        bin_entry_t* entry = &index->entries[i];
+        const char* entry_name = bin_index_name(index, i);
+        Uint8* data;
+
+        data = (Uint8*) malloc(entry->length);
+        if (!data) {
+            fprintf(stderr, "Can not allocate %d bytes in memory\n", entry->length);
+            retval = 1;
+            continue;
+        }
+        rw_seek(src, entry->offset + BIN_HEADER_SIZE, RW_SEEK_SET);
+        if (rw_read(src, data, entry->length, 1) != 1) {
+            fprintf(stderr, "%s: can not read\n", entry_name);
+            retval = 1;
+            free(data);
+            continue;
+        }
+
+        format = detect_format(data, entry->length, entry->length, entry_name);
+        if (format != DETECT_UNKNOWN) {
+            if (entry_name[0]) {
+                too_long = get_member_name(file_name, sizeof(file_name), name, entry_name);
+            } else {
+                too_long = name_too_long(snprintf(file_name, sizeof(file_name), "%s_%08" PRIx64,
+                                             name, (Uint64) entry->offset),
+                    sizeof(file_name), name);
+            }
+            if (too_long) {
+                retval = 1;
+                free(data);
+                continue;
+            }
+            printf("%s/%s: %s\n", filename, (entry_name[0] ? entry_name : file_name),
+                detect_name(format));
+
+            if (convert_data(ctxt, file_name, format, data, entry->length)) {
+                retval = 1;
+            }
+        }
+        free(data);
+    }
+
+    rw_close(src);
+    bin_index_close(index);
+    return retval;
+}
+
+/*
+    Name of converted file, without extension. Directories of files in
+    archives are kept, separated by '_'. Returns non zero if too long.
+*/
+static int get_name(char* name, size_t size, const char* filename, int keep_dirs) {
+    const char* start = filename;
+    char* dot;
+    size_t i;
+
+    if (!keep_dirs) {
+        const char* c;
+
+        for (c = filename; *c; c++) {
+            if ((*c == '/') || (*c == '\\')) {
+                start = c + 1;
+            }
+        }
+    }
+
+    if (name_too_long(snprintf(name, size, "%s", start), size, start)) {
+        return 1;
+    }
+    for (i = 0; name[i]; i++) {
+        if ((name[i] == '/') || (name[i] == '\\') || (name[i] == ':')) {
+            name[i] = '_';
+        }
+    }
+
+    dot = strrchr(name, '.');
+    if (dot && (dot != name)) {
+        *dot = '\0';
+    }
+    return 0;
+}
+
+/*
+    Name of converted file of an archive, after name of archive, so files
+    of several archives converted to same directory do not clash.
+*/
+static int get_member_name(char* name, size_t size, const char* archive, const char* filename) {
+    char file_name[512];
+
+    if (get_name(file_name, sizeof(file_name), filename, 1)) {
+        return 1;
+    }
+    return name_too_long(snprintf(name, size, "%s_%s", archive, file_name), size, file_name);
+}
+
+/* Report a name which did not fit, from length returned by snprintf() */
+static int name_too_long(int length, size_t size, const char* name) {
+    if ((length >= 0) && (length < (int) size)) {
+        return 0;
+    }
+
+    fprintf(stderr, "%s: name too long\n", name);
+    return 1;
+}
+
+/*--- Directories ---*/
+
+/*
+    Files of directory tree are sorted from the longest to the shortest,
+    then dealt to threads in this order, so long files do not start last
+    and leave other threads waiting. Threads with no more files steal the
+    shortest ones left to others.
+*/
+static int convert_dir(const char* dirname, const char* path, int count) {
+    walk_context_t walk;
+    walk_thread_t params[MAX_THREADS];
+    thread_t* threads[MAX_THREADS];
+    int i, num_threads;
+
+    memset(&walk, 0, sizeof(walk));
+    walk.lock = mutex_create();
+    if (!walk.lock) {
+        fprintf(stderr, "Can not create mutex\n");
+        return 1;
+    }
+
+    if (stat(dirname, &walk.output) != 0) {
+        fprintf(stderr, "Can not open directory %s\n", dirname);
+        walk.retval = 1;
+        goto error;
+    }
+    if (walk_dir(&walk, path, dirname, 0) || walk_rename(&walk)) {
+        walk.retval = 1;
+        goto error;
+    }
+    if (walk.num_jobs == 0) {
+        goto error;
+    }
+    qsort(walk.jobs, walk.num_jobs, sizeof(walk_job_t), walk_job_compare);
+
+    if (count <= 0) {
+        count = cpu_count();
+    }
+    if (count > MAX_THREADS) {
+        count = MAX_THREADS;
+    }
+    if (count > walk.num_jobs) {
+        count = walk.num_jobs;
+    }
+
+    for (i = 0; i < count; i++) {
+        walk_queue_t* queue = &walk.queues[i];
+
+        queue->jobs = (int*) malloc(((walk.num_jobs + count - 1) / count) * sizeof(int));
+        queue->lock = mutex_create();
+        if (!queue->jobs || !queue->lock) {
+            fprintf(stderr, "Can not allocate memory for threads\n");
+            free(queue->jobs);
+            mutex_destroy(queue->lock);
+            walk.retval = 1;
+            goto error;
+        }
+        ++walk.num_queues;
+    }
+    for (i = 0; i < walk.num_jobs; i++) {
+        walk_queue_t* queue = &walk.queues[i % count];
+
+        queue->jobs[queue->tail++] = i;
+    }
+
+    /* Jobs of threads which could not be created are stolen */
+    for (i = 0; i < count; i++) {
+        params[i].walk = &walk;
+        params[i].queue = i;
+        threads[i] = thread_create(walk_thread, &params[i]);
+        if (!threads[i]) {
+            break;
+        }
+    }
+    num_threads = i;
+
+    if (num_threads == 0) {
+        walk_thread(&params[0]);
+    }
+    for (i = 0; i < num_threads; i++) {
+        thread_wait(threads[i]);
+    }
+
+error:
+    for (i = 0; i < walk.num_queues; i++) {
+        free(walk.queues[i].jobs);
+        mutex_destroy(walk.queues[i].lock);
+    }
+    for (i = 0; i < walk.num_jobs; i++) {
+        free(walk.jobs[i].filename);
+        free(walk.jobs[i].dirname);
+        free(walk.jobs[i].name);
+    }
+    free(walk.jobs);
+    mutex_destroy(walk.lock);
+
+    return walk.retval;
+}
+
+/*
+    Add files as jobs, create output directory once input one is opened.
+    Output directory is skipped if it is inside input one, and links to
+    directories, which may loop. A directory which can not be walked is
+    reported, others are walked anyway. Returns non zero if out of memory.
+*/
+static int walk_dir(walk_context_t* walk, const char* path, const char* dirname, int depth) {
+    DIR* dir;
+    struct dirent* entry;
+    int retval = 0;
+
+    if (depth >= MAX_DEPTH) {
+        fprintf(stderr, "%s: too many levels of directories\n", path);
+        walk->retval = 1;
+        return 0;
+    }
+
+    dir = opendir(path);
+    if (!dir) {
+        fprintf(stderr, "Can not open directory %s\n", path);
+        walk->retval = 1;
+        return 0;
+    }
+    if (depth > 0) {
+        mkdir(dirname, 0755);
+    }
+
+    while (!retval && (entry = readdir(dir))) {
+        struct stat st;
+        char *filename, *subdir;
+        char name[512];
+
+        if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) {
+            continue;
+        }
+
+        filename = join_path(path, entry->d_name);
+        if (!filename) {
+            retval = 1;
+            break;
+        }
+        if (stat(filename, &st) != 0) {
+            free(filename);
+            continue;
+        }
+
+        if (S_ISDIR(st.st_mode)) {
+            if (((st.st_dev == walk->output.st_dev) && (st.st_ino == walk->output.st_ino))
+                || (lstat(filename, &st) != 0) || S_ISLNK(st.st_mode)) {
+                free(filename);
+                continue;
+            }
+
+            subdir = join_path(dirname, entry->d_name);
+            if (!subdir) {
+                free(filename);
+                retval = 1;
+                break;
+            }
+            retval = walk_dir(walk, filename, subdir, depth + 1);
+            free(subdir);
+            free(filename);
+            continue;
+        }
+
+        if (!S_ISREG(st.st_mode) || (st.st_size == 0)) {
+            free(filename);
+            continue;
+        }
+        if (get_name(name, sizeof(name), entry->d_name, 0)) {
+            free(filename);
+            walk->retval = 1;
+            continue;
+        }
+
+        if (walk->num_jobs == walk->max_jobs) {
+            walk_job_t* jobs;
+
+            walk->max_jobs = (walk->max_jobs ? walk->max_jobs * 2 : 256);
+            jobs = (walk_job_t*) realloc(walk->jobs, walk->max_jobs * sizeof(walk_job_t));
+            if (!jobs) {
+                fprintf(stderr, "Can not allocate memory for jobs\n");
+                free(filename);
+                retval = 1;
+                break;
+            }
+            walk->jobs = jobs;
+        }
+
+        walk->jobs[walk->num_jobs].filename = filename;
+        walk->jobs[walk->num_jobs].dirname = strdup(dirname);
+        walk->jobs[walk->num_jobs].name = strdup(name);
+        walk->jobs[walk->num_jobs].length = st.st_size;
+        if (!walk->jobs[walk->num_jobs].dirname || !walk->jobs[walk->num_jobs].name) {
+            fprintf(stderr, "Can not allocate memory for jobs\n");
+            free(walk->jobs[walk->num_jobs].dirname);
+            free(walk->jobs[walk->num_jobs].name);
+            free(filename);
+            retval = 1;
+            break;
+        }
+        ++walk->num_jobs;
+    }
+
+    closedir(dir);
+    return retval;
+}
+
+static char* join_path(const char* dir, const char* name) {
+    size_t length = strlen(dir) + 1 + strlen(name) + 1;
+    char* path = (char*) malloc(length);
+
+    if (!path) {
+        fprintf(stderr, "Can not allocate memory for %s\n", name);
+        return NULL;
+    }
+    snprintf(path, length, "%s/%s", dir, name);
+    return path;
+}
+
+/* Longest files first, then by name to convert in same order each time */
+static int walk_job_compare(const void* a, const void* b) {
+    const walk_job_t* job1 = (const walk_job_t*) a;
+    const walk_job_t* job2 = (const walk_job_t*) b;
+
+    if (job1->length != job2->length) {
+        return (job1->length < job2->length ? 1 : -1);
+    }
+    return strcmp(job1->filename, job2->filename);
+}
+
+/* Same output directory and name */
+static int walk_name_compare(const void* a, const void* b) {
+    const walk_job_t* job1 = (const walk_job_t*) a;
+    const walk_job_t* job2 = (const walk_job_t*) b;
+    int retval;
+
+    retval = strcmp(job1->dirname, job2->dirname);
+    if (retval == 0) {
+        retval = strcmp(job1->name, job2->name);
+    }
+    return retval;
+}
+
+/*
+    Files of a directory with same name but another extension, like x.tim
+    and x.pak, would be converted to same file. They keep their extension
+    in output name, as x_tim and x_pak.
+*/
+static int walk_rename(walk_context_t* walk) {
+    int i, j;
+
+    qsort(walk->jobs, walk->num_jobs, sizeof(walk_job_t), walk_name_compare);
+
+    for (i = 0; i < walk->num_jobs; i = j) {
+        for (j = i + 1; j < walk->num_jobs; j++) {
+            if (walk_name_compare(&walk->jobs[i], &walk->jobs[j]) != 0) {
+                break;
+            }
+        }
+        if (j - i == 1) {
+            continue;
+        }
+
+        for (; i < j; i++) {
+            walk_job_t* job = &walk->jobs[i];
+            const char* ext = strrchr(job->filename, '.');
+            const char* sep = strrchr(job->filename, '/');
+            size_t length;
+            char* name;
+
+            /* No extension, or file starting with a dot */
+            if (!ext || !sep || (ext <= sep + 1)) {
+                continue;
+            }
+
+            length = strlen(job->name) + strlen(ext) + 1;
+            name = (char*) malloc(length);
+            if (!name) {
+                fprintf(stderr, "Can not allocate memory for %s\n", job->filename);
+                return 1;
+            }
+            snprintf(name, length, "%s_%s", job->name, ext + 1);
+            free(job->name);
+            job->name = name;
+        }
+    }
+
+    return 0;
+}
+
+/* Returns next job from own queue, or stolen from another one, -1 if none left */
+static int walk_next_job(walk_context_t* walk, int queue) {
+    walk_queue_t* own = &walk->queues[queue];
+    int i, job = -1;
+
+    mutex_lock(own->lock);
+    if (own->head < own->tail) {
+        job = own->jobs[own->head++];
+    }
+    mutex_unlock(own->lock);
+
+    for (i = 1; (job < 0) && (i < walk->num_queues); i++) {
+        walk_queue_t* other = &walk->queues[(queue + i) % walk->num_queues];
+
+        mutex_lock(other->lock);
+        if (other->head < other->tail) {
+            job = other->jobs[--other->tail];
+        }
+        mutex_unlock(other->lock);
+    }
+
+    return job;
+}
+
+static int walk_thread(void* data) {
+    walk_thread_t* params = (walk_thread_t*) data;
+    walk_context_t* walk = params->walk;
+    convert_context_t ctxt;
+    int job;
+
+    memset(&ctxt, 0, sizeof(ctxt));
+    ctxt.skip_unknown = 1;
+
+    while ((job = walk_next_job(walk, params->queue)) >= 0) {
+        ctxt.dirname = walk->jobs[job].dirname;
+        if (convert_path(&ctxt, walk->jobs[job].filename, walk->jobs[job].name)) {
+            mutex_lock(walk->lock);
+            walk->retval = 1;
+            mutex_unlock(walk->lock);
+        }
+    }
+
+    pak_context_destroy(ctxt.pak);
+    adt_context_destroy(ctxt.adt);
+
+    return 0;
+}
@@ -1,5 +1,5 @@
 /*
-    BIN file depacker (RE2 PS1 dat/*.bin files)
+    BIN file depacker (RE2 PS1 .BIN files of DAT directory)
 
     Copyright (C) 2010	Patrice Mandin
 
@@ -27,96 +27,313 @@
 #    include "config.h"
 #endif
 
-#include <SDL.h>
+#include "rw.h"
+#include "thread.h"
 
-#include "file_functions.h"
+#include "bin_index.h"
+#include "file_copy.h"
+#include "param.h"
+#include "applets.h"
+
+/*--- Defines ---*/
+
+#define MAX_THREADS 64
 
 /*--- Types ---*/
 
 typedef struct {
-    Uint32 id;
-    Uint32 length;
-    Uint32 blocks1;
-    Uint32 unknown1[1 + 12];
-    Uint8 filename[0x800 - 0x40];
-} bin_header_t;
+    const char* filename;
+    bin_index_t* index;
+    Uint8* renamed; /* Files named as a previous one, their offset is added to name */
+    int next_file;  /* Next file to extract */
+    int retval;     /* Set when a file could not be extracted */
+    mutex_t* lock;
+} bin_context_t;
+
+typedef struct {
+    char* name;
+    int entry;
+} bin_name_t;
 
 /*--- Const ---*/
 
 /*--- Variables ---*/
 
+/* Extract files */
+static int extract_files = 0;
+
+/* Number of threads extracting files, 0 for one per CPU */
+static int num_threads = 0;
+
 /*--- Function prototypes ---*/
 
-void list_files(const char* filename);
+static void list_files(bin_index_t* index);
+static int extract_file(bin_context_t* ctxt, int entry);
+static void get_member_name(bin_context_t* ctxt, int entry, char* filename, size_t length);
+static int find_renamed(bin_context_t* ctxt);
+static int bin_name_compare(const void* a, const void* b);
+static int compare_names(const char* name1, const char* name2);
+static int extract_all(bin_context_t* ctxt);
+static int extract_thread(void* data);
 
 /*--- Functions ---*/
 
+#ifndef MULTICALL
 int main(int argc, char** argv) {
+    return bin_main(argc, argv);
+}
+#endif
+
+int bin_main(int argc, char** argv) {
+    bin_context_t ctxt;
+    const char* single_file = NULL;
+    int i, retval = 0;
+
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s /path/to/file.bin\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-e] [-j threads] [-x name] /path/to/file.bin\n", argv[0]);
         return 1;
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Can not initialize SDL: %s\n", SDL_GetError());
+    extract_files = 0;
+    num_threads = 0;
+    if (param_check("-e", argc, argv) >= 0) {
+        extract_files = 1;
+    }
+    i = param_check("-j", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        num_threads = atoi(argv[i + 1]);
+    }
+    i = param_check("-x", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        single_file = argv[i + 1];
+    }
+
+    memset(&ctxt, 0, sizeof(ctxt));
+    ctxt.filename = argv[argc - 1];
+
+    ctxt.index = bin_index_open(ctxt.filename);
+    if (!ctxt.index) {
         return 1;
     }
-    atexit(SDL_Quit);
 
-    list_files(argv[1]);
+    if (single_file) {
+        i = bin_index_find(ctxt.index, single_file);
+        if (i < 0) {
+            fprintf(stderr, "%s: file not found\n", single_file);
+            retval = 1;
+        } else {
+            retval = extract_file(&ctxt, i);
+        }
+    } else {
+        list_files(ctxt.index);
+        if (extract_files) {
+            retval = extract_all(&ctxt);
+        }
+    }
 
-    SDL_Quit();
+    bin_index_close(ctxt.index);
+
+    return retval;
+}
+
+static void list_files(bin_index_t* index) {
+    int i;
+
+    for (i = 0; i < index->num_entries; i++) {
+        bin_entry_t* entry = &index->entries[i];
+
+        printf("Offset 0x%08" PRIx64 ", Length 0x%08x, %s\n", entry->offset, entry->length,
+            bin_index_name(index, i));
+    }
+}
+
+/* Data follows header, up to end of archive */
+static int extract_file(bin_context_t* ctxt, int entry) {
+    bin_index_t* index = ctxt->index;
+    Sint64 offset = index->entries[entry].offset + BIN_HEADER_SIZE;
+    Sint64 length = index->entries[entry].length;
+    char filename[BIN_HEADER_SIZE];
+
+    if (offset + length > index->archive_size) {
+        length = (offset < index->archive_size ? index->archive_size - offset : 0);
+    }
+    get_member_name(ctxt, entry, filename, sizeof(filename));
+
+    if (file_copy(ctxt->filename, offset, length, filename) != 0) {
+        return 1;
+    }
+    printf("Saved %s\n", filename);
     return 0;
 }
 
-void list_files(const char* filename) {
-    SDL_RWops* src;
-    bin_header_t bin_hdr;
-    Uint32 offset, bin_length;
-    /*int i;*/
+/* Files are saved in current directory, without path of header, or named
+   by offset of header */
+static void get_member_name(bin_context_t* ctxt, int entry, char* filename, size_t length) {
+    bin_index_t* index = ctxt->index;
+    const char* name = bin_index_name(index, entry);
+    const char* pos;
 
-    src = SDL_RWFromFile(filename, "rb");
-    if (!src) {
-        fprintf(stderr, "Can not open %s\n", filename);
+    pos = strrchr(name, '/');
+    if (pos) {
+        name = pos + 1;
+    }
+    pos = strrchr(name, '\\');
+    if (pos) {
+        name = pos + 1;
+    }
+
+    if ((name[0] == 0) || (strcmp(name, ".") == 0) || (strcmp(name, "..") == 0)) {
+        sprintf(filename, "%08" PRIx64 ".dat", index->entries[entry].offset);
         return;
     }
 
-    SDL_RWseek(src, 0, RW_SEEK_END);
-    bin_length = SDL_RWtell(src);
-    SDL_RWseek(src, 0, RW_SEEK_SET);
+    /* Offset is added before extension */
+    if (ctxt->renamed && ctxt->renamed[entry]) {
+        const char* ext = strrchr(name, '.');
+        int base_length = (int) (ext ? ext - name : strlen(name));
 
-    offset = 0;
-    while (offset < bin_length) {
-        /*Uint32 fileNum;*/
-        int fileLen;
+        snprintf(filename, length, "%.*s_%08" PRIx64 "%s", base_length, name, index->entries[entry].offset,
+            (ext ? ext : ""));
+        return;
+    }
+
+    strncpy(filename, name, length - 1);
+    filename[length - 1] = 0;
+}
 
-        SDL_RWread(src, &bin_hdr, sizeof(bin_header_t), 1);
-        if (SDL_SwapLE32(bin_hdr.id) == 0xffffffffUL) {
+/*
+    Files with the same name, in different directories of archive or not,
+    would be written to the same file, by several threads at once. All but
+    the first one are renamed.
+*/
+static int find_renamed(bin_context_t* ctxt) {
+    bin_name_t* names;
+    char filename[BIN_HEADER_SIZE];
+    int i, num_entries = ctxt->index->num_entries, retval = 1;
+
+    ctxt->renamed = (Uint8*) calloc(num_entries + 1, 1);
+    names = (bin_name_t*) calloc(num_entries + 1, sizeof(bin_name_t));
+    if (!ctxt->renamed || !names) {
+        fprintf(stderr, "Can not allocate memory for names of files\n");
+        free(names);
+        return 0;
+    }
+
+    for (i = 0; i < num_entries; i++) {
+        get_member_name(ctxt, i, filename, sizeof(filename));
+        names[i].name = strdup(filename);
+        names[i].entry = i;
+        if (!names[i].name) {
+            fprintf(stderr, "Can not allocate memory for names of files\n");
+            retval = 0;
             break;
         }
+    }
 
-        fileLen = SDL_SwapLE32(bin_hdr.length);
-        if (fileLen == 0) {
-            break;
+    if (retval) {
+        qsort(names, num_entries, sizeof(bin_name_t), bin_name_compare);
+        for (i = 1; i < num_entries; i++) {
+            if (compare_names(names[i - 1].name, names[i].name) == 0) {
+                ctxt->renamed[names[i].entry] = 1;
+            }
         }
+    }
+
+    for (i = 0; i < num_entries; i++) {
+        free(names[i].name);
+    }
+    free(names);
+    return retval;
+}
 
-        printf("Offset 0x%08x, Length 0x%08x, %s\n", offset, fileLen, bin_hdr.filename);
+/* Sort by name, then by position in archive */
+static int bin_name_compare(const void* a, const void* b) {
+    const bin_name_t* name_a = (const bin_name_t*) a;
+    const bin_name_t* name_b = (const bin_name_t*) b;
+    int result = compare_names(name_a->name, name_b->name);
+
+    if (result == 0) {
+        result = name_a->entry - name_b->entry;
+    }
+    return result;
+}
+
+/* Files are independent, each thread extracts the next one */
+static int extract_all(bin_context_t* ctxt) {
+    thread_t* threads[MAX_THREADS];
+    int i, count = num_threads;
+
+    if (!find_renamed(ctxt)) {
+        free(ctxt->renamed);
+        return 1;
+    }
+
+    ctxt->lock = mutex_create();
+    if (!ctxt->lock) {
+        fprintf(stderr, "Can not create mutex\n");
+        free(ctxt->renamed);
+        return 1;
+    }
 
-        /* Next file */
-        offset += SDL_SwapLE32(bin_hdr.blocks1) * 0x800;
+    if (count <= 0) {
+        count = cpu_count();
+    }
+    if (count > MAX_THREADS) {
+        count = MAX_THREADS;
+    }
+    if (count > ctxt->index->num_entries) {
+        count = ctxt->index->num_entries;
+    }
 
-        switch (SDL_SwapLE32(bin_hdr.id)) {
-        case 1:
-            offset -= 0x800;
+    for (i = 0; i < count; i++) {
+        threads[i] = thread_create(extract_thread, ctxt);
+        if (!threads[i]) {
             break;
-        case 5:
-        case 9:
-            offset += 0x800;
+        }
+    }
+    count = i;
+
+    if (count == 0) {
+        extract_thread(ctxt);
+    }
+    for (i = 0; i < count; i++) {
+        thread_wait(threads[i]);
+    }
+
+    mutex_destroy(ctxt->lock);
+    free(ctxt->renamed);
+    return ctxt->retval;
+}
+
+static int extract_thread(void* data) {
+    bin_context_t* ctxt = (bin_context_t*) data;
+
+    for (;;) {
+        int entry;
+
+        mutex_lock(ctxt->lock);
+        if (ctxt->next_file >= ctxt->index->num_entries) {
+            mutex_unlock(ctxt->lock);
             break;
         }
+        entry = ctxt->next_file++;
+        mutex_unlock(ctxt->lock);
 
-        SDL_RWseek(src, offset, RW_SEEK_SET);
+        if (extract_file(ctxt, entry)) {
+            mutex_lock(ctxt->lock);
+            ctxt->retval = 1;
+            mutex_unlock(ctxt->lock);
+        }
     }
 
-    SDL_RWclose(src);
+    return 0;
+}
+
+/* Ignore case, as filesystems may do */
+static int compare_names(const char* name1, const char* name2) {
+#ifdef WIN32
+    return _stricmp(name1, name2);
+#else
+    return strcasecmp(name1, name2);
+#endif
 }
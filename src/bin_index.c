@@ -0,0 +1,386 @@
+/*
+    Index of files of BIN archives (RE2 PS1 .BIN files of DAT directory)
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#include "rw.h"
+
+#include "bin_index.h"
+
+/*--- Defines ---*/
+
+/* Headers are read by blocks up to this size, several small files at once */
+#define INDEX_READ_SIZE (1 << 20)
+
+/* Number of files like the last one a block is sized to hold */
+#define INDEX_READ_FILES 8
+
+/* Header fields */
+#define HEADER_ID       0x00
+#define HEADER_LENGTH   0x04
+#define HEADER_BLOCKS   0x08
+#define HEADER_FILENAME 0x40
+
+/*--- Functions prototypes ---*/
+
+static char* get_index_filename(const char* filename);
+static int read_headers(bin_index_t* index, const char* filename);
+static int add_entry(bin_index_t* index, Sint64 offset, Uint32 id, Uint32 length, const char* name);
+static int load_index(bin_index_t* index, const char* filename);
+static void save_index(bin_index_t* index, const char* filename);
+static int compare_names(const char* name1, const char* name2);
+
+
+/*--- Functions ---*/
+
+bin_index_t* bin_index_open(const char* filename) {
+    bin_index_t* index;
+    struct stat st;
+
+    index = (bin_index_t*) calloc(1, sizeof(bin_index_t));
+    if (!index) {
+        fprintf(stderr, "Can not allocate memory for index\n");
+        return NULL;
+    }
+
+    if (stat(filename, &st) != 0) {
+        fprintf(stderr, "Can not open %s\n", filename);
+        free(index);
+        return NULL;
+    }
+    index->archive_size = st.st_size;
+    index->archive_mtime = st.st_mtime;
+
+    if (load_index(index, filename)) {
+        index->loaded = 1;
+        return index;
+    }
+
+    if (!read_headers(index, filename)) {
+        bin_index_close(index);
+        return NULL;
+    }
+    save_index(index, filename);
+
+    return index;
+}
+
+void bin_index_close(bin_index_t* index) {
+    if (!index) {
+        return;
+    }
+
+    free(index->entries);
+    free(index->strings);
+    free(index);
+}
+
+const char* bin_index_name(bin_index_t* index, int entry) {
+    return &index->strings[index->entries[entry].name];
+}
+
+int bin_index_find(bin_index_t* index, const char* name) {
+    int i;
+
+    for (i = 0; i < index->num_entries; i++) {
+        const char* filename = bin_index_name(index, i);
+        const char* pos;
+
+        if (compare_names(filename, name) == 0) {
+            return i;
+        }
+
+        pos = strrchr(filename, '\\');
+        if (!pos) {
+            pos = strrchr(filename, '/');
+        }
+        if (pos && (compare_names(pos + 1, name) == 0)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static char* get_index_filename(const char* filename) {
+    char* index_filename = (char*) malloc(strlen(filename) + 5);
+
+    if (index_filename) {
+        sprintf(index_filename, "%s.tsv", filename);
+    }
+    return index_filename;
+}
+
+/*
+    Headers of following small files are often in the same block. Files
+    are expected to be about as long as the last one: block is sized to
+    hold a few of them, or only the header after a long file, so data of
+    long files is not read.
+*/
+static int read_headers(bin_index_t* index, const char* filename) {
+    rw_t* src;
+    Uint8* buffer;
+    Sint64 offset = 0, buffer_offset = 0, next;
+    Sint64 last_length = INDEX_READ_SIZE;
+    size_t buffer_length = 0;
+    int retval = 1;
+
+    buffer = (Uint8*) malloc(INDEX_READ_SIZE);
+    if (!buffer) {
+        fprintf(stderr, "Can not allocate %d bytes in memory\n", INDEX_READ_SIZE);
+        return 0;
+    }
+
+    src = rw_from_file(filename, "rb");
+    if (!src) {
+        fprintf(stderr, "Can not open %s\n", filename);
+        free(buffer);
+        return 0;
+    }
+
+    while (offset + BIN_HEADER_SIZE <= index->archive_size) {
+        const Uint8* header;
+        char name[BIN_HEADER_SIZE - HEADER_FILENAME + 1];
+        Uint32 id, length, blocks;
+
+        if ((offset < buffer_offset) || (offset + BIN_HEADER_SIZE > buffer_offset + (Sint64) buffer_length)) {
+            buffer_offset = offset;
+            buffer_length = BIN_HEADER_SIZE;
+            if (last_length * INDEX_READ_FILES <= INDEX_READ_SIZE) {
+                buffer_length = (size_t) (last_length * INDEX_READ_FILES);
+            }
+            if (index->archive_size - offset < (Sint64) buffer_length) {
+                buffer_length = index->archive_size - offset;
+            }
+
+            rw_seek(src, offset, RW_SEEK_SET);
+            if (rw_read(src, buffer, buffer_length, 1) != 1) {
+                fprintf(stderr, "Can not read %s\n", filename);
+                retval = 0;
+                break;
+            }
+        }
+        header = &buffer[offset - buffer_offset];
+
+        id = rw_get_le32(&header[HEADER_ID]);
+        length = rw_get_le32(&header[HEADER_LENGTH]);
+        blocks = rw_get_le32(&header[HEADER_BLOCKS]);
+        if ((id == 0xffffffffUL) || (length == 0)) {
+            break;
+        }
+
+        memcpy(name, &header[HEADER_FILENAME], BIN_HEADER_SIZE - HEADER_FILENAME);
+        name[BIN_HEADER_SIZE - HEADER_FILENAME] = 0;
+        if (!add_entry(index, offset, id, length, name)) {
+            retval = 0;
+            break;
+        }
+
+        /* Next file */
+        next = offset + (Sint64) blocks * 0x800;
+
+        switch (id) {
+        case 1:
+            next -= 0x800;
+            break;
+        case 5:
+        case 9:
+            next += 0x800;
+            break;
+        }
+
+        if (next <= offset) {
+            break;
+        }
+        last_length = next - offset;
+        offset = next;
+    }
+
+    rw_close(src);
+    free(buffer);
+    return retval;
+}
+
+static int add_entry(bin_index_t* index, Sint64 offset, Uint32 id, Uint32 length, const char* name) {
+    bin_entry_t* entry;
+    char* strings;
+    Uint32 name_length = strlen(name) + 1;
+
+    /* Grown by powers of two */
+    if ((index->num_entries & (index->num_entries - 1)) == 0) {
+        int count = (index->num_entries ? index->num_entries * 2 : 1);
+
+        entry = (bin_entry_t*) realloc(index->entries, count * sizeof(bin_entry_t));
+        if (!entry) {
+            fprintf(stderr, "Can not allocate memory for index\n");
+            return 0;
+        }
+        index->entries = entry;
+    }
+
+    strings = (char*) realloc(index->strings, index->strings_length + name_length);
+    if (!strings) {
+        fprintf(stderr, "Can not allocate memory for index\n");
+        return 0;
+    }
+    index->strings = strings;
+    memcpy(&strings[index->strings_length], name, name_length);
+
+    entry = &index->entries[index->num_entries++];
+    entry->offset = offset;
+    entry->id = id;
+    entry->length = length;
+    entry->name = index->strings_length;
+    index->strings_length += name_length;
+
+    return 1;
+}
+
+/* Read files of a previous run, if index matches archive */
+static int load_index(bin_index_t* index, const char* filename) {
+    FILE* src;
+    char* index_filename;
+    char line[BIN_HEADER_SIZE + 64];
+    Sint64 size, mtime;
+    int version, num_files, valid;
+
+    index_filename = get_index_filename(filename);
+    if (!index_filename) {
+        return 0;
+    }
+    src = fopen(index_filename, "r");
+    free(index_filename);
+    if (!src) {
+        return 0;
+    }
+
+    valid = (fgets(line, sizeof(line), src) != NULL)
+        && (strncmp(line, BIN_INDEX_MAGIC "\t", strlen(BIN_INDEX_MAGIC) + 1) == 0)
+        && (sscanf(&line[strlen(BIN_INDEX_MAGIC) + 1], "%d\t%" SCNd64 "\t%" SCNd64 "\t%d", &version,
+                &size, &mtime, &num_files)
+            == 4)
+        && (version == BIN_INDEX_VERSION) && (size == index->archive_size)
+        && (mtime == index->archive_mtime);
+
+    while (valid && (index->num_entries < num_files)) {
+        Sint64 offset;
+        unsigned int id, length;
+        char *name, *end;
+
+        if (!fgets(line, sizeof(line), src)
+            || (sscanf(line, "%" SCNx64 "\t%u\t%u\t", &offset, &id, &length) != 3)) {
+            valid = 0;
+            break;
+        }
+
+        /* Name is last field */
+        name = strchr(line, '\t');
+        name = (name ? strchr(name + 1, '\t') : NULL);
+        name = (name ? strchr(name + 1, '\t') : NULL);
+        if (!name) {
+            valid = 0;
+            break;
+        }
+        ++name;
+        end = strchr(name, '\n');
+        if (end) {
+            *end = 0;
+        }
+
+        if ((offset < 0) || (offset + BIN_HEADER_SIZE > size)
+            || !add_entry(index, offset, id, length, name)) {
+            valid = 0;
+        }
+    }
+
+    fclose(src);
+
+    if (!valid) {
+        free(index->entries);
+        index->entries = NULL;
+        index->num_entries = 0;
+        free(index->strings);
+        index->strings = NULL;
+        index->strings_length = 0;
+        return 0;
+    }
+
+    return 1;
+}
+
+static void save_index(bin_index_t* index, const char* filename) {
+    FILE* dst;
+    char* index_filename;
+    int i, retval;
+
+    /* Names with tabs or line ends would break lines, index is not saved */
+    for (i = 0; i < index->num_entries; i++) {
+        if (strpbrk(bin_index_name(index, i), "\t\r\n")) {
+            return;
+        }
+    }
+
+    /* Directory of archive may be read only, index is then built each time */
+    index_filename = get_index_filename(filename);
+    if (!index_filename) {
+        return;
+    }
+    dst = fopen(index_filename, "w");
+    if (!dst) {
+        free(index_filename);
+        return;
+    }
+
+    retval = fprintf(dst, BIN_INDEX_MAGIC "\t%d\t%" PRId64 "\t%" PRId64 "\t%d\n",
+        BIN_INDEX_VERSION, index->archive_size, index->archive_mtime, index->num_entries);
+
+    for (i = 0; (i < index->num_entries) && (retval > 0); i++) {
+        bin_entry_t* entry = &index->entries[i];
+
+        retval = fprintf(dst, "%08" PRIx64 "\t%u\t%u\t%s\n", entry->offset, entry->id,
+            entry->length, bin_index_name(index, i));
+    }
+
+    if (fclose(dst) != 0) {
+        retval = -1;
+    }
+
+    /* A partial index would not match archive, remove it */
+    if (retval <= 0) {
+        remove(index_filename);
+    }
+    free(index_filename);
+}
+
+/* Ignore case, as filesystems may do */
+static int compare_names(const char* name1, const char* name2) {
+#ifdef WIN32
+    return _stricmp(name1, name2);
+#else
+    return strcasecmp(name1, name2);
+#endif
+}
@@ -0,0 +1,91 @@
+/*
+    Index of files of BIN archives (RE2 PS1 .BIN files of DAT directory)
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef BIN_INDEX_H
+#define BIN_INDEX_H
+
+/*
+    Index is saved beside archive as text, one line per file, fields
+    separated by tabs:
+
+    Header line
+        "# bin_index" version archive_size archive_mtime num_files
+
+    Files, in archive order
+        offset          Offset of header in archive, hexadecimal
+        id
+        length          Length of data, which follows header
+        filename        Name read from header, up to end of line
+
+    Index is not saved if a name holds a tab or a line end.
+*/
+
+/*--- Defines ---*/
+
+#define BIN_INDEX_MAGIC   "# bin_index"
+#define BIN_INDEX_VERSION 1
+
+/* Each header is followed by file data */
+#define BIN_HEADER_SIZE 0x800
+
+/*--- Types ---*/
+
+typedef struct {
+    Sint64 offset; /* Offset of header in archive */
+    Uint32 id;
+    Uint32 length; /* Length of data */
+    Uint32 name;   /* Offset of name in strings */
+} bin_entry_t;
+
+typedef struct {
+    bin_entry_t* entries;
+    int num_entries;
+    char* strings; /* Names of files, NUL terminated */
+    Uint32 strings_length;
+    Sint64 archive_size; /* Archive identification for saved index */
+    Sint64 archive_mtime;
+    int loaded; /* Read from saved index */
+} bin_index_t;
+
+/*--- Functions ---*/
+
+/*
+    Build index of an archive. A saved index is used if it matches the
+    archive, else headers are read and the index is saved, if the directory
+    of the archive can be written.
+
+    filename	Archive
+    Returns NULL on error
+*/
+bin_index_t* bin_index_open(const char* filename);
+
+void bin_index_close(bin_index_t* index);
+
+/* Name of file, as read from its header */
+const char* bin_index_name(bin_index_t* index, int entry);
+
+/*
+    Find a file by its name, with or without path
+
+    Returns index of entry, -1 if not found
+*/
+int bin_index_find(bin_index_t* index, const char* name);
+
+#endif /* BIN_INDEX_H */
@@ -0,0 +1,415 @@
+/*
+    BMP image writer
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#if defined(HAVE_WRITEV) && defined(HAVE_SYS_UIO_H)
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <unistd.h>
+#    include <sys/uio.h>
+#    define USE_WRITEV 1
+#endif
+
+#include "rw.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    include <emmintrin.h>
+#    define HAVE_BMP_SSE2 1
+#endif
+
+/* SSSE3 code is compiled for its own function only, and used if CPU has it */
+#if defined(HAVE_BMP_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    include <tmmintrin.h>
+#    define HAVE_BMP_SSSE3 1
+#endif
+
+#include "bmp.h"
+
+/*--- Defines ---*/
+
+#define BMP_FILE_HEADER_SIZE 14
+#define BMP_INFO_HEADER_SIZE 40
+#define BMP_HEADER_SIZE      (BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE)
+
+/* Converted rows are written by chunks of this size */
+#define BMP_CHUNK_SIZE (256 << 10)
+
+#define BMP_MAX_IOV 64
+
+/*--- Types ---*/
+
+#ifdef USE_WRITEV
+typedef struct iovec bmp_iov_t;
+#else
+typedef struct {
+    void* iov_base;
+    size_t iov_len;
+} bmp_iov_t;
+#endif
+
+typedef struct {
+#ifdef USE_WRITEV
+    int fd;
+#else
+    FILE* file;
+#endif
+    bmp_iov_t iov[BMP_MAX_IOV];
+    int num_iov;
+    int error;
+} bmp_writer_t;
+
+typedef void (*bmp_convert_f)(Uint8* dst, const Uint8* src, int width);
+
+/*--- Functions prototypes ---*/
+
+static int bmp_open(bmp_writer_t* writer, const char* filename);
+static int bmp_close(bmp_writer_t* writer);
+static void bmp_add(bmp_writer_t* writer, const void* data, size_t length);
+static void bmp_flush(bmp_writer_t* writer);
+
+static int bmp_header(Uint8* header, const bmp_image_t* image, int bpp, int row_size);
+
+static void convert_ps1_15(Uint8* dst, const Uint8* src, int width);
+static void convert_ps1_16a(Uint8* dst, const Uint8* src, int width);
+static void convert_rgb24(Uint8* dst, const Uint8* src, int width);
+#ifdef HAVE_BMP_SSSE3
+static void convert_rgb24_ssse3(Uint8* dst, const Uint8* src, int width)
+    __attribute__((target("ssse3")));
+#endif
+
+static void write_le16(Uint8* dst, Uint16 value);
+static void write_le32(Uint8* dst, Uint32 value);
+
+/*--- Functions ---*/
+
+int bmp_save(const char* filename, const bmp_image_t* image) {
+    static const Uint8 padding[4] = { 0, 0, 0, 0 };
+    Uint8 header[BMP_HEADER_SIZE + 256 * 4];
+    bmp_writer_t writer;
+    bmp_convert_f convert = NULL;
+    Uint8* chunk = NULL;
+    int bpp, row_size, header_size, rows, y;
+
+    switch (image->format) {
+    case BMP_PAL8:
+        bpp = 8;
+        break;
+    case BMP_PS1_15:
+        bpp = 16;
+        convert = convert_ps1_15;
+        break;
+    case BMP_PS1_16A:
+        bpp = 32;
+        convert = convert_ps1_16a;
+        break;
+    case BMP_RGB24:
+        bpp = 24;
+        convert = convert_rgb24;
+#ifdef HAVE_BMP_SSSE3
+        if (__builtin_cpu_supports("ssse3")) {
+            convert = convert_rgb24_ssse3;
+        }
+#endif
+        break;
+    default:
+        return 1;
+    }
+    if ((image->width <= 0) || (image->height <= 0) || !image->pixels) {
+        return 1;
+    }
+
+    /* Rows are saved bottom to top, padded to 4 bytes */
+    row_size = ((image->width * bpp / 8) + 3) & ~3;
+
+    /* Converted rows are written by chunks, 8 bits rows directly from image */
+    rows = BMP_CHUNK_SIZE / row_size;
+    if (rows < 1) {
+        rows = 1;
+    }
+    if (rows > image->height) {
+        rows = image->height;
+    }
+    if (convert) {
+        chunk = (Uint8*) malloc(rows * row_size);
+        if (!chunk) {
+            fprintf(stderr, "Can not allocate %d bytes in memory\n", rows * row_size);
+            return 1;
+        }
+    }
+
+    if (!bmp_open(&writer, filename)) {
+        fprintf(stderr, "Can not create %s for writing\n", filename);
+        free(chunk);
+        return 1;
+    }
+
+    header_size = bmp_header(header, image, bpp, row_size);
+    bmp_add(&writer, header, header_size);
+
+    for (y = image->height - 1; y >= 0;) {
+        const Uint8* src = &image->pixels[y * image->pitch];
+
+        if (!convert) {
+            bmp_add(&writer, src, image->width);
+            if (row_size > image->width) {
+                bmp_add(&writer, padding, row_size - image->width);
+            }
+            --y;
+        } else {
+            Uint8* dst = chunk;
+            int i;
+
+            for (i = 0; (i < rows) && (y >= 0); i++, y--) {
+                src = &image->pixels[y * image->pitch];
+                convert(dst, src, image->width);
+                memset(&dst[image->width * bpp / 8], 0, row_size - image->width * bpp / 8);
+                dst += row_size;
+            }
+
+            /* Chunk is reused after it is written */
+            bmp_add(&writer, chunk, dst - chunk);
+            bmp_flush(&writer);
+        }
+    }
+
+    free(chunk);
+    return bmp_close(&writer);
+}
+
+static int bmp_header(Uint8* header, const bmp_image_t* image, int bpp, int row_size) {
+    int num_colors = (bpp == 8 ? 256 : 0);
+    int header_size = BMP_HEADER_SIZE + num_colors * 4;
+    int i;
+
+    memset(header, 0, header_size);
+
+    header[0] = 'B';
+    header[1] = 'M';
+    write_le32(&header[2], header_size + row_size * image->height);
+    write_le32(&header[10], header_size);
+
+    write_le32(&header[14], BMP_INFO_HEADER_SIZE);
+    write_le32(&header[18], image->width);
+    write_le32(&header[22], image->height);
+    write_le16(&header[26], 1);
+    write_le16(&header[28], bpp);
+    write_le32(&header[34], row_size * image->height);
+    write_le32(&header[38], 2835); /* 72 dpi */
+    write_le32(&header[42], 2835);
+    write_le32(&header[46], num_colors);
+
+    /* Palette is blue, green, red, unused */
+    for (i = 0; i < num_colors; i++) {
+        Uint8* color = &header[BMP_HEADER_SIZE + i * 4];
+
+        if (!image->palette) {
+            color[0] = color[1] = color[2] = i;
+        } else if (i < image->num_colors) {
+            Uint16 value = image->palette[i];
+            int c;
+
+            c = (value >> 10) & 31;
+            color[0] = (c << 3) | (c >> 2);
+            c = (value >> 5) & 31;
+            color[1] = (c << 3) | (c >> 2);
+            c = value & 31;
+            color[2] = (c << 3) | (c >> 2);
+        }
+    }
+
+    return header_size;
+}
+
+/* PS1 colors have red in low bits, BMP colors have blue */
+static void convert_ps1_15(Uint8* dst, const Uint8* src, int width) {
+    int x = 0;
+
+#ifdef HAVE_BMP_SSE2
+    {
+        const __m128i mask_r = _mm_set1_epi16(0x1f);
+        const __m128i mask_g = _mm_set1_epi16(0x3e0);
+
+        for (; x + 8 <= width; x += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*) &src[x << 1]);
+            __m128i r = _mm_slli_epi16(_mm_and_si128(v, mask_r), 10);
+            __m128i g = _mm_and_si128(v, mask_g);
+            __m128i b = _mm_and_si128(_mm_srli_epi16(v, 10), mask_r);
+
+            _mm_storeu_si128((__m128i*) &dst[x << 1], _mm_or_si128(_mm_or_si128(r, g), b));
+        }
+    }
+#endif
+
+    for (; x < width; x++) {
+        Uint16 v = src[x << 1] | (src[(x << 1) + 1] << 8);
+
+        write_le16(&dst[x << 1], ((v & 31) << 10) | (v & (31 << 5)) | ((v >> 10) & 31));
+    }
+}
+
+/* Alpha bit set for opaque pixels */
+static void convert_ps1_16a(Uint8* dst, const Uint8* src, int width) {
+    int x;
+
+    for (x = 0; x < width; x++) {
+        Uint16 v = src[x << 1] | (src[(x << 1) + 1] << 8);
+        int c;
+
+        c = (v >> 10) & 31;
+        dst[0] = (c << 3) | (c >> 2);
+        c = (v >> 5) & 31;
+        dst[1] = (c << 3) | (c >> 2);
+        c = v & 31;
+        dst[2] = (c << 3) | (c >> 2);
+        dst[3] = (v & 0x8000 ? 255 : 0);
+        dst += 4;
+    }
+}
+
+static void convert_rgb24(Uint8* dst, const Uint8* src, int width) {
+    int x;
+
+    for (x = 0; x < width; x++) {
+        dst[0] = src[2];
+        dst[1] = src[1];
+        dst[2] = src[0];
+        dst += 3;
+        src += 3;
+    }
+}
+
+#ifdef HAVE_BMP_SSSE3
+/* 5 pixels at once, 16th byte is overwritten by next pixels */
+static void convert_rgb24_ssse3(Uint8* dst, const Uint8* src, int width) {
+    const __m128i shuffle = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    int x = 0;
+
+    for (; x + 6 <= width; x += 5) {
+        __m128i v = _mm_loadu_si128((const __m128i*) src);
+
+        _mm_storeu_si128((__m128i*) dst, _mm_shuffle_epi8(v, shuffle));
+        src += 15;
+        dst += 15;
+    }
+
+    convert_rgb24(dst, src, width - x);
+}
+#endif
+
+static int bmp_open(bmp_writer_t* writer, const char* filename) {
+    writer->num_iov = 0;
+    writer->error = 0;
+
+#ifdef USE_WRITEV
+    writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    return (writer->fd >= 0);
+#else
+    writer->file = fopen(filename, "wb");
+    return (writer->file != NULL);
+#endif
+}
+
+static int bmp_close(bmp_writer_t* writer) {
+    bmp_flush(writer);
+
+#ifdef USE_WRITEV
+    if (close(writer->fd) != 0) {
+        writer->error = 1;
+    }
+#else
+    if (fclose(writer->file) != 0) {
+        writer->error = 1;
+    }
+#endif
+
+    return writer->error;
+}
+
+/* Data must stay valid until it is flushed */
+static void bmp_add(bmp_writer_t* writer, const void* data, size_t length) {
+    if (writer->num_iov == BMP_MAX_IOV) {
+        bmp_flush(writer);
+    }
+
+    writer->iov[writer->num_iov].iov_base = (void*) data;
+    writer->iov[writer->num_iov].iov_len = length;
+    writer->num_iov++;
+}
+
+static void bmp_flush(bmp_writer_t* writer) {
+    bmp_iov_t* iov = writer->iov;
+    int count = writer->num_iov;
+
+    writer->num_iov = 0;
+    if (writer->error) {
+        return;
+    }
+
+#ifdef USE_WRITEV
+    while (count > 0) {
+        ssize_t written = writev(writer->fd, iov, count);
+
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            writer->error = 1;
+            return;
+        }
+
+        /* Continue after last byte written */
+        while ((count > 0) && ((size_t) written >= iov->iov_len)) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (Uint8*) iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+#else
+    for (; count > 0; count--, iov++) {
+        if (fwrite(iov->iov_base, iov->iov_len, 1, writer->file) != 1) {
+            writer->error = 1;
+            return;
+        }
+    }
+#endif
+}
+
+static void write_le16(Uint8* dst, Uint16 value) {
+    dst[0] = value;
+    dst[1] = value >> 8;
+}
+
+static void write_le32(Uint8* dst, Uint32 value) {
+    dst[0] = value;
+    dst[1] = value >> 8;
+    dst[2] = value >> 16;
+    dst[3] = value >> 24;
+}
@@ -0,0 +1,56 @@
+/*
+    BMP image writer
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef BMP_H
+#define BMP_H
+
+/*--- Defines ---*/
+
+/* Formats of pixels, as read by decoders */
+#define BMP_PAL8     0 /* 8 bits, palette of PS1 colors, saved as 8 bits */
+#define BMP_PS1_15   1 /* 16 bits PS1 colors (little endian, red in low bits), saved as 15 bits */
+#define BMP_PS1_16A  2 /* 16 bits PS1 colors, bit 15 is alpha, saved as 32 bits */
+#define BMP_RGB24    3 /* 24 bits, red, green, blue bytes, saved as 24 bits */
+
+/*--- Types ---*/
+
+typedef struct {
+    int width;
+    int height;
+    int format;
+    const Uint8* pixels; /* First row, rows are top to bottom */
+    int pitch;           /* Bytes from a row to next one */
+    const Uint16* palette; /* PS1 colors of 8 bits images, NULL for grey levels */
+    int num_colors;
+} bmp_image_t;
+
+/*--- Functions ---*/
+
+/*
+    Save an image to a BMP file. Pixels are converted to BMP format row
+    by row while writing, without copying image first.
+
+    filename	Name of BMP file
+    image	Image
+    Returns 0 if saved
+*/
+int bmp_save(const char* filename, const bmp_image_t* image);
+
+#endif /* BMP_H */
@@ -27,28 +27,29 @@
 #    include "config.h"
 #endif
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "depack_bsssld.h"
 #include "depack_vlc.h"
 #include "depack_mdec.h"
 #include "file_functions.h"
+#include "applets.h"
 
-int convert_image(const char* filename) {
-    SDL_RWops* src;
+static int convert_image(const char* filename) {
+    rw_t* src;
     int retval = 1;
 
-    src = SDL_RWFromFile(filename, "rb");
+    src = rw_from_file(filename, "rb");
     if (!src) {
         fprintf(stderr, "Can not open %s for reading\n", filename);
         return retval;
     }
 
-    SDL_RWseek(src, 0, RW_SEEK_END);
-    const size_t fileSize = SDL_RWtell(src);
-    const size_t fileInterval = 0x10000;
+    rw_seek(src, 0, RW_SEEK_END);
+    const Sint64 fileSize = rw_tell(src);
+    const Sint64 fileInterval = 0x10000;
 
-    size_t currentInterval = 0;
+    Sint64 currentInterval = 0;
     size_t filenameSuffix = 0;
 
     const size_t newFilenameLength = strlen(filename) + 15;
@@ -65,11 +66,11 @@ int convert_image(const char* filename) {
     uint32_t countBackgrounds = 0;
 
     while (currentInterval < fileSize) {
-        SDL_RWseek(src, currentInterval, RW_SEEK_SET);
-        uint16_t length = SDL_ReadLE16(src);
-        uint16_t id = SDL_ReadLE16(src);
-        uint16_t quant = SDL_ReadLE16(src);
-        uint16_t version = SDL_ReadLE16(src);
+        rw_seek(src, currentInterval, RW_SEEK_SET);
+        uint16_t length = rw_read_le16(src);
+        uint16_t id = rw_read_le16(src);
+        uint16_t quant = rw_read_le16(src);
+        uint16_t version = rw_read_le16(src);
 
         printf("NEW BACKGROUND %d\n", countBackgrounds++);
 
@@ -78,46 +79,47 @@ int convert_image(const char* filename) {
             break;
         }
 
-        SDL_RWseek(src, currentInterval, RW_SEEK_SET);
+        rw_seek(src, currentInterval, RW_SEEK_SET);
         currentInterval += fileInterval;
-        printf("Next interval %d out of %d\n", currentInterval, fileSize);
+        printf("Next interval %" PRId64 " out of %" PRId64 "\n", currentInterval, fileSize);
 
         uint8_t* dstBuffer = NULL;
-        int dstBufLen = 0;
+        size_t dstBufLen = 0;
 
         vlc_depack(src, &dstBuffer, &dstBufLen);
-        printf("Reading TIM starting from %d\n", SDL_RWtell(src));
+        printf("Reading TIM starting from %" PRId64 "\n", rw_tell(src));
 
-        uint32_t peekLimit = SDL_RWtell(src) + 256;
-        while (SDL_RWtell(src) < peekLimit && SDL_ReadU8(src) != 0x1B)
+        const Sint64 peekLimit = rw_tell(src) + 256;
+        while (rw_tell(src) < peekLimit && rw_read_u8(src) != 0x1B)
             ;
 
-        const int hasTim = SDL_ReadLE32(src) == 0x10;
+        const int hasTim = rw_read_le32(src) == 0x10;
         if (hasTim) {
-            SDL_RWseek(src, -11, RW_SEEK_CUR);
+            rw_seek(src, -11, RW_SEEK_CUR);
 
-            const uint32_t timLength = SDL_ReadLE32(src);
+            const uint32_t timLength = rw_read_le32(src);
             printf("TIM Length: %d\n", timLength);
 
-            const uint16_t separator = SDL_ReadLE16(src);
+            const uint16_t separator = rw_read_le16(src);
             if (separator != 0xFFFF) {
-                printf("Expected 0xFFFF separator at %d, got %x\n", SDL_RWtell(src), separator);
+                printf("Expected 0xFFFF separator at %" PRId64 ", got %x\n", rw_tell(src), separator);
                 return 1;
             }
 
-            SDL_RWseek(src, -6, RW_SEEK_CUR);
-            const size_t restOfFileSize = fileSize - SDL_RWtell(src);
+            rw_seek(src, -6, RW_SEEK_CUR);
+            const size_t restOfFileSize = fileSize - rw_tell(src);
 
             void* timReadBuffer = malloc(restOfFileSize);
             if (timReadBuffer == NULL) {
-                fprintf(stderr, "Failed to allocate new rest of file with %d bytes\n", restOfFileSize);
+                fprintf(stderr, "Failed to allocate new rest of file with %" PRIu64 " bytes\n",
+                    (Uint64) restOfFileSize);
                 return 1;
             }
 
             Uint8* timDstBuffer = NULL;
-            int* timDstBufferLength = 0;
+            size_t timDstBufferLength = 0;
 
-            SDL_RWread(src, timReadBuffer, restOfFileSize, 1);
+            rw_read(src, timReadBuffer, restOfFileSize, 1);
             bsssld_depack_re2((Uint8*) timReadBuffer, restOfFileSize, &timDstBuffer,
                 &timDstBufferLength);
 
@@ -125,35 +127,40 @@ int convert_image(const char* filename) {
             sprintf(tmpFilenameSuffix, "0%03d.TIM", filenameSuffix);
             strcpy(extensionPosition, tmpFilenameSuffix);
 
-            SDL_RWops* timFile = SDL_RWFromFile(newFilename, "wb");
-            SDL_RWwrite(timFile, timDstBuffer, timDstBufferLength, 1);
-            SDL_RWclose(timFile);
+            rw_t* timFile = rw_from_file(newFilename, "wb");
+            rw_write(timFile, timDstBuffer, timDstBufferLength, 1);
+            rw_close(timFile);
         }
 
         if (dstBuffer && dstBufLen) {
-            SDL_RWops* mdec_src;
+            rw_t* mdec_src;
 
-            mdec_src = SDL_RWFromMem(dstBuffer, dstBufLen);
+            mdec_src = rw_from_mem(dstBuffer, dstBufLen);
             if (mdec_src) {
                 Uint8* dstMdecBuf;
-                int dstMdecLen;
+                size_t dstMdecLen;
 
                 mdec_depack(mdec_src, &dstMdecBuf, &dstMdecLen, 320, 240);
-                SDL_RWclose(mdec_src);
+                rw_close(mdec_src);
 
                 if (dstMdecBuf && dstMdecLen) {
-                    SDL_Surface* image = mdec_surface(dstMdecBuf, 320, 240, 0);
-                    if (image) {
-                        char tmpFilenameSuffix[15] = { 0 };
-                        sprintf(tmpFilenameSuffix, "0%03d.BMP", filenameSuffix);
-                        strcpy(extensionPosition, tmpFilenameSuffix);
+                    bmp_image_t image;
+                    char tmpFilenameSuffix[15] = { 0 };
 
-                        save_bmp(newFilename, image);
-                        SDL_FreeSurface(image);
+                    memset(&image, 0, sizeof(image));
+                    image.width = 320;
+                    image.height = 240;
+                    image.format = BMP_RGB24;
+                    image.pixels = dstMdecBuf;
+                    image.pitch = 320 * 3;
 
-                        retval = 0;
-                        filenameSuffix++;
-                    }
+                    sprintf(tmpFilenameSuffix, "0%03d.BMP", filenameSuffix);
+                    strcpy(extensionPosition, tmpFilenameSuffix);
+
+                    save_bmp(newFilename, &image);
+
+                    retval = 0;
+                    filenameSuffix++;
 
                     free(dstMdecBuf);
                 }
@@ -165,12 +172,18 @@ int convert_image(const char* filename) {
         printf("---------------------------------\n");
     }
 
-    SDL_RWclose(src);
+    rw_close(src);
 
     return retval;
 }
 
+#ifndef MULTICALL
 int main(int argc, char** argv) {
+    return bss2bmp_main(argc, argv);
+}
+#endif
+
+int bss2bmp_main(int argc, char** argv) {
     int retval;
 
     if (argc < 2) {
@@ -178,14 +191,7 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Can not initialize SDL: %s\n", SDL_GetError());
-        return 1;
-    }
-    atexit(SDL_Quit);
-
     retval = convert_image(argv[1]);
 
-    SDL_Quit();
     return retval;
 }
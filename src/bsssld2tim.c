@@ -26,42 +26,39 @@
 #    include "config.h"
 #endif
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "file_functions.h"
 #include "depack_bsssld.h"
 #include "param.h"
-
-/*--- Variables ---*/
-
-static int depackre3;
+#include "applets.h"
 
 /*--- Functions ---*/
 
-int depack_image(const char* filename) {
-    SDL_RWops* src;
+static int depack_image(const char* filename, int depackre3) {
+    rw_t* src;
     Uint8 *srcBuffer, *dstBuffer;
-    int dstBufLen;
+    size_t dstBufLen;
     int retval = 1;
     Sint64 srcLen;
 
-    src = SDL_RWFromFile(filename, "rb");
+    src = rw_from_file(filename, "rb");
     if (!src) {
         fprintf(stderr, "Can not open %s for reading\n", filename);
         return retval;
     }
 
     /* Read whole file in memory */
-    srcLen = SDL_RWseek(src, 0, RW_SEEK_END);
-    SDL_RWseek(src, 0, RW_SEEK_SET);
+    srcLen = rw_seek(src, 0, RW_SEEK_END);
+    rw_seek(src, 0, RW_SEEK_SET);
 
     srcBuffer = malloc(srcLen);
     if (!srcBuffer) {
         return retval;
     }
 
-    SDL_RWread(src, srcBuffer, srcLen, 1);
-    SDL_RWclose(src);
+    rw_read(src, srcBuffer, srcLen, 1);
+    rw_close(src);
 
     if (depackre3) {
         bsssld_depack_re3(srcBuffer, srcLen, &dstBuffer, &dstBufLen);
@@ -79,27 +76,26 @@ int depack_image(const char* filename) {
     return retval;
 }
 
+#ifndef MULTICALL
 int main(int argc, char** argv) {
+    return bsssld2tim_main(argc, argv);
+}
+#endif
+
+int bsssld2tim_main(int argc, char** argv) {
     int retval;
+    int depackre3 = 0;
 
     if (argc < 2) {
         fprintf(stderr, "Usage: %s [-re3] /path/to/filename.bin\n", argv[0]);
         return 1;
     }
 
-    depackre3 = 0;
     if (param_check("-re3", argc, argv) >= 0) {
         depackre3 = 1;
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Can not initialize SDL: %s\n", SDL_GetError());
-        return 1;
-    }
-    atexit(SDL_Quit);
-
-    retval = depack_image(argv[argc - 1]);
+    retval = depack_image(argv[argc - 1], depackre3);
 
-    SDL_Quit();
     return retval;
 }
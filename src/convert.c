@@ -0,0 +1,232 @@
+/*
+    Convert files found in memory
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#include <libxml/parser.h>
+#include "rw.h"
+
+#include "depack_vlc.h"
+#include "depack_mdec.h"
+#include "bmp.h"
+#include "emd_xml.h"
+#include "convert.h"
+
+/*--- Defines ---*/
+
+#define MAGIC_TIM 0x10
+#define TIM_CLUT  0x08 /* Flag of TIM with CLUT block */
+
+#define BSS_WIDTH  320
+#define BSS_HEIGHT 240
+
+/*--- Functions prototypes ---*/
+
+static int convert_tim(Uint8* data, Uint32 length, const char* filename);
+static int convert_bss(Uint8* data, Uint32 length, const char* filename);
+
+
+/*--- Functions ---*/
+
+void convert_init(void) {
+    LIBXML_TEST_VERSION
+    xmlInitParser();
+}
+
+void convert_quit(void) {
+#ifndef MULTICALL
+    /* Other tools of reevengi may still use the parser */
+    xmlCleanupParser();
+#endif
+}
+
+int convert_file(const char* dirname, const char* name, int type, Uint8* data, Uint32 length) {
+    char filename[512];
+    int i, retval = 1;
+
+    i = snprintf(filename, sizeof(filename), "%s/%s.%s", dirname, name,
+        (type == CONVERT_EMD ? "xml" : "bmp"));
+    if ((i < 0) || (i >= (int) sizeof(filename))) {
+        fprintf(stderr, "%s: name too long\n", name);
+        return retval;
+    }
+
+    switch (type) {
+    case CONVERT_TIM:
+        retval = convert_tim(data, length, filename);
+        break;
+    case CONVERT_EMD:
+        retval = emd_save_xml(data, length, filename);
+        break;
+    case CONVERT_BSS:
+        retval = convert_bss(data, length, filename);
+        break;
+    }
+
+    if (retval) {
+        fprintf(stderr, "%s: can not convert\n", name);
+    }
+    return retval;
+}
+
+/* 4 bits images are expanded to 8 bits, others are saved from data */
+static int convert_tim(Uint8* data, Uint32 length, const char* filename) {
+    const Uint8 *clut = NULL, *pixels;
+    Uint32 type, offset = 8, block_length;
+    Uint16 palette[256];
+    Uint8* expanded = NULL;
+    int num_colors = 0, tim_width, width, height, i, x, y;
+    bmp_image_t image;
+
+    if ((length < 8 + 12) || (rw_get_le32(data) != MAGIC_TIM)) {
+        return 1;
+    }
+    type = rw_get_le32(&data[4]);
+
+    if (type & TIM_CLUT) {
+        block_length = rw_get_le32(&data[offset]);
+        if ((block_length < 12) || (block_length > length - offset)) {
+            return 1;
+        }
+        clut = &data[offset + 12];
+        num_colors = (block_length - 12) >> 1;
+        offset += block_length;
+    }
+
+    /* Width of image in VRAM is in 16 bits units */
+    if (length - offset < 12) {
+        return 1;
+    }
+    block_length = rw_get_le32(&data[offset]);
+    tim_width = rw_get_le16(&data[offset + 8]);
+    height = rw_get_le16(&data[offset + 10]);
+    if ((block_length > length - offset)
+        || (12 + 2 * (Uint64) tim_width * height > block_length)) {
+        return 1;
+    }
+    pixels = &data[offset + 12];
+
+    memset(&image, 0, sizeof(image));
+    image.pixels = pixels;
+    image.pitch = tim_width * 2;
+
+    switch (type & 3) {
+    case 0:
+        width = tim_width * 4;
+        image.format = BMP_PAL8;
+        break;
+    case 1:
+        width = tim_width * 2;
+        image.format = BMP_PAL8;
+        break;
+    case 2:
+        width = tim_width;
+        image.format = BMP_PS1_15;
+        break;
+    default:
+        width = (tim_width * 2) / 3;
+        image.format = BMP_RGB24;
+        break;
+    }
+    if ((width == 0) || (height == 0) || ((image.format == BMP_PAL8) && !clut)) {
+        return 1;
+    }
+    image.width = width;
+    image.height = height;
+
+    /* First CLUT is used */
+    if (image.format == BMP_PAL8) {
+        if (num_colors > 256) {
+            num_colors = 256;
+        }
+        for (i = 0; i < num_colors; i++) {
+            palette[i] = rw_get_le16(&clut[i << 1]);
+        }
+        image.palette = palette;
+        image.num_colors = num_colors;
+    }
+
+    if ((type & 3) == 0) {
+        expanded = (Uint8*) malloc(width * height);
+        if (!expanded) {
+            return 1;
+        }
+        for (y = 0; y < height; y++) {
+            const Uint8* src = &pixels[y * tim_width * 2];
+            Uint8* dst = &expanded[y * width];
+
+            for (x = 0; x < width; x++) {
+                dst[x] = (src[x >> 1] >> ((x & 1) << 2)) & 15;
+            }
+        }
+        image.pixels = expanded;
+        image.pitch = width;
+    }
+
+    i = bmp_save(filename, &image);
+    free(expanded);
+    return i;
+}
+
+/* VLC compressed image, depacked to MDEC data, then decoded */
+static int convert_bss(Uint8* data, Uint32 length, const char* filename) {
+    rw_t* src;
+    Uint8 *vlc_buffer, *mdec_buffer;
+    size_t vlc_length, mdec_length;
+    bmp_image_t image;
+    int retval = 1;
+
+    src = rw_from_mem(data, length);
+    if (!src) {
+        return retval;
+    }
+    vlc_depack(src, &vlc_buffer, &vlc_length);
+    rw_close(src);
+    if (!vlc_buffer || !vlc_length) {
+        free(vlc_buffer);
+        return retval;
+    }
+
+    src = rw_from_mem(vlc_buffer, vlc_length);
+    if (src) {
+        mdec_depack(src, &mdec_buffer, &mdec_length, BSS_WIDTH, BSS_HEIGHT);
+        rw_close(src);
+
+        if (mdec_buffer && mdec_length) {
+            memset(&image, 0, sizeof(image));
+            image.width = BSS_WIDTH;
+            image.height = BSS_HEIGHT;
+            image.format = BMP_RGB24;
+            image.pixels = mdec_buffer;
+            image.pitch = BSS_WIDTH * 3;
+            retval = bmp_save(filename, &image);
+        }
+        free(mdec_buffer);
+    }
+
+    free(vlc_buffer);
+    return retval;
+}
@@ -0,0 +1,56 @@
+/*
+    Convert files found in memory
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef CONVERT_H
+#define CONVERT_H
+
+/*--- Defines ---*/
+
+/* Types of files */
+#define CONVERT_TIM 0 /* To BMP */
+#define CONVERT_EMD 1 /* To XML */
+#define CONVERT_BSS 2 /* To BMP, 320x240 background */
+
+/*--- Functions ---*/
+
+/*
+    Initialize XML parser, must be called once before converting from
+    several threads
+*/
+void convert_init(void);
+
+/*
+    Free memory of XML parser, only when tools are built alone
+*/
+void convert_quit(void);
+
+/*
+    Convert a file in memory, without writing it first.
+
+    dirname	Destination directory, must exist
+    name	Name of converted file, without extension
+    type	Type of file
+    data	File
+    length	Length of file, or bytes readable from data if unknown
+    Returns 0 if converted
+*/
+int convert_file(const char* dirname, const char* name, int type, Uint8* data, Uint32 length);
+
+#endif /* CONVERT_H */
@@ -19,21 +19,13 @@
 */
 
 #include <stdio.h>
-#include <fcntl.h>
-
-#include <SDL.h>
+#include <stdlib.h>
 #include <string.h>
+#include <fcntl.h>
 
-static Uint8* dstPointer = NULL;
-static int dstBufLen = 0;
-static int dstOffset = 0;
-
-static unsigned char srcByte = 0;
-static int srcNumBit = 0;
+#include "rw.h"
 
-static Uint8* tmp32k = NULL;
-static Uint8* tmp16k = NULL;
-static int tmp32kOffset = 0, tmp16kOffset = 0;
+#include "depack_adt.h"
 
 /* Unpack structure */
 
@@ -57,23 +49,44 @@ typedef struct {
     node_t* tree;
 } unpackArray_t;
 
-static unpackArray_t array1, array2, array3;
+struct adt_context_s {
+    Uint8* dstPointer;
+    size_t dstBufLen;
+    size_t dstOffset;
+
+    unsigned char srcByte;
+    int srcNumBit;
+
+    unsigned long tmp32k[4096]; /* Trees and tables of arrays */
+    Uint8 tmp16k[16384];        /* Sliding window */
+    int tmp32kOffset, tmp16kOffset;
+
+    unpackArray_t array1, array2, array3;
+
+    unsigned short freqArray[17];
+};
+
+/*--- Functions ---*/
 
-static unsigned short freqArray[17];
+adt_context_t* adt_context_create(void) {
+    return (adt_context_t*) calloc(1, sizeof(adt_context_t));
+}
+
+void adt_context_destroy(adt_context_t* ctxt) { free(ctxt); }
 
-static void initTmpArray(unpackArray_t* array, int start, int length) {
+static void initTmpArray(adt_context_t* ctxt, unpackArray_t* array, int start, int length) {
     array->start = start;
 
     array->length = length;
 
-    array->tree = (node_t*) &tmp32k[tmp32kOffset];
-    tmp32kOffset += length * 2 * sizeof(node_t);
+    array->tree = (node_t*) &((Uint8*) ctxt->tmp32k)[ctxt->tmp32kOffset];
+    ctxt->tmp32kOffset += length * 2 * sizeof(node_t);
 
-    array->ptr8 = (unpackArray8_t*) &tmp32k[tmp32kOffset];
-    tmp32kOffset += length * sizeof(unpackArray8_t);
+    array->ptr8 = (unpackArray8_t*) &((Uint8*) ctxt->tmp32k)[ctxt->tmp32kOffset];
+    ctxt->tmp32kOffset += length * sizeof(unpackArray8_t);
 
-    array->ptr4 = (unsigned long*) &tmp32k[tmp32kOffset];
-    tmp32kOffset += length * sizeof(unsigned long);
+    array->ptr4 = (unsigned long*) &((Uint8*) ctxt->tmp32k)[ctxt->tmp32kOffset];
+    ctxt->tmp32kOffset += length * sizeof(unsigned long);
 }
 
 static void initTmpArrayData(unpackArray_t* array) {
@@ -90,47 +103,46 @@ static void initTmpArrayData(unpackArray_t* array) {
     }
 }
 
-static int readSrcBits(FILE* src, int numBits) {
+static int readSrcBits(adt_context_t* ctxt, rw_t* src, int numBits) {
     int orMask = 0;
-    int finalValue = srcByte;
+    int finalValue = ctxt->srcByte;
 
-    while (numBits > srcNumBit) {
-        numBits -= srcNumBit;
+    while (numBits > ctxt->srcNumBit) {
+        numBits -= ctxt->srcNumBit;
 
-        int andMask = (1 << srcNumBit) - 1;
+        int andMask = (1 << ctxt->srcNumBit) - 1;
         andMask &= finalValue;
         andMask <<= numBits;
-        if (!fread(&srcByte, 1, 1, src)) {
-            printf("Failed to read srcByte at %d to pointer %p : %d\n", ftell(src), &srcByte, errno);
-            srcByte = 0;
+        if (!rw_read(src, &ctxt->srcByte, 1, 1)) {
+            ctxt->srcByte = 0;
         }
 
-        finalValue = srcByte;
-        srcNumBit = 8;
+        finalValue = ctxt->srcByte;
+        ctxt->srcNumBit = 8;
         orMask |= andMask;
     }
 
-    srcNumBit -= numBits;
-    finalValue >>= srcNumBit;
+    ctxt->srcNumBit -= numBits;
+    finalValue >>= ctxt->srcNumBit;
     finalValue = (finalValue & ((1 << numBits) - 1)) | orMask;
     return finalValue;
 }
 
-static int readSrcOneBit(FILE* src) {
-    srcNumBit--;
-    if (srcNumBit < 0) {
-        srcNumBit = 7;
-        if (!fread(&srcByte, 1, 1, src)) {
-            srcByte = 0;
+static int readSrcOneBit(adt_context_t* ctxt, rw_t* src) {
+    ctxt->srcNumBit--;
+    if (ctxt->srcNumBit < 0) {
+        ctxt->srcNumBit = 7;
+        if (!rw_read(src, &ctxt->srcByte, 1, 1)) {
+            ctxt->srcByte = 0;
         }
     }
 
-    return (srcByte >> srcNumBit) & 1;
+    return (ctxt->srcByte >> ctxt->srcNumBit) & 1;
 }
 
-static int readSrcBitfieldArray(FILE* src, unpackArray_t* array, int curIndex) {
+static int readSrcBitfieldArray(adt_context_t* ctxt, rw_t* src, unpackArray_t* array, int curIndex) {
     do {
-        if (readSrcOneBit(src)) {
+        if (readSrcOneBit(ctxt, src)) {
             curIndex = array->tree[curIndex].nodes[NODE_RIGHT];
         } else {
             curIndex = array->tree[curIndex].nodes[NODE_LEFT];
@@ -140,30 +152,30 @@ static int readSrcBitfieldArray(FILE* src, unpackArray_t* array, int curIndex) {
     return curIndex;
 }
 
-static int readSrcBitfield(FILE* src) {
+static int readSrcBitfield(adt_context_t* ctxt, rw_t* src) {
     int numZeroBits = 0;
     int bitfieldValue = 1;
 
-    while (readSrcOneBit(src) == 0) {
+    while (readSrcOneBit(ctxt, src) == 0) {
         numZeroBits++;
     }
 
     while (numZeroBits > 0) {
-        bitfieldValue = readSrcOneBit(src) + (bitfieldValue << 1);
+        bitfieldValue = readSrcOneBit(ctxt, src) + (bitfieldValue << 1);
         numZeroBits--;
     }
 
     return bitfieldValue;
 }
 
-static void initUnpackBlockArray(unpackArray_t* array) {
+static void initUnpackBlockArray(adt_context_t* ctxt, unpackArray_t* array) {
     unsigned short tmp[18];
     int i, j;
 
     memset(tmp, 0, sizeof(tmp));
 
     for (i = 0; i < 16; i++) {
-        tmp[i + 2] = (tmp[i + 1] + freqArray[i + 1]) << 1;
+        tmp[i + 2] = (tmp[i + 1] + ctxt->freqArray[i + 1]) << 1;
     }
 
     for (i = 0; i < 18; i++) {
@@ -220,7 +232,7 @@ static int initUnpackBlockArray2(unpackArray_t* array) {
     return array->length;
 }
 
-static void initUnpackBlock(FILE* src) {
+static void initUnpackBlock(adt_context_t* ctxt, rw_t* src) {
     int i, j, prevValue, curBit, curBitfield;
     int numValues;
     unsigned short tmp[512];
@@ -229,48 +241,48 @@ static void initUnpackBlock(FILE* src) {
     /* Initialize array 1 to unpack block */
 
     prevValue = 0;
-    for (i = 0; i < array1.length; i++) {
-        if (readSrcOneBit(src)) {
-            array1.ptr8[i].length = readSrcBitfield(src) ^ prevValue;
+    for (i = 0; i < ctxt->array1.length; i++) {
+        if (readSrcOneBit(ctxt, src)) {
+            ctxt->array1.ptr8[i].length = readSrcBitfield(ctxt, src) ^ prevValue;
         } else {
-            array1.ptr8[i].length = prevValue;
+            ctxt->array1.ptr8[i].length = prevValue;
         }
-        prevValue = array1.ptr8[i].length;
+        prevValue = ctxt->array1.ptr8[i].length;
     }
 
     /* Count frequency of values in array 1 */
-    memset(freqArray, 0, sizeof(freqArray));
+    memset(ctxt->freqArray, 0, sizeof(ctxt->freqArray));
 
-    for (i = 0; i < array1.length; i++) {
-        numValues = array1.ptr8[i].length;
+    for (i = 0; i < ctxt->array1.length; i++) {
+        numValues = ctxt->array1.ptr8[i].length;
         if (numValues <= 16) {
-            freqArray[numValues]++;
+            ctxt->freqArray[numValues]++;
         }
     }
 
-    initUnpackBlockArray(&array1);
-    tmpBufLen = initUnpackBlockArray2(&array1);
+    initUnpackBlockArray(ctxt, &ctxt->array1);
+    tmpBufLen = initUnpackBlockArray2(&ctxt->array1);
 
     /* Initialize array 2 to unpack block */
 
-    if (array2.length > 0) {
-        memset(tmp, 0, array2.length);
+    if (ctxt->array2.length > 0) {
+        memset(tmp, 0, ctxt->array2.length);
     }
 
-    curBit = readSrcOneBit(src);
+    curBit = readSrcOneBit(ctxt, src);
     j = 0;
-    while (j < array2.length) {
+    while (j < ctxt->array2.length) {
         if (curBit) {
-            curBitfield = readSrcBitfield(src);
+            curBitfield = readSrcBitfield(ctxt, src);
             for (i = 0; i < curBitfield; i++) {
-                tmp[j + i] = readSrcBitfieldArray(src, &array1, tmpBufLen);
+                tmp[j + i] = readSrcBitfieldArray(ctxt, src, &ctxt->array1, tmpBufLen);
             }
             j += curBitfield;
             curBit = 0;
             continue;
         }
 
-        curBitfield = readSrcBitfield(src);
+        curBitfield = readSrcBitfield(ctxt, src);
         if (curBitfield > 0) {
             memset(&tmp[j], 0, curBitfield * sizeof(unsigned short));
             j += curBitfield;
@@ -279,221 +291,174 @@ static void initUnpackBlock(FILE* src) {
     }
 
     j = 0;
-    for (i = 0; i < array2.length; i++) {
+    for (i = 0; i < ctxt->array2.length; i++) {
         j = j ^ tmp[i];
-        array2.ptr8[i].length = j;
+        ctxt->array2.ptr8[i].length = j;
     }
 
     /* Count frequency of values in array 2 */
-    memset(freqArray, 0, sizeof(freqArray));
+    memset(ctxt->freqArray, 0, sizeof(ctxt->freqArray));
 
-    for (i = 0; i < array2.length; i++) {
-        numValues = array2.ptr8[i].length;
+    for (i = 0; i < ctxt->array2.length; i++) {
+        numValues = ctxt->array2.ptr8[i].length;
         if (numValues <= 16) {
-            freqArray[numValues]++;
+            ctxt->freqArray[numValues]++;
         }
     }
 
-    initUnpackBlockArray(&array2);
+    initUnpackBlockArray(ctxt, &ctxt->array2);
 
     /* Initialize array 3 to unpack block */
 
     prevValue = 0;
-    for (i = 0; i < array3.length; i++) {
-        if (readSrcOneBit(src)) {
-            array3.ptr8[i].length = readSrcBitfield(src) ^ prevValue;
+    for (i = 0; i < ctxt->array3.length; i++) {
+        if (readSrcOneBit(ctxt, src)) {
+            ctxt->array3.ptr8[i].length = readSrcBitfield(ctxt, src) ^ prevValue;
         } else {
-            array3.ptr8[i].length = prevValue;
+            ctxt->array3.ptr8[i].length = prevValue;
         }
-        prevValue = array3.ptr8[i].length;
+        prevValue = ctxt->array3.ptr8[i].length;
     }
 
     /* Count frequency of values in array 3 */
-    memset(freqArray, 0, sizeof(freqArray));
+    memset(ctxt->freqArray, 0, sizeof(ctxt->freqArray));
 
-    for (i = 0; i < array3.length; i++) {
-        numValues = array3.ptr8[i].length;
+    for (i = 0; i < ctxt->array3.length; i++) {
+        numValues = ctxt->array3.ptr8[i].length;
         if (numValues <= 16) {
-            freqArray[numValues]++;
+            ctxt->freqArray[numValues]++;
         }
     }
 
-    initUnpackBlockArray(&array3);
+    initUnpackBlockArray(ctxt, &ctxt->array3);
 }
 
 /* Initialize temporary tables, read each block and depack it */
-void adt_depack(FILE* src, Uint8** dstBufPtr, int* dstLength) {
-    int seekResult = 0;
-
-    dstPointer = *dstBufPtr = NULL;
-    srcByte = srcNumBit = dstOffset = dstBufLen = *dstLength = tmp32kOffset = tmp16kOffset = 0;
+void adt_depack_ctxt(adt_context_t* ctxt, rw_t* src, Uint8** dstBufPtr, size_t* dstLength) {
+    int blockLength;
 
-    tmp32k = (Uint8*) malloc(4096 * sizeof(unsigned long));
-    if (tmp32k == NULL) {
-        printf("Failed to allocate tmp32k\n");
-        return;
-    }
+    *dstBufPtr = ctxt->dstPointer = NULL;
+    *dstLength = ctxt->dstOffset = ctxt->dstBufLen = 0;
+    ctxt->srcByte = ctxt->srcNumBit = ctxt->tmp32kOffset = ctxt->tmp16kOffset = 0;
 
-    tmp16k = (Uint8*) malloc(16384);
-    if (tmp16k == NULL) {
-        printf("Failed to allocate tmp16k\n");
-        free(tmp32k);
+    if (rw_seek(src, 4, RW_SEEK_CUR) < 0) {
+        fprintf(stderr, "adt: can not seek in file\n");
         return;
     }
 
-    printf("seek %ld\n", ftell(src));
-    seekResult = fseek(src, 4, SEEK_CUR);
-    if (seekResult < 0) {
-        printf("Failed to seek!\n");
-        return;
-    }
-
-    printf("seek got us to (%X) %d\n", (unsigned int) seekResult, ftell(src));
-
-    initTmpArray(&array1, 8, 16);
-    initTmpArray(&array2, 8, 512);
-    initTmpArray(&array3, 8, 16);
+    initTmpArray(ctxt, &ctxt->array1, 8, 16);
+    initTmpArray(ctxt, &ctxt->array2, 8, 512);
+    initTmpArray(ctxt, &ctxt->array3, 8, 16);
 
-    printf("init1\n");
-    initTmpArrayData(&array1);
-    initTmpArrayData(&array2);
-    initTmpArrayData(&array3);
+    initTmpArrayData(&ctxt->array1);
+    initTmpArrayData(&ctxt->array2);
+    initTmpArrayData(&ctxt->array3);
 
-    printf("init2\n");
-    memset(tmp16k, 0, sizeof(tmp16k));
+    memset(ctxt->tmp16k, 0, sizeof(ctxt->tmp16k));
 
-    printf("init3\n");
-    int blockLength = readSrcBits(src, 8);
-    printf("blocklength first %d\n", blockLength);
-    blockLength |= readSrcBits(src, 8) << 8;
-    printf("blocklength second %d\n", blockLength);
+    blockLength = readSrcBits(ctxt, src, 8);
+    blockLength |= readSrcBits(ctxt, src, 8) << 8;
     while (blockLength > 0) {
-        printf("blocklength %d\n", blockLength);
         int tmpBufLen, tmpBufLen1, curBlockLength;
 
-        initUnpackBlock(src);
+        initUnpackBlock(ctxt, src);
 
-        tmpBufLen = initUnpackBlockArray2(&array2);
-        tmpBufLen1 = initUnpackBlockArray2(&array3);
+        tmpBufLen = initUnpackBlockArray2(&ctxt->array2);
+        tmpBufLen1 = initUnpackBlockArray2(&ctxt->array3);
 
         curBlockLength = 0;
         while (curBlockLength < blockLength) {
-            int curBitfield = readSrcBitfieldArray(src, &array2, tmpBufLen);
+            int curBitfield = readSrcBitfieldArray(ctxt, src, &ctxt->array2, tmpBufLen);
 
             if (curBitfield < 256) {
                 /* Realloc if needed */
-                if (dstOffset + 1 > dstBufLen) {
-                    dstBufLen += 0x8000;
-                    dstPointer = realloc(dstPointer, dstBufLen);
+                if (ctxt->dstOffset + 1 > ctxt->dstBufLen) {
+                    ctxt->dstBufLen += 0x8000;
+                    ctxt->dstPointer = realloc(ctxt->dstPointer, ctxt->dstBufLen);
                 }
 
-                dstPointer[dstOffset++] = tmp16k[tmp16kOffset++] = curBitfield;
-                tmp16kOffset &= 0x3fff;
+                ctxt->dstPointer[ctxt->dstOffset++] = ctxt->tmp16k[ctxt->tmp16kOffset++] = curBitfield;
+                ctxt->tmp16kOffset &= 0x3fff;
             } else {
                 int i;
                 int numValues = curBitfield - 0xfd;
                 int startOffset;
-                curBitfield = readSrcBitfieldArray(src, &array3, tmpBufLen1);
+                curBitfield = readSrcBitfieldArray(ctxt, src, &ctxt->array3, tmpBufLen1);
                 if (curBitfield != 0) {
                     int numBits = curBitfield - 1;
-                    curBitfield = readSrcBits(src, numBits) & 0xffff;
+                    curBitfield = readSrcBits(ctxt, src, numBits) & 0xffff;
                     curBitfield += 1 << numBits;
                 }
 
                 /* Realloc if needed */
-                if (dstOffset + numValues > dstBufLen) {
-                    dstBufLen += 0x8000;
-                    dstPointer = realloc(dstPointer, dstBufLen);
+                if (ctxt->dstOffset + numValues > ctxt->dstBufLen) {
+                    ctxt->dstBufLen += 0x8000;
+                    ctxt->dstPointer = realloc(ctxt->dstPointer, ctxt->dstBufLen);
                 }
 
-                startOffset = (tmp16kOffset - curBitfield - 1) & 0x3fff;
+                startOffset = (ctxt->tmp16kOffset - curBitfield - 1) & 0x3fff;
                 for (i = 0; i < numValues; i++) {
-                    dstPointer[dstOffset++] = tmp16k[tmp16kOffset++] = tmp16k[startOffset++];
+                    ctxt->dstPointer[ctxt->dstOffset++] = ctxt->tmp16k[ctxt->tmp16kOffset++] = ctxt->tmp16k[startOffset++];
                     startOffset &= 0x3fff;
-                    tmp16kOffset &= 0x3fff;
+                    ctxt->tmp16kOffset &= 0x3fff;
                 }
             }
 
             curBlockLength++;
         }
 
-        blockLength = readSrcBits(src, 8);
-        blockLength |= readSrcBits(src, 8) << 8;
+        blockLength = readSrcBits(ctxt, src, 8);
+        blockLength |= readSrcBits(ctxt, src, 8) << 8;
     }
 
-    free(tmp16k);
-    free(tmp32k);
-
-    *dstLength = dstBufLen;
-    *dstBufPtr = dstPointer;
+    *dstLength = ctxt->dstBufLen;
+    *dstBufPtr = ctxt->dstPointer;
+    ctxt->dstPointer = NULL;
 }
 
-SDL_Surface* adt_surface(Uint16* source, int reorganize) {
-    SDL_Surface* surface;
-    Uint16 *surface_line, *src_line;
-    int x, y;
-
-    surface = SDL_CreateRGBSurface(SDL_SWSURFACE, 320, 240, 16, 31, 31 << 5, 31 << 10, 0);
-    if (!surface) {
-        printf("Failed to create rgb surface\n");
-        return NULL;
-    }
+void adt_depack(rw_t* src, Uint8** dstBufPtr, size_t* dstLength) {
+    adt_context_t* ctxt;
 
-    if (reorganize) {
-        /* First 256x256 block */
-        surface_line = (Uint16*) surface->pixels;
-        src_line = source;
-        for (y = 0; y < 240; y++) {
-            Uint16* surface_col = surface_line;
-            for (x = 0; x < 256; x++) {
-                Uint16 col = *src_line++;
-                *surface_col++ = SDL_SwapLE16(col);
-            }
-            surface_line += 320;
-        }
+    *dstBufPtr = NULL;
+    *dstLength = 0;
 
-        /* Then 2x64x128 inside 128x128 */
-        surface_line = (Uint16*) surface->pixels;
-        surface_line += 256;
-        src_line = &source[256 * 256];
-        for (y = 0; y < 128; y++) {
-            Uint16* surface_col = surface_line;
-            Uint16* src_col = src_line;
-            for (x = 0; x < 64; x++) {
-                Uint16 col = *src_col++;
-                *surface_col++ = SDL_SwapLE16(col);
-            }
-
-            surface_line += 320;
-            src_line += 128;
-        }
+    ctxt = adt_context_create();
+    if (!ctxt) {
+        fprintf(stderr, "adt: can not allocate memory for context\n");
+        return;
+    }
+    adt_depack_ctxt(ctxt, src, dstBufPtr, dstLength);
+    adt_context_destroy(ctxt);
+}
 
-        surface_line = (Uint16*) surface->pixels;
-        surface_line += (320 * 128) + 256;
-        src_line = &source[256 * 256 + 64];
-        for (y = 0; y < 240 - 128; y++) {
-            Uint16* surface_col = surface_line;
-            Uint16* src_col = src_line;
-            for (x = 0; x < 64; x++) {
-                Uint16 col = *src_col++;
-                *surface_col++ = SDL_SwapLE16(col);
-            }
+void adt_reorganize(const Uint16* source, Uint16* dst) {
+    Uint16* dst_line;
+    const Uint16* src_line;
+    int y;
+
+    /* First 256x256 block */
+    dst_line = dst;
+    src_line = source;
+    for (y = 0; y < 240; y++) {
+        memcpy(dst_line, src_line, 256 * 2);
+        dst_line += 320;
+        src_line += 256;
+    }
 
-            surface_line += 320;
-            src_line += 128;
-        }
-    } else {
-        surface_line = (Uint16*) surface->pixels;
-        src_line = source;
-        for (y = 0; y < 240; y++) {
-            Uint16* surface_col = surface_line;
-            for (x = 0; x < 320; x++) {
-                Uint16 col = *src_line++;
-                *surface_col++ = SDL_SwapLE16(col);
-            }
-            surface_line += surface->pitch >> 1;
-        }
+    /* Then 2x64x128 inside 128x128 */
+    dst_line = dst + 256;
+    src_line = &source[256 * 256];
+    for (y = 0; y < 128; y++) {
+        memcpy(dst_line, src_line, 64 * 2);
+        dst_line += 320;
+        src_line += 128;
     }
 
-    return surface;
+    dst_line = dst + (320 * 128) + 256;
+    src_line = &source[256 * 256 + 64];
+    for (y = 0; y < 240 - 128; y++) {
+        memcpy(dst_line, src_line, 64 * 2);
+        dst_line += 320;
+        src_line += 128;
+    }
 }
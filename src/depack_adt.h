@@ -21,21 +21,41 @@
 #ifndef DEPACK_ADT_H
 #define DEPACK_ADT_H
 
+/*--- Types ---*/
+
+typedef struct adt_context_s adt_context_t;
+
+/*--- Functions ---*/
+
+/*
+    Context holds the trees and window, it can be reused for several files,
+    but used by a single thread at a time.
+
+    Returns NULL on error
+*/
+adt_context_t* adt_context_create(void);
+void adt_context_destroy(adt_context_t* ctxt);
+
 /*
     Depack an ADT file
 
-    src		Source file
+    ctxt	Context
+    src		Source stream, at start of ADT file
     dstPointer	Pointer to depacked file buffer (NULL if failed)
     dstLength	Length of depacked file (0 if failed)
 */
-void adt_depack(FILE* src, Uint8** dstPointer, int* dstLength);
+void adt_depack_ctxt(adt_context_t* ctxt, rw_t* src, Uint8** dstPointer, size_t* dstLength);
+
+/* Same, with a temporary context */
+void adt_depack(rw_t* src, Uint8** dstPointer, size_t* dstLength);
 
 /*
-    Create a SDL_Surface, for a depacked ADT file
+    Reorganize a depacked ADT file, with 256x256 block first, then 2 64x128,
+    to a 320x240 image. Pixels are copied as is (16 bits little endian).
+
     source		Pointer to depacked file
-    reorganize	0: keep buffer as is
-            1: buffer is organized with 256x256 block first, then 2 64x128
+    dst		320x240 image
 */
-SDL_Surface* adt_surface(Uint16* source, int reorganize);
+void adt_reorganize(const Uint16* source, Uint16* dst);
 
 #endif /* DEPACK_ADT_H */
@@ -20,11 +20,22 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 
-#include <SDL.h>
+#include "rw.h"
 
-void memcpy_overlap(Uint8* dest, Uint8* src, int count) {
+#include "depack_bsssld.h"
+#include "depack_sld.h"
+
+/*--- Defines ---*/
+
+/* Most bytes depacked from one byte of RE2 file (273 from 3 bytes) */
+#define RE2_MAX_RATIO 91
+
+/*--- Functions ---*/
+
+static void memcpy_overlap(Uint8* dest, Uint8* src, int count) {
     int i;
 
     for (i = 0; i < count; i++) {
@@ -32,26 +43,48 @@ void memcpy_overlap(Uint8* dest, Uint8* src, int count) {
     }
 }
 
-void bsssld_depack_re2(Uint8* srcPtr, int srcLen, Uint8** dstBufPtr, int* dstLength) {
+/* Length is in header, rejected if it can not be depacked from file */
+size_t bsssld_depack_re2_size(const Uint8* srcPtr, size_t srcLen) {
     Uint32 buflen;
-    Uint8* dstPtr;
-    int srcPos, dstPos;
-    int count;
 
-    buflen = SDL_SwapLE32(*((Uint32*) srcPtr));
+    if (srcLen < 6) {
+        return 0;
+    }
+    buflen = srcPtr[0] | (srcPtr[1] << 8) | (srcPtr[2] << 16) | ((Uint32) srcPtr[3] << 24);
 
-    dstPtr = *dstBufPtr = malloc(buflen);
-    memset(*dstBufPtr, 0, buflen);
-    *dstLength = buflen;
+    if (buflen / RE2_MAX_RATIO > srcLen - 6) {
+        return 0;
+    }
+    return buflen;
+}
+
+size_t bsssld_depack_re2_span(const Uint8* srcPtr, size_t srcLen, Uint8* dstPtr, size_t dstCapacity) {
+    size_t buflen, srcPos, dstPos;
+    int count;
+
+    buflen = bsssld_depack_re2_size(srcPtr, srcLen);
+    if ((buflen == 0) || (buflen > dstCapacity)) {
+        return 0;
+    }
+    memset(dstPtr, 0, buflen);
 
     srcPos = 6;
     dstPos = 0;
     while ((srcPos < srcLen) && (dstPos < buflen)) {
-        while ((srcPtr[srcPos] & 0x10) == 0) {
-            count = srcPtr[srcPos] & 0x0f;
-            int srcOffset = (-256 | (srcPtr[srcPos] & 0xe0)) << 3;
-            srcOffset |= srcPtr[srcPos + 1];
+        Uint8 code = srcPtr[srcPos];
+
+        if ((code & 0x10) == 0) {
+            int srcOffset;
+
+            if (srcPos + 1 >= srcLen) {
+                return 0;
+            }
+            count = code & 0x0f;
+            srcOffset = ((code & 0xe0) << 3) + srcPtr[srcPos + 1] - 2048;
             if (count == 0x0f) {
+                if (srcPos + 2 >= srcLen) {
+                    return 0;
+                }
                 count += srcPtr[srcPos + 2];
                 srcPos += 3;
             } else {
@@ -59,66 +92,103 @@ void bsssld_depack_re2(Uint8* srcPtr, int srcLen, Uint8** dstBufPtr, int* dstLen
             }
             count += 3;
 
+            /* Last copy is cut at end of file */
+            if ((size_t) -srcOffset > dstPos) {
+                return 0;
+            }
+            if ((size_t) count > buflen - dstPos) {
+                count = buflen - dstPos;
+            }
+
             memcpy_overlap(&dstPtr[dstPos], &dstPtr[dstPos + srcOffset], count);
             dstPos += count;
+            continue;
         }
 
-        if (srcPtr[srcPos] == 0xff) {
+        if (code == 0xff) {
             break;
         }
 
         count = ((srcPtr[srcPos++] | 0xffe0) ^ 0xffff) + 1;
         if (count == 0x10) {
+            if (srcPos >= srcLen) {
+                return 0;
+            }
             count += srcPtr[srcPos++];
         }
+        if ((size_t) count > srcLen - srcPos) {
+            return 0;
+        }
+        if ((size_t) count > buflen - dstPos) {
+            count = buflen - dstPos;
+        }
 
         memcpy(&dstPtr[dstPos], &srcPtr[srcPos], count);
         dstPos += count;
         srcPos += count;
     }
+
+    return buflen;
 }
 
-void bsssld_depack_re3(Uint8* srcPtr, int srcLen, Uint8** dstBufPtr, int* dstLength) {
-    Uint8* dstPtr;
-    int srcPos, dstPos, i, numBlocks;
-    int count, offset;
+void bsssld_depack_re2(Uint8* srcPtr, size_t srcLen, Uint8** dstBufPtr, size_t* dstLength) {
+    size_t buflen;
 
-    numBlocks = SDL_SwapLE32(*((Uint32*) srcPtr));
+    *dstBufPtr = NULL;
+    *dstLength = 0;
 
-    *dstLength = 65536;
-    dstPtr = malloc(*dstLength);
-    memset(dstPtr, 0, *dstLength);
+    buflen = bsssld_depack_re2_size(srcPtr, srcLen);
+    if (buflen == 0) {
+        return;
+    }
 
-    srcPos = 4;
-    dstPos = 0;
-    for (i = 0; (i < numBlocks) && (srcPos < srcLen); i++) {
-        if ((srcPtr[srcPos] & 0x80) != 0) {
-            count = srcPtr[srcPos++] & 0x7f;
+    *dstBufPtr = (Uint8*) malloc(buflen);
+    if (!*dstBufPtr) {
+        return;
+    }
 
-            if (dstPos + count >= *dstLength) {
-                *dstLength += 65536;
-                dstPtr = (Uint8*) realloc(dstPtr, *dstLength);
-            }
+    *dstLength = bsssld_depack_re2_span(srcPtr, srcLen, *dstBufPtr, buflen);
+    if (*dstLength == 0) {
+        free(*dstBufPtr);
+        *dstBufPtr = NULL;
+    }
+}
 
-            memcpy(&dstPtr[dstPos], &srcPtr[srcPos], count);
-            srcPos += count;
-            dstPos += count;
-        } else {
-            offset = srcPtr[srcPos++] << 8;
-            offset |= srcPtr[srcPos++];
-            count = (offset >> 11) + 2;
-            offset &= 0x7ff;
-
-            if (dstPos + count >= *dstLength) {
-                *dstLength += 65536;
-                dstPtr = (Uint8*) realloc(dstPtr, *dstLength);
-            }
+/* RE3 files are packed as SLD files */
+size_t bsssld_depack_re3_size(const Uint8* srcPtr, size_t srcLen) {
+    return sld_depack_size(srcPtr, srcLen);
+}
 
-            memcpy_overlap(&dstPtr[dstPos], &dstPtr[dstPos - (offset + 4)], count);
-            dstPos += count;
-        }
+size_t bsssld_depack_re3_span(const Uint8* srcPtr, size_t srcLen, Uint8* dstPtr, size_t dstCapacity) {
+    return sld_depack_span(srcPtr, srcLen, dstPtr, dstCapacity);
+}
+
+void bsssld_depack_re3(Uint8* srcPtr, size_t srcLen, Uint8** dstBufPtr, size_t* dstLength) {
+    size_t buflen;
+    Uint8* tmp;
+
+    *dstBufPtr = NULL;
+    *dstLength = 0;
+
+    buflen = bsssld_depack_re3_size(srcPtr, srcLen);
+    if (buflen == 0) {
+        return;
     }
 
-    *dstLength = dstPos;
-    *dstBufPtr = (Uint8*) realloc(dstPtr, *dstLength);
+    *dstBufPtr = (Uint8*) malloc(buflen);
+    if (!*dstBufPtr) {
+        return;
+    }
+
+    *dstLength = bsssld_depack_re3_span(srcPtr, srcLen, *dstBufPtr, buflen);
+    if (*dstLength == 0) {
+        free(*dstBufPtr);
+        *dstBufPtr = NULL;
+        return;
+    }
+
+    tmp = (Uint8*) realloc(*dstBufPtr, *dstLength);
+    if (tmp) {
+        *dstBufPtr = tmp;
+    }
 }
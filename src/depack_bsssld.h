@@ -21,7 +21,32 @@
 #ifndef DEPACK_BSSSLD_H
 #define DEPACK_BSSSLD_H
 
-void bsssld_depack_re2(Uint8* srcPtr, int srcLen, Uint8** dstBufPtr, int* dstLength);
-void bsssld_depack_re3(Uint8* srcPtr, int srcLen, Uint8** dstBufPtr, int* dstLength);
+void bsssld_depack_re2(Uint8* srcPtr, size_t srcLen, Uint8** dstBufPtr, size_t* dstLength);
+void bsssld_depack_re3(Uint8* srcPtr, size_t srcLen, Uint8** dstBufPtr, size_t* dstLength);
+
+/*
+    Maximum length of a depacked file, to allocate a buffer for
+    bsssld_depack_re2_span() or bsssld_depack_re3_span(). RE2 files give
+    it in their header, RE3 files give their number of blocks.
+
+    srcPtr	Packed file
+    srcLen	Length of packed file
+    Returns 0 if not a valid file
+*/
+size_t bsssld_depack_re2_size(const Uint8* srcPtr, size_t srcLen);
+size_t bsssld_depack_re3_size(const Uint8* srcPtr, size_t srcLen);
+
+/*
+    Depack a file to a buffer of the caller. Back references before start
+    of depacked data, and blocks past end of packed file, are rejected.
+
+    srcPtr	Packed file
+    srcLen	Length of packed file
+    dstPtr	Buffer for depacked file
+    dstCapacity	Length of buffer
+    Returns length of depacked file, 0 on error or if buffer is too small
+*/
+size_t bsssld_depack_re2_span(const Uint8* srcPtr, size_t srcLen, Uint8* dstPtr, size_t dstCapacity);
+size_t bsssld_depack_re3_span(const Uint8* srcPtr, size_t srcLen, Uint8* dstPtr, size_t dstCapacity);
 
 #endif /* DEPACK_BSSSLD_H */
@@ -25,9 +25,11 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "idctfst.h"
 
@@ -39,7 +41,7 @@
 #define RUNOF(a) ((a) >> 10)
 #define VALOF(a) ((short) ((a) << 6) >> 6)
 
-#define ROUND(r) bs_roundtbl[(r) + 256]
+#define ROUND(r) roundtbl[(r) + 256]
 
 #define SHIFT    12
 #define toFIX(a) (int) ((a) * (1 << SHIFT))
@@ -63,11 +65,11 @@ static const int aanscales[DCTSIZE2] = {
     6270, 5906, 5315, 4520, 3552, 2446, 1247
 };
 
-static unsigned char zscan[DCTSIZE2] = { 0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12,
+static const unsigned char zscan[DCTSIZE2] = { 0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12,
     19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29,
     22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63 };
 
-static unsigned char bs_iqtab[DCTSIZE2] = { 2, 16, 19, 22, 26, 27, 29, 34, 16, 16, 22, 24, 27, 29,
+static const unsigned char bs_iqtab[DCTSIZE2] = { 2, 16, 19, 22, 26, 27, 29, 34, 16, 16, 22, 24, 27, 29,
     34, 37, 19, 22, 26, 27, 29, 34, 34, 38, 22, 22, 26, 27, 29, 34, 37, 40, 22, 26, 27, 29, 32, 35,
     40, 48, 26, 27, 29, 32, 35, 40, 48, 58, 26, 27, 29, 34, 38, 46, 56, 69, 27, 29, 35, 38, 46, 56,
     69, 83 };
@@ -76,27 +78,20 @@ static unsigned char bs_iqtab[DCTSIZE2] = { 2, 16, 19, 22, 26, 27, 29, 34, 16, 1
 
 typedef struct {
     int iqtab[DCTSIZE2];
-    SDL_RWops* src;
+    Uint8 roundtbl[256 * 3];
+    rw_t* src;
 } bs_context_t;
 
-/*--- Variables ---*/
-
-static Uint16* dstPointer;
-static int dstBufLen;
-static int dstOffset;
-
-static Uint8 bs_roundtbl[256 * 3];
-
 /*--- Functions ---*/
 
-void rl2blk(bs_context_t* ctxt, BLOCK* blk) {
-    SDL_RWops* src = ctxt->src;
+static void rl2blk(bs_context_t* ctxt, BLOCK* blk) {
+    rw_t* src = ctxt->src;
 
     int i, k, q_scale, rl;
     memset(blk, 0, 6 * DCTSIZE2 * sizeof(BLOCK));
     for (i = 0; i < 6; i++) {
-        rl = SDL_ReadLE16(src);
-        /*printf("%d: 0x%04x, %d\n", i,rl, SDL_RWtell(src));*/
+        rl = rw_read_le16(src);
+        /*printf("%d: 0x%04x, %d\n", i,rl, rw_tell(src));*/
         if (rl == EOB) {
             continue;
         }
@@ -104,8 +99,8 @@ void rl2blk(bs_context_t* ctxt, BLOCK* blk) {
         blk[0] = ctxt->iqtab[0] * VALOF(rl);
         k = 0;
         for (;;) {
-            rl = SDL_ReadLE16(src);
-            /*printf("    0x%04x, 0x%08x\n", rl, SDL_RWtell(src));*/
+            rl = rw_read_le16(src);
+            /*printf("    0x%04x, 0x%08x\n", rl, rw_tell(src));*/
             if (rl == EOB) {
                 break;
             }
@@ -119,7 +114,8 @@ void rl2blk(bs_context_t* ctxt, BLOCK* blk) {
     }
 }
 
-static void yuv2rgb24(BLOCK* blk, Uint8 image[][3]) {
+static void yuv2rgb24(bs_context_t* ctxt, BLOCK* blk, Uint8 image[][3]) {
+    const Uint8* roundtbl = ctxt->roundtbl;
     int x, yy;
     BLOCK* yblk = blk + DCTSIZE2 * 2;
     for (yy = 0; yy < 16; yy += 2, blk += 4, yblk += 8, image += 8 + 16) {
@@ -177,16 +173,16 @@ static void dec_dct_out(bs_context_t* ctxt, Uint16* image, int size) {
 
     for (; size > 0; size -= blocksize >> 1, image += blocksize) {
         rl2blk(ctxt, blk);
-        yuv2rgb24(blk, (Uint8*) image);
+        yuv2rgb24(ctxt, blk, (Uint8(*)[3]) image);
     }
 }
 
-static void bs_init(void) {
+static void bs_init(bs_context_t* ctxt) {
     int i;
     for (i = 0; i < 256; i++) {
-        bs_roundtbl[i] = 0;
-        bs_roundtbl[i + 256] = i;
-        bs_roundtbl[i + 512] = 255;
+        ctxt->roundtbl[i] = 0;
+        ctxt->roundtbl[i + 256] = i;
+        ctxt->roundtbl[i + 512] = 255;
     }
 }
 
@@ -199,7 +195,7 @@ static void iqtab_init(bs_context_t* ctxt) {
     }
 }
 
-void mdec_depack(SDL_RWops* src, Uint8** dstBufPtr, int* dstLength, int width, int height) {
+void mdec_depack(rw_t* src, Uint8** dstBufPtr, size_t* dstLength, int width, int height) {
     bs_context_t ctxt;
     Uint16 vlc_id;
     int height2 = (height + 15) & ~15;
@@ -207,19 +203,17 @@ void mdec_depack(SDL_RWops* src, Uint8** dstBufPtr, int* dstLength, int width, i
     int w = 8 * 3;
     int slice = (height2 * w) >> 1;
     int x, y;
-    Uint16* image;
+    Uint16 *image, *dstPointer;
+    size_t dstBufLen;
 
     *dstBufPtr = NULL;
-    dstOffset = *dstLength = 0;
+    *dstLength = 0;
 
     ctxt.src = src;
 
-    printf("File position: %d\n", SDL_RWtell(src));
-    printf("Block length 0x%04x\n", SDL_ReadLE16(src));
-    // SDL_RWseek(src, 2, RW_SEEK_CUR); /* skip block length */
+    rw_seek(src, 2, RW_SEEK_CUR); /* skip block length */
 
-    printf("Reading vlc_id at %d\n", SDL_RWtell(src));
-    vlc_id = SDL_ReadLE16(src);
+    vlc_id = rw_read_le16(src);
     if (vlc_id != VLC_ID) {
         fprintf(stderr, "mdec: Unknown vlc id: 0x%04x\n", vlc_id);
         return;
@@ -240,7 +234,7 @@ void mdec_depack(SDL_RWops* src, Uint8** dstBufPtr, int* dstLength, int width, i
     }
 
     iqtab_init(&ctxt);
-    bs_init();
+    bs_init(&ctxt);
 
     for (x = 0; x < width2; x += w) {
         Uint16* imgDst = NULL;
@@ -261,41 +255,3 @@ void mdec_depack(SDL_RWops* src, Uint8** dstBufPtr, int* dstLength, int width, i
     *dstBufPtr = (Uint8*) dstPointer;
     *dstLength = dstBufLen;
 }
-
-SDL_Surface* mdec_surface(Uint8* source, int width, int height, int row_offset) {
-    SDL_Surface* surface;
-    Uint8* surface_line;
-    int x, y;
-    Uint32 rmask, gmask, bmask;
-
-    /* Source is BGR */
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-    rmask = 0xff << 16;
-    gmask = 0xff << 8;
-    bmask = 0xff;
-#else
-    rmask = 0xff;
-    gmask = 0xff << 8;
-    bmask = 0xff << 16;
-#endif
-
-    surface = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 24, rmask, gmask, bmask, 0);
-    if (!surface) {
-        return NULL;
-    }
-
-    surface_line = surface->pixels;
-    if (row_offset < 0) {
-        int num_pixels = -row_offset >> 1;
-        surface_line += surface->pitch * num_pixels;
-        surface_line += num_pixels * 3;
-        height -= num_pixels * 2;
-    }
-    for (y = 0; y < height; y++) {
-        memcpy(surface_line, source, (width + row_offset) * 3);
-        surface_line += surface->pitch;
-        source += (width + row_offset) * 3;
-    }
-
-    return surface;
-}
@@ -21,8 +21,10 @@
 #ifndef DEPACK_MDEC_H
 #define DEPACK_MDEC_H
 
-void mdec_depack(SDL_RWops* src, Uint8** dstPointer, int* dstLength, int width, int height);
-
-SDL_Surface* mdec_surface(Uint8* source, int width, int height, int row_offset);
+/*
+    Decode MDEC data to an image of red, green, blue bytes, with rows of
+    width * 3 bytes
+*/
+void mdec_depack(rw_t* src, Uint8** dstPointer, size_t* dstLength, int width, int height);
 
 #endif /* DEPACK_MDEC_H */
@@ -21,9 +21,13 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 
-#include <SDL.h>
+#include "rw.h"
+
+#include "depack_pak.h"
 
 /*--- Defines ---*/
 
@@ -39,101 +43,107 @@ typedef struct {
     long value;
 } re1_pack_t;
 
-/*--- Variables ---*/
-
-static Uint8* dstPointer;
-static int dstBufLen;
-static int dstOffset;
+struct pak_context_s {
+    Uint8* dstPointer;
+    size_t dstBufLen;
+    size_t dstOffset;
 
-static unsigned char srcByte;
-static int tmpMask;
+    unsigned char srcByte;
+    int tmpMask;
 
-static re1_pack_t tmpArray2[DECODE_SIZE];
-static unsigned char decodeStack[DECODE_SIZE];
+    re1_pack_t tmpArray2[DECODE_SIZE];
+    unsigned char decodeStack[DECODE_SIZE];
+};
 
 /*--- Functions ---*/
 
-static int pak_read_bits(SDL_RWops* src, int num_bits) {
+pak_context_t* pak_context_create(void) {
+    return (pak_context_t*) calloc(1, sizeof(pak_context_t));
+}
+
+void pak_context_destroy(pak_context_t* ctxt) { free(ctxt); }
+
+static int pak_read_bits(pak_context_t* ctxt, rw_t* src, int num_bits) {
     unsigned long value = 0, mask;
 
     mask = 1 << (--num_bits);
 
     while (mask > 0) {
-        if (tmpMask == 0x80) {
-            if (!SDL_RWread(src, &srcByte, 1, 1)) {
-                srcByte = 0;
+        if (ctxt->tmpMask == 0x80) {
+            if (!rw_read(src, &ctxt->srcByte, 1, 1)) {
+                ctxt->srcByte = 0;
             }
-            /*srcByte = srcPointer[srcOffset++];*/
+            /*ctxt->srcByte = srcPointer[srcOffset++];*/
         }
 
-        if ((tmpMask & srcByte) != 0) {
+        if ((ctxt->tmpMask & ctxt->srcByte) != 0) {
             value |= mask;
         }
 
-        tmpMask >>= 1;
+        ctxt->tmpMask >>= 1;
         mask >>= 1;
 
-        if (tmpMask == 0) {
-            tmpMask = 0x80;
+        if (ctxt->tmpMask == 0) {
+            ctxt->tmpMask = 0x80;
         }
     }
 
     return value;
 }
 
-static int pak_decodeString(int decodeStackOffset, unsigned long code) {
-    while (code > 255) {
-        decodeStack[decodeStackOffset++] = tmpArray2[code].value;
-        code = tmpArray2[code].index;
+static int pak_decodeString(pak_context_t* ctxt, int decodeStackOffset, unsigned long code) {
+    while ((code > 255) && (code < DECODE_SIZE) && (decodeStackOffset < DECODE_SIZE - 1)) {
+        ctxt->decodeStack[decodeStackOffset++] = ctxt->tmpArray2[code].value;
+        code = ctxt->tmpArray2[code].index;
     }
-    decodeStack[decodeStackOffset] = code;
+    ctxt->decodeStack[decodeStackOffset] = code;
 
     return decodeStackOffset;
 }
 
-static void pak_write_dest(Uint8 value) {
-    if ((dstPointer == NULL) || (dstOffset >= dstBufLen)) {
-        dstBufLen += CHUNK_SIZE;
-        dstPointer = realloc(dstPointer, dstBufLen);
-        if (dstPointer == NULL) {
-            fprintf(stderr, "pak: can not allocate %d bytes\n", dstBufLen);
+static void pak_write_dest(pak_context_t* ctxt, Uint8 value) {
+    if ((ctxt->dstPointer == NULL) || (ctxt->dstOffset >= ctxt->dstBufLen)) {
+        ctxt->dstBufLen += CHUNK_SIZE;
+        ctxt->dstPointer = realloc(ctxt->dstPointer, ctxt->dstBufLen);
+        if (ctxt->dstPointer == NULL) {
+            fprintf(stderr, "pak: can not allocate %" PRIu64 " bytes\n", (Uint64) ctxt->dstBufLen);
             return;
         }
     }
 
-    dstPointer[dstOffset++] = value;
+    ctxt->dstPointer[ctxt->dstOffset++] = value;
 }
 
-void pak_depack(SDL_RWops* src, Uint8** dstBufPtr, int* dstLength) {
+void pak_depack_ctxt(pak_context_t* ctxt, rw_t* src, Uint8** dstBufPtr, size_t* dstLength) {
     int num_bits_to_read, i;
     int lzwnew, c, lzwold, lzwnext;
     int stop = 0;
 
-    *dstBufPtr = dstPointer = NULL;
-    *dstLength = dstBufLen = dstOffset = 0;
+    *dstBufPtr = ctxt->dstPointer = NULL;
+    *dstLength = ctxt->dstBufLen = ctxt->dstOffset = 0;
 
-    tmpMask = 0x80;
-    srcByte = 0;
+    ctxt->tmpMask = 0x80;
+    ctxt->srcByte = 0;
 
-    memset(tmpArray2, 0, sizeof(tmpArray2));
+    memset(ctxt->tmpArray2, 0, sizeof(ctxt->tmpArray2));
 
     while (!stop) {
         for (i = 0; i < DECODE_SIZE; i++) {
-            tmpArray2[i].flag = 0xffffffff;
+            ctxt->tmpArray2[i].flag = 0xffffffff;
         }
         lzwnext = 0x103;
         num_bits_to_read = 9;
 
-        c = lzwold = pak_read_bits(src, num_bits_to_read);
+        c = lzwold = pak_read_bits(ctxt, src, num_bits_to_read);
 
         if (lzwold == 0x100) {
             break;
         }
 
-        pak_write_dest(c);
+        pak_write_dest(ctxt, c);
 
         for (;;) {
-            lzwnew = pak_read_bits(src, num_bits_to_read);
+            lzwnew = pak_read_bits(ctxt, src, num_bits_to_read);
 
             if (lzwnew == 0x100) {
                 stop = 1;
@@ -149,21 +159,27 @@ void pak_depack(SDL_RWops* src, Uint8** dstBufPtr, int* dstLength) {
                 continue;
             }
 
+            /* Corrupt stream */
+            if ((lzwnew >= DECODE_SIZE) || (lzwnext >= DECODE_SIZE)) {
+                stop = 1;
+                break;
+            }
+
             if (lzwnew >= lzwnext) {
-                decodeStack[0] = c;
-                i = pak_decodeString(1, lzwold);
+                ctxt->decodeStack[0] = c;
+                i = pak_decodeString(ctxt, 1, lzwold);
             } else {
-                i = pak_decodeString(0, lzwnew);
+                i = pak_decodeString(ctxt, 0, lzwnew);
             }
 
-            c = decodeStack[i];
+            c = ctxt->decodeStack[i];
 
             while (i >= 0) {
-                pak_write_dest(decodeStack[i--]);
+                pak_write_dest(ctxt, ctxt->decodeStack[i--]);
             }
 
-            tmpArray2[lzwnext].index = lzwold;
-            tmpArray2[lzwnext].value = c;
+            ctxt->tmpArray2[lzwnext].index = lzwold;
+            ctxt->tmpArray2[lzwnext].value = c;
             lzwnext++;
 
             lzwold = lzwnew;
@@ -171,6 +187,22 @@ void pak_depack(SDL_RWops* src, Uint8** dstBufPtr, int* dstLength) {
     }
 
     /* Return depacked buffer */
-    *dstBufPtr = (Uint8*) dstPointer;
-    *dstLength = dstOffset;
+    *dstBufPtr = (Uint8*) ctxt->dstPointer;
+    *dstLength = ctxt->dstOffset;
+    ctxt->dstPointer = NULL;
+}
+
+void pak_depack(rw_t* src, Uint8** dstBufPtr, size_t* dstLength) {
+    pak_context_t* ctxt;
+
+    *dstBufPtr = NULL;
+    *dstLength = 0;
+
+    ctxt = pak_context_create();
+    if (!ctxt) {
+        fprintf(stderr, "pak: can not allocate memory for context\n");
+        return;
+    }
+    pak_depack_ctxt(ctxt, src, dstBufPtr, dstLength);
+    pak_context_destroy(ctxt);
 }
@@ -21,6 +21,32 @@
 #ifndef DEPACK_PAK_H
 #define DEPACK_PAK_H
 
-void pak_depack(SDL_RWops* src, Uint8** dstPointer, int* dstLength);
+/*--- Types ---*/
+
+typedef struct pak_context_s pak_context_t;
+
+/*--- Functions ---*/
+
+/*
+    Context holds the dictionary, it can be reused for several files, but
+    used by a single thread at a time.
+
+    Returns NULL on error
+*/
+pak_context_t* pak_context_create(void);
+void pak_context_destroy(pak_context_t* ctxt);
+
+/*
+    Depack a PAK file
+
+    ctxt	Context
+    src		Source file
+    dstPointer	Pointer to depacked file buffer (NULL if failed)
+    dstLength	Length of depacked file (0 if failed)
+*/
+void pak_depack_ctxt(pak_context_t* ctxt, rw_t* src, Uint8** dstPointer, size_t* dstLength);
+
+/* Same, with a temporary context */
+void pak_depack(rw_t* src, Uint8** dstPointer, size_t* dstLength);
 
 #endif /* DEPACK_PAK_H */
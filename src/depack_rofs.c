@@ -0,0 +1,601 @@
+/*
+    ROFS archive access
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rw.h"
+
+#include "depack_rofs.h"
+
+/*--- Defines ---*/
+
+#define ROFS_BLOCK_SIZE   32768 /* Depacked size of a compressed block */
+#define ROFS_CACHE_BLOCKS 4     /* Number of depacked blocks kept in cache */
+
+/*--- Types ---*/
+
+struct rofs_file_s {
+    rofs_t* rofs;        /* Archive this file belongs to */
+    char filename[512];  /* level1/level2/name */
+    Sint64 offset;       /* Offset of crypt header in archive */
+    int loaded;          /* Crypt header and block table read */
+    int compressed;
+    Uint32 length; /* Depacked length */
+    int num_blocks;
+    Uint32* block_keys;
+    Uint32* block_lengths; /* Length of block in archive */
+    Sint64* block_offsets; /* Offset of block in archive */
+    Uint32* block_starts;  /* Offset of block in depacked file */
+};
+
+typedef struct {
+    rofs_file_t* file; /* NULL if slot unused */
+    int block;
+    Uint32 length;    /* Depacked length of block */
+    Uint32 last_used; /* For LRU replacement */
+    Uint8* data;
+    Uint32 data_size;
+} rofs_cache_t;
+
+struct rofs_s {
+    rw_t* src;
+    char dir_level1[256];
+    char dir_level2[256];
+    int num_files;
+    rofs_file_t* files;
+    rofs_cache_t cache[ROFS_CACHE_BLOCKS];
+    Uint32 cache_clock;
+    Uint8 window[4096 + 256]; /* Dictionary of depacker */
+};
+
+typedef struct {
+    Uint8 unknown[4 * 5 + 1];
+} rofs_header_t;
+
+/*typedef struct {
+    Uint8 *dirname[];
+} rofs_dir_level1_t;*/
+
+typedef struct {
+    Uint32 offset;
+    Uint32 length;
+    /*Uint8 *dirname[];*/
+} rofs_dir_level2_t;
+
+typedef struct {
+    Uint32 offset;
+    Uint32 length;
+    /*Uint8 *filename[];*/
+} rofs_file_header_t;
+
+typedef struct {
+    Uint16 offset;
+    Uint16 num_keys;
+    Uint32 length;
+    Uint8 ident[8];
+} rofs_crypt_header_t;
+
+/*--- Const ---*/
+
+static const unsigned short base_array[64] = { 0x00e6, 0x01a4, 0x00e6, 0x01c5, 0x0130, 0x00e8,
+    0x03db, 0x008b, 0x0141, 0x018e, 0x03ae, 0x0139, 0x00f0, 0x027a, 0x02c9, 0x01b0, 0x01f7, 0x0081,
+    0x0138, 0x0285, 0x025a, 0x015b, 0x030f, 0x0335, 0x02e4, 0x01f6, 0x0143, 0x00d1, 0x0337, 0x0385,
+    0x007b, 0x00c6, 0x0335, 0x0141, 0x0186, 0x02a1, 0x024d, 0x0342, 0x01fb, 0x03e5, 0x01b0, 0x006d,
+    0x0140, 0x00c0, 0x0386, 0x016b, 0x020b, 0x009a, 0x0241, 0x00de, 0x015e, 0x035a, 0x025b, 0x0154,
+    0x0068, 0x02e8, 0x0321, 0x0071, 0x01b0, 0x0232, 0x02d9, 0x0263, 0x0164, 0x0290 };
+
+/*--- Function prototypes ---*/
+
+static size_t rofs_name_length(const Uint8* name, size_t max_length);
+static int rofs_load_file(rofs_file_t* file);
+static rofs_cache_t* rofs_get_block(rofs_file_t* file, int block);
+
+static Uint8 re3_next_key(Uint32* key);
+static void decrypt_block(Uint8* src, Uint32 key, Uint32 length);
+static void depack_block(Uint8* window, Uint8* src, Uint32 srcLength, Uint32* dstLength);
+
+/*--- Functions ---*/
+
+rofs_t* rofs_open(const char* filename) {
+    rofs_t* rofs;
+    Uint8 rofs_header[4096];
+    const char *dir_level1_name, *dir_level2_name;
+    size_t name1_length, name2_length;
+    rofs_dir_level2_t dir_level2;
+    Sint64 offset;
+    Uint32 num_files;
+    int i;
+
+    rofs = (rofs_t*) calloc(1, sizeof(rofs_t));
+    if (!rofs) {
+        fprintf(stderr, "Can not allocate memory for archive\n");
+        return NULL;
+    }
+
+    rofs->src = rw_from_file(filename, "rb");
+    if (!rofs->src) {
+        fprintf(stderr, "Can not open %s\n", filename);
+        free(rofs);
+        return NULL;
+    }
+
+    /* Read header */
+    memset(rofs_header, 0, sizeof(rofs_header));
+    rw_read(rofs->src, rofs_header, 4096, 1);
+
+    /* Level1 directory */
+    offset = sizeof(rofs_header_t);
+    dir_level1_name = (const char*) &rofs_header[offset];
+    name1_length = rofs_name_length(&rofs_header[offset], sizeof(rofs_header) - offset);
+
+    /* Level2 directory */
+    offset += name1_length + 1;
+    if (offset + sizeof(rofs_dir_level2_t) >= sizeof(rofs_header)) {
+        fprintf(stderr, "%s: invalid header\n", filename);
+        rofs_close(rofs);
+        return NULL;
+    }
+    memcpy(&dir_level2, &rofs_header[offset], sizeof(rofs_dir_level2_t));
+    offset += sizeof(rofs_dir_level2_t);
+    dir_level2_name = (const char*) &rofs_header[offset];
+    name2_length = rofs_name_length(&rofs_header[offset], sizeof(rofs_header) - offset);
+
+    if ((name1_length >= sizeof(rofs->dir_level1)) || (name2_length >= sizeof(rofs->dir_level2))) {
+        fprintf(stderr, "%s: invalid header\n", filename);
+        rofs_close(rofs);
+        return NULL;
+    }
+    memcpy(rofs->dir_level1, dir_level1_name, name1_length);
+    memcpy(rofs->dir_level2, dir_level2_name, name2_length);
+
+    offset = (Sint64) rw_swap_le32(dir_level2.offset) * 8;
+    rw_seek(rofs->src, offset, RW_SEEK_SET);
+
+    /* Number of files */
+    num_files = 0;
+    rw_read(rofs->src, &num_files, 4, 1);
+    num_files = rw_swap_le32(num_files);
+
+    rofs->files = (rofs_file_t*) calloc(num_files, sizeof(rofs_file_t));
+    if (!rofs->files) {
+        fprintf(stderr, "Can not allocate memory for %d files\n", num_files);
+        rofs_close(rofs);
+        return NULL;
+    }
+
+    for (i = 0; i < num_files; i++) {
+        rofs_file_t* file = &rofs->files[i];
+        rofs_file_header_t file_hdr;
+        int j;
+
+        /* Read file header */
+        if (!rw_read(rofs->src, &file_hdr, sizeof(file_hdr), 1)) {
+            break;
+        }
+        file->rofs = rofs;
+        file->offset = (Sint64) rw_swap_le32(file_hdr.offset) * 8;
+
+        /* Read file name */
+        j = snprintf(file->filename, sizeof(file->filename), "%s/%s/", rofs->dir_level1, rofs->dir_level2);
+        if ((j < 0) || (j >= (int) sizeof(file->filename) - 1)) {
+            fprintf(stderr, "%s: names of directories too long\n", filename);
+            break;
+        }
+        for (; j < sizeof(file->filename) - 1; j++) {
+            if (!rw_read(rofs->src, &file->filename[j], 1, 1)) {
+                break;
+            }
+            if (file->filename[j] == 0) {
+                break;
+            }
+        }
+        file->filename[j] = 0;
+
+        rofs->num_files++;
+    }
+
+    return rofs;
+}
+
+/* Length of a name in header, which may not be terminated if broken */
+static size_t rofs_name_length(const Uint8* name, size_t max_length) {
+    const Uint8* end = (const Uint8*) memchr(name, 0, max_length);
+
+    return (end ? (size_t) (end - name) : max_length);
+}
+
+rofs_file_t* rofs_find(rofs_t* rofs, const char* filename) {
+    int i;
+
+    for (i = 0; i < rofs->num_files; i++) {
+#ifdef WIN32
+        if (_stricmp(filename, rofs->files[i].filename) != 0) {
+            continue;
+        }
+#else
+        if (strcasecmp(filename, rofs->files[i].filename) != 0) {
+            continue;
+        }
+#endif
+
+        return rofs_file(rofs, i);
+    }
+
+    return NULL;
+}
+
+rofs_file_t* rofs_file(rofs_t* rofs, int index) {
+    rofs_file_t* file;
+
+    if ((index < 0) || (index >= rofs->num_files)) {
+        return NULL;
+    }
+
+    file = &rofs->files[index];
+    if (!file->loaded && !rofs_load_file(file)) {
+        return NULL;
+    }
+
+    return file;
+}
+
+int rofs_num_files(rofs_t* rofs) {
+    return rofs->num_files;
+}
+
+const char* rofs_dir_level1(rofs_t* rofs) {
+    return rofs->dir_level1;
+}
+
+const char* rofs_dir_level2(rofs_t* rofs) {
+    return rofs->dir_level2;
+}
+
+const char* rofs_file_name(rofs_file_t* file) {
+    return file->filename;
+}
+
+Uint32 rofs_file_length(rofs_file_t* file) {
+    return file->length;
+}
+
+Uint32 rofs_read(rofs_file_t* file, Uint32 offset, void* buffer, Uint32 length) {
+    Uint8* dst = (Uint8*) buffer;
+    Uint32 done = 0;
+    int block, lo, hi;
+
+    if (!file->loaded && !rofs_load_file(file)) {
+        return 0;
+    }
+
+    if ((offset >= file->length) || (file->num_blocks == 0)) {
+        return 0;
+    }
+    if (length > file->length - offset) {
+        length = file->length - offset;
+    }
+
+    /* Find first block covering offset */
+    lo = 0;
+    hi = file->num_blocks - 1;
+    while (lo < hi) {
+        block = (lo + hi + 1) >> 1;
+        if (file->block_starts[block] <= offset) {
+            lo = block;
+        } else {
+            hi = block - 1;
+        }
+    }
+    block = lo;
+
+    for (; (block < file->num_blocks) && (done < length); block++) {
+        rofs_cache_t* cache;
+        Uint32 block_offset, count;
+
+        cache = rofs_get_block(file, block);
+        if (!cache) {
+            break;
+        }
+
+        block_offset = offset + done - file->block_starts[block];
+        if (block_offset >= cache->length) {
+            /* Block depacked short, fill until next one */
+            count = (block + 1 < file->num_blocks ? file->block_starts[block + 1] : file->length) -
+                    (offset + done);
+            if (count > length - done) {
+                count = length - done;
+            }
+            memset(&dst[done], 0, count);
+            done += count;
+            continue;
+        }
+
+        count = cache->length - block_offset;
+        if (count > length - done) {
+            count = length - done;
+        }
+
+        memcpy(&dst[done], &cache->data[block_offset], count);
+        done += count;
+    }
+
+    return done;
+}
+
+void rofs_close(rofs_t* rofs) {
+    int i;
+
+    if (!rofs) {
+        return;
+    }
+
+    for (i = 0; i < ROFS_CACHE_BLOCKS; i++) {
+        free(rofs->cache[i].data);
+    }
+
+    if (rofs->files) {
+        for (i = 0; i < rofs->num_files; i++) {
+            free(rofs->files[i].block_keys);
+            free(rofs->files[i].block_offsets);
+        }
+        free(rofs->files);
+    }
+
+    if (rofs->src) {
+        rw_close(rofs->src);
+    }
+
+    free(rofs);
+}
+
+/* Read crypt header and block table of a file */
+static int rofs_load_file(rofs_file_t* file) {
+    rw_t* src = file->rofs->src;
+    rofs_crypt_header_t crypt_hdr;
+    Uint32 *array_keys, start;
+    Sint64 *array_offsets, offset;
+    int i, num_keys;
+
+    rw_seek(src, file->offset, RW_SEEK_SET);
+    if (!rw_read(src, &crypt_hdr, sizeof(rofs_crypt_header_t), 1)) {
+        fprintf(stderr, "Can not read header of %s\n", file->filename);
+        return 0;
+    }
+
+    for (i = 0; i < 8; i++) {
+        crypt_hdr.ident[i] ^= crypt_hdr.ident[7];
+    }
+    file->compressed = (strcmp("Hi_Comp", (const char*) crypt_hdr.ident) == 0);
+
+    /* Read decryption keys, then block lengths */
+    num_keys = rw_swap_le16(crypt_hdr.num_keys);
+    array_keys = calloc(num_keys * 3 + 1, sizeof(Uint32));
+    array_offsets = calloc(num_keys + 1, sizeof(Sint64));
+    if (!array_keys || !array_offsets) {
+        fprintf(stderr, "Can not allocate memory for keys\n");
+        free(array_offsets);
+        free(array_keys);
+        return 0;
+    }
+    if (rw_read(src, array_keys, sizeof(Uint32), num_keys * 2) != (size_t) num_keys * 2) {
+        fprintf(stderr, "Can not read blocks of %s\n", file->filename);
+        free(array_offsets);
+        free(array_keys);
+        return 0;
+    }
+    for (i = 0; i < num_keys * 2; i++) {
+        array_keys[i] = rw_swap_le32(array_keys[i]);
+    }
+
+    file->block_keys = array_keys;
+    file->block_lengths = &array_keys[num_keys];
+    file->block_starts = &array_keys[num_keys * 2];
+    file->block_offsets = array_offsets;
+    file->num_blocks = num_keys;
+    file->length = rw_swap_le32(crypt_hdr.length);
+
+    /* Locate each block, in archive and in depacked file */
+    offset = file->offset + rw_swap_le16(crypt_hdr.offset);
+    start = 0;
+    for (i = 0; i < num_keys; i++) {
+        Uint32 block_length = file->block_lengths[i];
+
+        if (!file->compressed && (start + block_length > file->length)) {
+            block_length = (start < file->length ? file->length - start : 0);
+        }
+
+        file->block_offsets[i] = offset;
+        file->block_lengths[i] = block_length;
+        file->block_starts[i] = start;
+
+        offset += block_length;
+        start += (file->compressed ? ROFS_BLOCK_SIZE : block_length);
+    }
+
+    file->loaded = 1;
+    return 1;
+}
+
+/* Return cached depacked block, read and depack it if needed */
+static rofs_cache_t* rofs_get_block(rofs_file_t* file, int block) {
+    rofs_t* rofs = file->rofs;
+    rofs_cache_t* cache = NULL;
+    Uint32 block_length, size;
+    int i;
+
+    for (i = 0; i < ROFS_CACHE_BLOCKS; i++) {
+        if ((rofs->cache[i].file == file) && (rofs->cache[i].block == block)) {
+            rofs->cache[i].last_used = ++rofs->cache_clock;
+            return &rofs->cache[i];
+        }
+    }
+
+    /* Replace least recently used block */
+    for (i = 0; i < ROFS_CACHE_BLOCKS; i++) {
+        if (!cache || (rofs->cache[i].last_used < cache->last_used)) {
+            cache = &rofs->cache[i];
+        }
+    }
+
+    block_length = file->block_lengths[block];
+    size = (block_length > ROFS_BLOCK_SIZE ? block_length : ROFS_BLOCK_SIZE) + 16;
+    if (cache->data_size < size) {
+        Uint8* data = realloc(cache->data, size);
+        if (!data) {
+            fprintf(stderr, "Can not allocate memory for block\n");
+            return NULL;
+        }
+        cache->data = data;
+        cache->data_size = size;
+    }
+
+    /* Slot is invalid until block is read */
+    cache->file = NULL;
+
+    rw_seek(rofs->src, file->block_offsets[block], RW_SEEK_SET);
+    if ((block_length > 0) && (rw_read(rofs->src, cache->data, block_length, 1) != 1)) {
+        fprintf(stderr, "Can not read block %d of %s\n", block, file->filename);
+        return NULL;
+    }
+
+    /* Decrypt */
+    decrypt_block(cache->data, file->block_keys[block], block_length);
+
+    /* Depack */
+    if (file->compressed) {
+        Uint32 dstBlock = ROFS_BLOCK_SIZE;
+        depack_block(rofs->window, cache->data, block_length, &dstBlock);
+        if (dstBlock != 0) {
+            block_length = dstBlock;
+        }
+    }
+
+    cache->file = file;
+    cache->block = block;
+    cache->length = block_length;
+    cache->last_used = ++rofs->cache_clock;
+
+    return cache;
+}
+
+static Uint8 re3_next_key(Uint32* key) {
+    *key *= 0x5d588b65;
+    *key += 0x8000000b;
+
+    return (*key >> 24);
+}
+
+static void decrypt_block(Uint8* src, Uint32 key, Uint32 length) {
+    Uint8 xor_key, base_index;
+    int i, block_index;
+
+    xor_key = re3_next_key(&key);
+    base_index = re3_next_key(&key) % 0x3f;
+
+    block_index = 0;
+    for (i = 0; i < length; i++) {
+        if (block_index > base_array[base_index]) {
+            base_index = re3_next_key(&key) % 0x3f;
+            xor_key = re3_next_key(&key);
+            block_index = 0;
+        }
+        src[i] ^= xor_key;
+        block_index++;
+    }
+}
+
+static void depack_block(Uint8* window, Uint8* dst, Uint32 srcLength, Uint32* dstLength) {
+    int srcNumBit, srcIndex, tmpIndex, dstIndex;
+    int i, value, value2, tmpStart, tmpLength;
+    Uint8* src;
+
+    for (i = 0; i < 256; i++) {
+        memset(&window[i * 16], i, 16);
+    }
+    memset(&window[4096], 0, 256);
+
+    /* Copy source to a temp copy */
+    src = (Uint8*) malloc(srcLength);
+    if (!src) {
+        fprintf(stderr, "Can not allocate memory for depacking\n");
+        *dstLength = 0;
+        return;
+    }
+    memcpy(src, dst, srcLength);
+
+    /*printf("Depacking %08x to %08x, len %d\n", src,dst,length);*/
+
+    srcNumBit = 0;
+    srcIndex = 0;
+    tmpIndex = 0;
+    dstIndex = 0;
+    while ((srcIndex < srcLength) && (dstIndex < *dstLength)) {
+        srcNumBit++;
+
+        value = src[srcIndex++] << srcNumBit;
+        if (srcIndex < srcLength) {
+            value |= src[srcIndex] >> (8 - srcNumBit);
+        }
+
+        if (srcNumBit == 8) {
+            srcIndex++;
+            srcNumBit = 0;
+        }
+
+        if ((value & (1 << 8)) == 0) {
+            dst[dstIndex++] = window[tmpIndex++] = value;
+        } else {
+            /* Back reference cut by end of block */
+            if (srcIndex >= srcLength) {
+                break;
+            }
+            value2 = (src[srcIndex++] << srcNumBit) & 0xff;
+            if (srcIndex < srcLength) {
+                value2 |= src[srcIndex] >> (8 - srcNumBit);
+            }
+
+            tmpLength = (value2 & 0x0f) + 2;
+
+            tmpStart = (value2 >> 4) & 0xfff;
+            tmpStart |= (value & 0xff) << 4;
+
+            if (dstIndex + tmpLength > *dstLength) {
+                tmpLength = (*dstLength) - dstIndex;
+            }
+
+            memcpy(&dst[dstIndex], &window[tmpStart], tmpLength);
+            memcpy(&window[tmpIndex], &dst[dstIndex], tmpLength);
+
+            dstIndex += tmpLength;
+            tmpIndex += tmpLength;
+        }
+
+        if (tmpIndex >= 4096) {
+            tmpIndex = 0;
+        }
+    }
+
+    /*printf("Depacked to %d len\n", dstIndex);*/
+
+    free(src);
+    *dstLength = dstIndex;
+}
@@ -0,0 +1,98 @@
+/*
+    ROFS archive access
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef DEPACK_ROFS_H
+#define DEPACK_ROFS_H
+
+/*--- Types ---*/
+
+/* Contents are private to depack_rofs.c, use functions below */
+typedef struct rofs_s rofs_t;
+typedef struct rofs_file_s rofs_file_t;
+
+/*--- Functions ---*/
+
+/*
+    Open a ROFS archive and read its directory. An archive holds a cache
+    and depacker state, so it is used by a single thread at a time. Open it
+    once per thread to read it in parallel.
+
+    filename	Archive to open
+    Returns NULL if failed
+*/
+rofs_t* rofs_open(const char* filename);
+
+/*
+    Find a file in archive, case insensitive
+
+    rofs		Archive
+    filename	Path of file, for example DATA_A/BSS/R100.BSS
+    Returns NULL if not found
+*/
+rofs_file_t* rofs_find(rofs_t* rofs, const char* filename);
+
+/*
+    Get a file by its index in directory
+
+    rofs		Archive
+    index		Index of file, from 0 to rofs_num_files()-1
+    Returns NULL if file header can not be read
+*/
+rofs_file_t* rofs_file(rofs_t* rofs, int index);
+
+/*
+    Get number of files in archive
+*/
+int rofs_num_files(rofs_t* rofs);
+
+/*
+    Get names of the two directory levels in archive, for example DATA_A
+    and BSS
+*/
+const char* rofs_dir_level1(rofs_t* rofs);
+const char* rofs_dir_level2(rofs_t* rofs);
+
+/*
+    Get path of a file, for example DATA_A/BSS/R100.BSS
+*/
+const char* rofs_file_name(rofs_file_t* file);
+
+/*
+    Get depacked length of a file
+*/
+Uint32 rofs_file_length(rofs_file_t* file);
+
+/*
+    Read part of a file, only the blocks covering the range are depacked
+
+    file		File to read from
+    offset		Offset in depacked file
+    buffer		Destination buffer
+    length		Number of bytes to read
+    Returns number of bytes read, less than length if archive is truncated
+*/
+Uint32 rofs_read(rofs_file_t* file, Uint32 offset, void* buffer, Uint32 length);
+
+/*
+    Close archive, free directory and cache
+*/
+void rofs_close(rofs_t* rofs);
+
+#endif /* DEPACK_ROFS_H */
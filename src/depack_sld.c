@@ -20,61 +20,185 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 
-#include <SDL.h>
+#include "rw.h"
+
+#include "depack_sld.h"
+
+/*--- Defines ---*/
+
+/* Longest block: one byte then 127 literal bytes */
+#define MAX_BLOCK_LENGTH 128
+
+/*--- Function prototypes ---*/
+
+static size_t sld_depack_blocks(const Uint8* src, size_t srcLen, Uint8* dst, size_t dstCapacity,
+    size_t* srcUsed);
 
 /*--- Functions ---*/
 
-void sld_depack(SDL_RWops* src, Uint8** dstBufPtr, int* dstLength) {
-    Uint32 numblocks, buflen = 65536;
-    Uint8 start, *dst;
-    int i, j, count, offset, dstIndex = 0;
+/* Packed file is read up to its longest possible length, then depacked in memory */
+void sld_depack(rw_t* src, Uint8** dstBufPtr, size_t* dstLength) {
+    Sint64 start, end;
+    Uint8 *packed, *dst, *tmp;
+    Uint32 numblocks;
+    size_t srcLen, srcUsed = 0, length;
 
     *dstBufPtr = NULL;
     *dstLength = 0;
 
-    SDL_RWread(src, &numblocks, sizeof(Uint32), 1);
-    numblocks = SDL_SwapLE32(numblocks);
-    if (numblocks == 0) {
+    start = rw_tell(src);
+    end = rw_seek(src, 0, RW_SEEK_END);
+    rw_seek(src, start, RW_SEEK_SET);
+    if ((start < 0) || (end - start < 4)) {
+        return;
+    }
+
+    numblocks = rw_read_le32(src);
+    rw_seek(src, start, RW_SEEK_SET);
+    if ((Uint64) numblocks * MAX_BLOCK_LENGTH < (Uint64) (end - start - 4)) {
+        end = start + 4 + (Sint64) numblocks * MAX_BLOCK_LENGTH;
+    }
+    if ((Uint64) (end - start) > (size_t) -1) {
+        return;
+    }
+    srcLen = (size_t) (end - start);
+
+    packed = (Uint8*) malloc(srcLen);
+    if (!packed) {
+        return;
+    }
+    if (rw_read(src, packed, srcLen, 1) != 1) {
+        free(packed);
+        rw_seek(src, start, RW_SEEK_SET);
         return;
     }
 
-    dst = malloc(buflen);
+    length = sld_depack_size(packed, srcLen);
+    dst = (length ? (Uint8*) malloc(length) : NULL);
+    if (dst) {
+        length = sld_depack_blocks(packed, srcLen, dst, length, &srcUsed);
+        if (length == 0) {
+            free(dst);
+            dst = NULL;
+        }
+    }
+    free(packed);
+
+    /* Stream is left after packed file */
+    rw_seek(src, start + srcUsed, RW_SEEK_SET);
+    if (!dst) {
+        return;
+    }
+
+    tmp = (Uint8*) realloc(dst, length);
+    *dstBufPtr = (tmp ? tmp : dst);
+    *dstLength = length;
+}
+
+/* Literal blocks give at most 127 bytes, back references 33 bytes from 2 bytes */
+size_t sld_depack_size(const Uint8* src, size_t srcLen) {
+    Uint32 numblocks;
+    size_t length;
+
+    if (srcLen < 4) {
+        return 0;
+    }
+    numblocks = src[0] | (src[1] << 8) | (src[2] << 16) | ((Uint32) src[3] << 24);
+
+    length = (srcLen - 4) / 2 * 33;
+    if (numblocks < length / 127) {
+        length = (size_t) numblocks * 127;
+    }
+    return length;
+}
+
+size_t sld_depack_span(const Uint8* src, size_t srcLen, Uint8* dst, size_t dstCapacity) {
+    size_t srcUsed;
+
+    return sld_depack_blocks(src, srcLen, dst, dstCapacity, &srcUsed);
+}
+
+/* Same as sld_depack_span(), also gives length of packed file */
+static size_t sld_depack_blocks(const Uint8* src, size_t srcLen, Uint8* dst, size_t dstCapacity,
+    size_t* srcUsed) {
+    Uint32 numblocks, i;
+    size_t srcIndex = 4, dstIndex = 0;
+    int j, count, offset;
+
+    if (srcLen < 4) {
+        return 0;
+    }
+    numblocks = src[0] | (src[1] << 8) | (src[2] << 16) | ((Uint32) src[3] << 24);
 
     for (i = 0; i < numblocks; i++) {
-        SDL_RWread(src, &start, sizeof(Uint8), 1);
+        Uint8 start;
+
+        if (srcIndex >= srcLen) {
+            return 0;
+        }
+        start = src[srcIndex++];
+
         if (start & 0x80) {
             count = start & 0x7f;
-
-            if (dstIndex + count > buflen) {
-                buflen += 65536;
-                dst = realloc(dst, buflen);
+            if ((count > srcLen - srcIndex) || (count > dstCapacity - dstIndex)) {
+                return 0;
             }
 
-            SDL_RWread(src, &dst[dstIndex], count, 1);
-            dstIndex += count;
+            memcpy(&dst[dstIndex], &src[srcIndex], count);
+            srcIndex += count;
         } else {
-            Uint32 tmp = start << 8;
-
-            SDL_RWread(src, &start, sizeof(Uint8), 1);
-            tmp |= start;
+            Uint32 value;
 
-            offset = (tmp & 0x7ff) + 4;
-            count = (tmp >> 11) + 2;
+            if (srcIndex >= srcLen) {
+                return 0;
+            }
+            value = (start << 8) | src[srcIndex++];
 
-            if (dstIndex + count > buflen) {
-                buflen += 65536;
-                dst = realloc(dst, buflen);
+            offset = (value & 0x7ff) + 4;
+            count = (value >> 11) + 2;
+            if (((size_t) offset > dstIndex) || (count > dstCapacity - dstIndex)) {
+                return 0;
             }
 
+            /* Bytes may repeat data just depacked */
             for (j = 0; j < count; j++) {
                 dst[dstIndex + j] = dst[dstIndex - offset + j];
             }
-            dstIndex += count;
         }
+        dstIndex += count;
+    }
+
+    *srcUsed = srcIndex;
+    return dstIndex;
+}
+
+void sld_depack_mem(const Uint8* src, size_t srcLen, Uint8** dstBufPtr, size_t* dstLength) {
+    Uint8 *dst, *tmp;
+    size_t length;
+
+    *dstBufPtr = NULL;
+    *dstLength = 0;
+
+    length = sld_depack_size(src, srcLen);
+    if (length == 0) {
+        return;
+    }
+
+    dst = (Uint8*) malloc(length);
+    if (!dst) {
+        return;
+    }
+
+    length = sld_depack_span(src, srcLen, dst, length);
+    if (length == 0) {
+        free(dst);
+        return;
     }
 
-    *dstBufPtr = realloc(dst, dstIndex);
-    *dstLength = dstIndex;
+    tmp = (Uint8*) realloc(dst, length);
+    *dstBufPtr = (tmp ? tmp : dst);
+    *dstLength = length;
 }
@@ -21,6 +21,46 @@
 #ifndef DEPACK_SLD_H
 #define DEPACK_SLD_H
 
-void sld_depack(SDL_RWops* src, Uint8** dstPointer, int* dstLength);
+/*
+    Depack a file from a stream, with the same checks as sld_depack_mem().
+    Stream is left after packed file.
+
+    src	Stream, at packed file after its 8 bytes header
+    dstPointer	Depacked file, to free, NULL on error
+    dstLength	Length of depacked file
+*/
+void sld_depack(rw_t* src, Uint8** dstPointer, size_t* dstLength);
+
+/*
+    Depack a file in memory, from its number of blocks. Blocks and
+    back references outside of source and depacked data are rejected.
+
+    src	Packed file, after its 8 bytes header
+    srcLen	Length of packed file
+    dstPointer	Depacked file, to free, NULL on error
+    dstLength	Length of depacked file
+*/
+void sld_depack_mem(const Uint8* src, size_t srcLen, Uint8** dstPointer, size_t* dstLength);
+
+/*
+    Maximum length of a depacked file, from its number of blocks and
+    length, to allocate a buffer for sld_depack_span()
+
+    src	Packed file, after its 8 bytes header
+    srcLen	Length of packed file
+    Returns 0 if not a valid file
+*/
+size_t sld_depack_size(const Uint8* src, size_t srcLen);
+
+/*
+    Depack a file in memory to a buffer of the caller
+
+    src	Packed file, after its 8 bytes header
+    srcLen	Length of packed file
+    dst	Buffer for depacked file
+    dstCapacity	Length of buffer
+    Returns length of depacked file, 0 on error or if buffer is too small
+*/
+size_t sld_depack_span(const Uint8* src, size_t srcLen, Uint8* dst, size_t dstCapacity);
 
 #endif /* DEPACK_SLD_H */
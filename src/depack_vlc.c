@@ -24,9 +24,11 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 
-#include <SDL.h>
+#include "rw.h"
 
 /*--- Defines ---*/
 
@@ -50,7 +52,7 @@
         bitbuf <<= (N);                           \
         incnt += (N);                             \
         while (incnt >= 0) {                      \
-            bitbuf |= SDL_ReadLE16(src) << incnt; \
+            bitbuf |= rw_read_le16(src) << incnt; \
             incnt -= 16;                          \
         }                                         \
     }
@@ -282,37 +284,38 @@ typedef struct {
     Uint16 version;
 } vlc_header_t;
 
-/*--- Variables ---*/
-
-static Uint16* dstPointer;
-static int dstBufLen;
-static int dstOffset;
+/* State of a decode, on stack */
+typedef struct {
+    Uint16* dstPointer;
+    int dstBufLen;
+    int dstOffset;
 
-static vlc_header_t vlcHeader;
+    vlc_header_t vlcHeader;
+} vlc_context_t;
 
 /*--- Functions ---*/
 
-static void vlc_decode(SDL_RWops* src) {
+static void vlc_decode(vlc_context_t* ctxt, rw_t* src) {
     Uint16 tmp0[2];
     Uint32 bitbuf;
     int incnt, q_code, n, total_length;
     int last_dc[3];
 
     /* Init buffer */
-    tmp0[0] = SDL_ReadLE16(src);
-    tmp0[1] = SDL_ReadLE16(src);
+    tmp0[0] = rw_read_le16(src);
+    tmp0[1] = rw_read_le16(src);
     bitbuf = (tmp0[0] << 16) | tmp0[1];
     incnt = -16;
 
-    q_code = vlcHeader.quant << 10;
+    q_code = ctxt->vlcHeader.quant << 10;
     n = last_dc[0] = last_dc[1] = last_dc[2] = 0;
-    total_length = dstBufLen >> 1 /*(vlcHeader.length+2+32) << 1*/;
-    /*printf("%d , %d\n", dstOffset, total_length);*/
-    while (dstOffset < total_length) {
+    total_length = ctxt->dstBufLen >> 1 /*(ctxt->vlcHeader.length+2+32) << 1*/;
+    /*printf("%d , %d\n", ctxt->dstOffset, total_length);*/
+    while (ctxt->dstOffset < total_length) {
         Uint32 code2;
 
         /* DC */
-        if (vlcHeader.version == 2) {
+        if (ctxt->vlcHeader.version == 2) {
             code2 = Show_Bits(10) | (10 << 16); /* DC code */
         } else {
             code2 = Show_Bits(6);
@@ -366,11 +369,11 @@ static void vlc_decode(SDL_RWops* src) {
         for (;;) {
 #define code code2
 #define SBIT 17
-            /*printf("%d: 0x%04x\n", dstOffset, code2);*/
-            if (dstOffset < total_length) {
-                dstPointer[dstOffset++] = SDL_SwapLE16(code2);
+            /*printf("%d: 0x%04x\n", ctxt->dstOffset, code2);*/
+            if (ctxt->dstOffset < total_length) {
+                ctxt->dstPointer[ctxt->dstOffset++] = rw_swap_le16(code2);
             } else {
-                fprintf(stderr, "vlc: writing out of range: %d\n", dstOffset * 2);
+                fprintf(stderr, "vlc: writing out of range: %d\n", ctxt->dstOffset * 2);
                 /*break;*/
             }
             Flush_Buffer(BITOF(code2));
@@ -400,53 +403,53 @@ static void vlc_decode(SDL_RWops* src) {
                 code2 = VLCtab6[(code >> 0) - 32];
             } else {
                 do {
-                    dstPointer[dstOffset++] = SDL_SwapLE16(EOB);
-                } while (dstOffset < total_length);
-                /*printf("vlc: end at %d bytes written\n", dstOffset*2);*/
+                    ctxt->dstPointer[ctxt->dstOffset++] = rw_swap_le16(EOB);
+                } while (ctxt->dstOffset < total_length);
+                /*printf("vlc: end at %d bytes written\n", ctxt->dstOffset*2);*/
                 return;
             }
         }
-        if (dstOffset < total_length) {
-            dstPointer[dstOffset++] = SDL_SwapLE16(code2); /* EOB code */
+        if (ctxt->dstOffset < total_length) {
+            ctxt->dstPointer[ctxt->dstOffset++] = rw_swap_le16(code2); /* EOB code */
         } else {
-            fprintf(stderr, "vlc: writing out of range: %d\n", dstOffset * 2);
+            fprintf(stderr, "vlc: writing out of range: %d\n", ctxt->dstOffset * 2);
         }
         Flush_Buffer(2); /* EOB bitlen */
     }
-    /*printf("vlc: end at %d bytes written\n", dstOffset*2);*/
+    /*printf("vlc: end at %d bytes written\n", ctxt->dstOffset*2);*/
 }
 
-void vlc_depack(SDL_RWops* src, Uint8** dstBufPtr, int* dstLength) {
+void vlc_depack(rw_t* src, Uint8** dstBufPtr, size_t* dstLength) {
+    vlc_context_t ctxt;
+
     *dstBufPtr = NULL;
     *dstLength = 0;
 
-    vlcHeader.length = SDL_ReadLE16(src);
-    vlcHeader.id = SDL_ReadLE16(src);
-    vlcHeader.quant = SDL_ReadLE16(src);
-    vlcHeader.version = SDL_ReadLE16(src);
+    ctxt.vlcHeader.length = rw_read_le16(src);
+    ctxt.vlcHeader.id = rw_read_le16(src);
+    ctxt.vlcHeader.quant = rw_read_le16(src);
+    ctxt.vlcHeader.version = rw_read_le16(src);
 
-    if (vlcHeader.id != VLC_ID) {
+    if (ctxt.vlcHeader.id != VLC_ID) {
         return;
     }
 
-    printf("vlc: length=0x%04x, quant=%d\n", vlcHeader.length, vlcHeader.quant);
-
-    dstBufLen = (vlcHeader.length + 2) * sizeof(Uint32) * 2;
-    dstPointer = (Uint16*) malloc(dstBufLen);
-    if (dstPointer == NULL) {
+    ctxt.dstBufLen = (ctxt.vlcHeader.length + 2) * sizeof(Uint32) * 2;
+    ctxt.dstPointer = (Uint16*) malloc(ctxt.dstBufLen);
+    if (ctxt.dstPointer == NULL) {
         return;
     }
 
-    dstOffset = 0;
+    ctxt.dstOffset = 0;
 
-    dstPointer[dstOffset++] = SDL_SwapLE16(vlcHeader.length);
-    dstPointer[dstOffset++] = SDL_SwapLE16(VLC_ID);
+    ctxt.dstPointer[ctxt.dstOffset++] = rw_swap_le16(ctxt.vlcHeader.length);
+    ctxt.dstPointer[ctxt.dstOffset++] = rw_swap_le16(VLC_ID);
 
-    vlc_decode(src);
+    vlc_decode(&ctxt, src);
 
-    /*printf("vlc: final offset: 0x%08x\n", dstOffset);*/
+    /*printf("vlc: final offset: 0x%08x\n", ctxt.dstOffset);*/
 
     /* Return depacked buffer */
-    *dstBufPtr = (Uint8*) dstPointer;
-    *dstLength = dstBufLen;
+    *dstBufPtr = (Uint8*) ctxt.dstPointer;
+    *dstLength = ctxt.dstBufLen;
 }
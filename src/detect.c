@@ -0,0 +1,329 @@
+/*
+    Detect format of files
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>
+
+#include "rw.h"
+
+#include "detect.h"
+
+/*--- Defines ---*/
+
+#define MAGIC_TIM 0x10
+#define TIM_CLUT  0x08 /* Flag of TIM with CLUT block */
+
+/* Playstation VRAM */
+#define VRAM_WIDTH  1024
+#define VRAM_HEIGHT 512
+
+#define VLC_ID        0x3800
+#define MAX_VLC_QUANT 63
+
+#define EMD1_DIRECTORY 4  /* Skeleton, animation, model, tim */
+#define EMD2_SECTIONS  8
+#define EMD3_SECTIONS  15
+
+#define SLD_HEADER_SIZE 8
+
+#define ROFS_HEADER_SIZE 21
+#define ROFS_MAX_NAME    255
+
+#define BIN_HEADER_SIZE     0x800
+#define BIN_HEADER_FILENAME 0x40
+
+/*--- Const ---*/
+
+static const char* format_names[] = { "unknown", "tim", "bss", "emd1", "emd2", "emd3", "pak", "adt",
+    "sld", "rofs", "bin" };
+
+/*--- Functions prototypes ---*/
+
+static int check_tim(const Uint8* data, size_t avail, Sint64 length);
+static int check_bss(const Uint8* data, size_t avail);
+static int check_sld(const Uint8* data, size_t avail, Sint64 length);
+static int check_rofs(const Uint8* data, size_t avail, Sint64 length);
+static int check_bin(const Uint8* data, size_t avail, Sint64 length);
+static int check_pak(const Uint8* data, size_t avail);
+static int check_name(const Uint8* name, size_t avail);
+static int has_extension(const char* filename, const char* ext);
+
+
+/*--- Functions ---*/
+
+int detect_format(const Uint8* data, size_t avail, Sint64 length, const char* filename) {
+    if ((Sint64) avail > length) {
+        avail = (size_t) length;
+    }
+
+    if (check_tim(data, avail, length)) {
+        return DETECT_TIM;
+    }
+    if (check_bss(data, avail)) {
+        return DETECT_BSS;
+    }
+    if (check_rofs(data, avail, length)) {
+        return DETECT_ROFS;
+    }
+    if (check_bin(data, avail, length)) {
+        return DETECT_BIN;
+    }
+    if (check_sld(data, avail, length)) {
+        return DETECT_SLD;
+    }
+
+    /* Directory of model must be in buffer */
+    if (((Sint64) avail == length) && (length <= (Sint64) 0xffffffffUL)) {
+        switch (detect_emd_version(data, (Uint32) length)) {
+        case 1: {
+            /* Check RE1 directory more, it is at end of any file */
+            const Uint8* directory = &data[avail - EMD1_DIRECTORY * 4];
+            int i;
+
+            for (i = 0; i < EMD1_DIRECTORY; i++) {
+                if (rw_get_le32(&directory[i * 4]) == 0) {
+                    break;
+                }
+            }
+            if (i == EMD1_DIRECTORY) {
+                return DETECT_EMD1;
+            }
+        } break;
+        case 2:
+            return DETECT_EMD2;
+        case 3:
+            return DETECT_EMD3;
+        }
+    }
+
+    if (check_pak(data, avail)) {
+        return DETECT_PAK;
+    }
+    if (filename && has_extension(filename, ".adt")) {
+        return DETECT_ADT;
+    }
+
+    return DETECT_UNKNOWN;
+}
+
+const char* detect_name(int format) {
+    if ((format < 0) || (format >= (int) (sizeof(format_names) / sizeof(format_names[0])))) {
+        format = DETECT_UNKNOWN;
+    }
+    return format_names[format];
+}
+
+int detect_emd_version(const Uint8* src, Uint32 srcLen) {
+    Uint32 dir_offset, dir_length, i;
+    int version;
+
+    if (srcLen < EMD1_DIRECTORY * 4) {
+        return 0;
+    }
+
+    /* RE1 does not have header, so check if usable as RE2 or RE3 file */
+    dir_offset = rw_get_le32(src);
+    dir_length = rw_get_le32(&src[4]);
+    if ((dir_length <= (0xffffffffUL - dir_offset) / 4) && (dir_offset + dir_length * 4 == srcLen)) {
+        version = (dir_length == EMD2_SECTIONS ? 2 : 3);
+    } else {
+        version = 1;
+        dir_offset = srcLen - EMD1_DIRECTORY * 4;
+        dir_length = EMD1_DIRECTORY;
+    }
+
+    /* Sections must start inside model, before directory */
+    for (i = 0; i < dir_length; i++) {
+        if (rw_get_le32(&src[dir_offset + i * 4]) >= dir_offset) {
+            return 0;
+        }
+    }
+    return version;
+}
+
+/* Magic, type, then CLUT and image blocks inside VRAM */
+static int check_tim(const Uint8* data, size_t avail, Sint64 length) {
+    Uint32 type, offset = 8, block_length, x, y, width, height;
+
+    if ((avail < 8 + 12) || (rw_get_le32(data) != MAGIC_TIM)) {
+        return 0;
+    }
+    type = rw_get_le32(&data[4]);
+    if ((type & ~(TIM_CLUT | 3)) != 0) {
+        return 0;
+    }
+
+    /* 4 and 8 bits images need a CLUT */
+    if (((type & 3) < 2) && !(type & TIM_CLUT)) {
+        return 0;
+    }
+
+    if (type & TIM_CLUT) {
+        block_length = rw_get_le32(&data[offset]);
+        if ((block_length < 12) || (block_length > length - offset)) {
+            return 0;
+        }
+        offset += block_length;
+        if (offset + 12 > avail) {
+            return 0;
+        }
+    }
+
+    block_length = rw_get_le32(&data[offset]);
+    x = rw_get_le16(&data[offset + 4]);
+    y = rw_get_le16(&data[offset + 6]);
+    width = rw_get_le16(&data[offset + 8]);
+    height = rw_get_le16(&data[offset + 10]);
+    if ((width == 0) || (height == 0) || (x + width > VRAM_WIDTH) || (y + height > VRAM_HEIGHT)) {
+        return 0;
+    }
+    return (block_length >= 12 + 2 * width * height) && (block_length <= length - offset);
+}
+
+/* First frame: length, VLC_ID, quantization, version 2 or 3 */
+static int check_bss(const Uint8* data, size_t avail) {
+    Uint16 quant, version;
+
+    if (avail < 8) {
+        return 0;
+    }
+
+    quant = rw_get_le16(&data[4]);
+    version = rw_get_le16(&data[6]);
+    return (rw_get_le16(data) != 0) && (rw_get_le16(&data[2]) == VLC_ID) && (quant != 0)
+        && (quant <= MAX_VLC_QUANT) && ((version == 2) || (version == 3));
+}
+
+/*
+    Headers of files, with their length, follow each other. First packed
+    file must start with a literal block holding TIM magic.
+*/
+static int check_sld(const Uint8* data, size_t avail, Sint64 length) {
+    Sint64 offset = 0;
+
+    while (offset + SLD_HEADER_SIZE + 4 + 5 <= (Sint64) avail) {
+        const Uint8* file = &data[offset + SLD_HEADER_SIZE];
+        Uint32 file_length = rw_get_le32(&data[offset + 4]);
+
+        if (file_length == 0) {
+            offset += SLD_HEADER_SIZE;
+            continue;
+        }
+        if ((file_length < SLD_HEADER_SIZE + 4 + 5) || (offset + file_length > length)) {
+            return 0;
+        }
+
+        /* Number of blocks, then literal block */
+        return (rw_get_le32(file) >= 2) && (file[4] & 0x80) && ((file[4] & 0x7f) >= 4)
+            && (rw_get_le32(&file[5]) == MAGIC_TIM);
+    }
+
+    return 0;
+}
+
+/* Header, then names of both directory levels, with offset of files */
+static int check_rofs(const Uint8* data, size_t avail, Sint64 length) {
+    size_t offset = ROFS_HEADER_SIZE;
+    int name_length;
+
+    if (avail < DETECT_WINDOW) {
+        return 0;
+    }
+
+    name_length = check_name(&data[offset], avail - offset);
+    if (name_length == 0) {
+        return 0;
+    }
+    offset += name_length + 1;
+
+    if (offset + 8 > avail) {
+        return 0;
+    }
+    if ((Sint64) rw_get_le32(&data[offset]) * 8 + 4 > length) {
+        return 0;
+    }
+    offset += 8;
+
+    return check_name(&data[offset], avail - offset) > 0;
+}
+
+/* First header: type, length of data, number of blocks, then name */
+static int check_bin(const Uint8* data, size_t avail, Sint64 length) {
+    Uint32 id, file_length, blocks;
+
+    if (avail < BIN_HEADER_SIZE) {
+        return 0;
+    }
+
+    id = rw_get_le32(data);
+    file_length = rw_get_le32(&data[4]);
+    blocks = rw_get_le32(&data[8]);
+    if ((id == 0xffffffffUL) || (file_length == 0) || (blocks == 0)) {
+        return 0;
+    }
+
+    /* Data follows header, in blocks of same size */
+    if ((file_length > blocks * (Sint64) BIN_HEADER_SIZE) || (BIN_HEADER_SIZE + (Sint64) file_length > length)) {
+        return 0;
+    }
+
+    return check_name(&data[BIN_HEADER_FILENAME], BIN_HEADER_SIZE - BIN_HEADER_FILENAME) > 0;
+}
+
+/*
+    No header, but LZW codes of 9 bits, from highest bit: 0x10, then 0x00
+    for start of TIM magic
+*/
+static int check_pak(const Uint8* data, size_t avail) {
+    if (avail < 3) {
+        return 0;
+    }
+    return (data[0] == 0x08) && (data[1] == 0x00) && ((data[2] & 0xc0) == 0);
+}
+
+/* Returns length of a NUL terminated name of printable characters, 0 if not valid */
+static int check_name(const Uint8* name, size_t avail) {
+    size_t i;
+
+    for (i = 0; (i < avail) && (i <= ROFS_MAX_NAME); i++) {
+        if (name[i] == 0) {
+            return (int) i;
+        }
+        if ((name[i] < 0x20) || (name[i] >= 0x7f)) {
+            return 0;
+        }
+    }
+
+    return 0;
+}
+
+static int has_extension(const char* filename, const char* ext) {
+    const char* dot = strrchr(filename, '.');
+    int i;
+
+    if (!dot) {
+        return 0;
+    }
+    for (i = 0; dot[i] && ext[i]; i++) {
+        if ((dot[i] | 0x20) != ext[i]) {
+            return 0;
+        }
+    }
+    return (dot[i] == 0) && (ext[i] == 0);
+}
@@ -0,0 +1,72 @@
+/*
+    Detect format of files
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef DETECT_H
+#define DETECT_H
+
+/*--- Defines ---*/
+
+/* Formats */
+#define DETECT_UNKNOWN 0
+#define DETECT_TIM     1 /* PS1 image */
+#define DETECT_BSS     2 /* VLC compressed background, frames of 32 or 64KB */
+#define DETECT_EMD1    3 /* RE1 model */
+#define DETECT_EMD2    4 /* RE2 model */
+#define DETECT_EMD3    5 /* RE3 model */
+#define DETECT_PAK     6 /* RE PC LZW packed TIM */
+#define DETECT_ADT     7 /* RE2 PC packed image */
+#define DETECT_SLD     8 /* RE3 PC archive of packed TIM masks */
+#define DETECT_ROFS    9 /* RE3 PC archive */
+#define DETECT_BIN     10 /* RE2 PS1 archive */
+
+/* Headers of archives are in this many bytes from file start */
+#define DETECT_WINDOW 4096
+
+/*--- Functions ---*/
+
+/*
+    Detect format of a file from its magic and structure. Formats are
+    checked from the most to the least constrained: EMD models only have a
+    directory, PAK files only start with LZW codes of a TIM magic, ADT
+    files have no header and are recognized by their extension.
+
+    data	Start of file
+    avail	Bytes of file in data, DETECT_WINDOW at least if file is longer.
+		EMD models are only detected if whole file is in data.
+    length	Length of file
+    filename	Name of file, for formats without header, may be NULL
+    Returns format
+*/
+int detect_format(const Uint8* data, size_t avail, Sint64 length, const char* filename);
+
+/* Short name of format, also used as extension */
+const char* detect_name(int format);
+
+/*
+    Version of an EMD model: RE2 and RE3 models start with offset and
+    length of their directory, RE1 models end with it.
+
+    src	Model
+    srcLen	Length of model
+    Returns 1, 2 or 3, 0 if directory is not valid
+*/
+int detect_emd_version(const Uint8* src, Uint32 srcLen);
+
+#endif /* DETECT_H */
@@ -0,0 +1,251 @@
+/*
+    CD-ROM sector EDC and ECC check and correction
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>
+
+#include "rw.h"
+
+#include "edc_ecc.h"
+
+/*--- Defines ---*/
+
+#define EDC_POLY 0xd8018001UL /* x^32+x^31+x^16+x^15+x^4+x^3+x+1, reflected */
+#define GF_POLY  0x11d        /* x^8+x^4+x^3+x^2+1 */
+
+#define SUBMODE_FORM2 0x20
+
+/* Offsets in a 2352 bytes sector */
+#define MODE_OFFSET       15
+#define SUBMODE_OFFSET    18
+#define MODE1_EDC_OFFSET  2064
+#define FORM1_EDC_OFFSET  2072
+#define FORM2_EDC_OFFSET  2348
+#define ECC_P_OFFSET      2076
+#define ECC_Q_OFFSET      2248
+#define MAX_ECC_PASSES    4
+
+/*--- Variables ---*/
+
+/* Slice by 8: edc_table[k][i] is CRC of byte i followed by k zero bytes */
+static Uint32 edc_table[8][256];
+
+static Uint8 gf_mul2[256]; /* Multiply by alpha */
+static Uint8 gf_log[256];
+
+static const Uint8 sync_pattern[12] = { 0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xff, 0 };
+
+/*--- Functions prototypes ---*/
+
+static int edc_matches(const Uint8* sector, int base, int mode, int form2);
+static int ecc_correct_block(Uint8* src, int major_count, int minor_count, int major_mult,
+    int minor_inc, Uint8* parity);
+
+/*--- Functions ---*/
+
+void edc_ecc_init(void) {
+    int i, k;
+    Uint32 value;
+
+    for (i = 0; i < 256; i++) {
+        value = i;
+        for (k = 0; k < 8; k++) {
+            value = (value >> 1) ^ ((value & 1) ? EDC_POLY : 0);
+        }
+        edc_table[0][i] = value;
+    }
+    for (k = 1; k < 8; k++) {
+        for (i = 0; i < 256; i++) {
+            value = edc_table[k - 1][i];
+            edc_table[k][i] = (value >> 8) ^ edc_table[0][value & 0xff];
+        }
+    }
+
+    for (i = 0; i < 256; i++) {
+        gf_mul2[i] = ((i << 1) ^ ((i & 0x80) ? GF_POLY : 0)) & 0xff;
+    }
+    for (i = 0, value = 1; i < 255; i++) {
+        gf_log[value] = i;
+        value = gf_mul2[value];
+    }
+}
+
+Uint32 edc_compute(const Uint8* data, Uint32 length) {
+    Uint32 edc = 0;
+
+    /* 8 bytes at once */
+    while (length >= 8) {
+        Uint32 low = edc ^ rw_get_le32(data);
+        Uint32 high = rw_get_le32(data + 4);
+
+        edc = edc_table[7][low & 0xff] ^ edc_table[6][(low >> 8) & 0xff]
+            ^ edc_table[5][(low >> 16) & 0xff] ^ edc_table[4][low >> 24]
+            ^ edc_table[3][high & 0xff] ^ edc_table[2][(high >> 8) & 0xff]
+            ^ edc_table[1][(high >> 16) & 0xff] ^ edc_table[0][high >> 24];
+        data += 8;
+        length -= 8;
+    }
+
+    while (length-- > 0) {
+        edc = (edc >> 8) ^ edc_table[0][(edc ^ *data++) & 0xff];
+    }
+
+    return edc;
+}
+
+int edc_ecc_check(const Uint8* sector, int block_size) {
+    int mode = 2, base = 0, form2;
+
+    /* 2336 bytes sectors start with subheader, at offset 16 of a 2352 bytes one */
+    if (block_size == 2352) {
+        mode = sector[MODE_OFFSET];
+    } else {
+        base = -16;
+    }
+
+    if (mode == 1) {
+        return edc_matches(sector, base, 1, 0) ? EDC_OK : EDC_BAD;
+    }
+    if (mode != 2) {
+        return EDC_NONE;
+    }
+
+    /* EDC of form 2 sectors is optional */
+    form2 = sector[base + SUBMODE_OFFSET] & SUBMODE_FORM2;
+    if (form2 && (rw_get_le32(&sector[base + FORM2_EDC_OFFSET]) == 0)) {
+        return EDC_NONE;
+    }
+    return edc_matches(sector, base, 2, form2) ? EDC_OK : EDC_BAD;
+}
+
+int edc_ecc_correct(Uint8* sector, int block_size) {
+    Uint8 buffer[2352], header[4];
+    int mode = 2, pass;
+
+    if (block_size == 2352) {
+        memcpy(buffer, sector, 2352);
+        mode = buffer[MODE_OFFSET];
+    } else {
+        memset(buffer, 0, 16);
+        memcpy(&buffer[16], sector, 2336);
+    }
+
+    /* Form 2 sectors have no ECC */
+    if ((mode != 1) && ((mode != 2) || (buffer[SUBMODE_OFFSET] & SUBMODE_FORM2))) {
+        return EDC_BAD;
+    }
+
+    /* Sync is not protected by ECC, header is not for mode 2 */
+    memcpy(buffer, sync_pattern, 12);
+    memcpy(header, &buffer[12], 4);
+    if (mode == 2) {
+        memset(&buffer[12], 0, 4);
+    }
+
+    for (pass = 0; pass < MAX_ECC_PASSES; pass++) {
+        int count = ecc_correct_block(&buffer[12], 86, 24, 2, 86, &buffer[ECC_P_OFFSET]);
+
+        count += ecc_correct_block(&buffer[12], 52, 43, 86, 88, &buffer[ECC_Q_OFFSET]);
+        if (edc_matches(buffer, 0, mode, 0)) {
+            break;
+        }
+        if (count == 0) {
+            return EDC_BAD;
+        }
+    }
+    if (pass == MAX_ECC_PASSES) {
+        return EDC_BAD;
+    }
+
+    if (block_size == 2352) {
+        if (mode == 2) {
+            memcpy(&buffer[12], header, 4);
+        }
+        memcpy(sector, buffer, 2352);
+    } else {
+        memcpy(sector, &buffer[16], 2336);
+    }
+    return EDC_FIXED;
+}
+
+/* Offsets are the ones of a 2352 bytes sector, moved by base */
+static int edc_matches(const Uint8* sector, int base, int mode, int form2) {
+    if (mode == 1) {
+        return edc_compute(sector, MODE1_EDC_OFFSET) == rw_get_le32(&sector[MODE1_EDC_OFFSET]);
+    }
+    if (form2) {
+        return edc_compute(&sector[base + 16], FORM2_EDC_OFFSET - 16)
+            == rw_get_le32(&sector[base + FORM2_EDC_OFFSET]);
+    }
+    return edc_compute(&sector[base + 16], FORM1_EDC_OFFSET - 16)
+        == rw_get_le32(&sector[base + FORM1_EDC_OFFSET]);
+}
+
+/*
+    Correct one wrong byte per codeword of P or Q parity.
+    Codeword of major is read from src every minor_inc bytes, wrapping
+    around, followed by its 2 parity bytes. Syndromes are the sum of bytes,
+    and the sum of bytes multiplied by alpha^(position from end).
+    Returns number of corrected bytes.
+*/
+static int ecc_correct_block(Uint8* src, int major_count, int minor_count, int major_mult,
+    int minor_inc, Uint8* parity) {
+    int size = major_count * minor_count;
+    int major, minor, count = 0;
+
+    for (major = 0; major < major_count; major++) {
+        int start = (major >> 1) * major_mult + (major & 1);
+        int index = start, position;
+        Uint8 s0 = 0, s1 = 0;
+
+        for (minor = 0; minor < minor_count; minor++) {
+            s0 ^= src[index];
+            s1 = gf_mul2[s1] ^ src[index];
+            index += minor_inc;
+            if (index >= size) {
+                index -= size;
+            }
+        }
+        s0 ^= parity[major];
+        s1 = gf_mul2[s1] ^ parity[major];
+        s0 ^= parity[major + major_count];
+        s1 = gf_mul2[s1] ^ parity[major + major_count];
+
+        /* Single error of value s0, s1/s0 gives its position */
+        if ((s0 == 0) || (s1 == 0)) {
+            continue;
+        }
+        position = minor_count + 1 - (gf_log[s1] - gf_log[s0] + 255) % 255;
+        if (position < 0) {
+            continue;
+        }
+
+        if (position < minor_count) {
+            src[(start + position * minor_inc) % size] ^= s0;
+        } else if (position == minor_count) {
+            parity[major] ^= s0;
+        } else {
+            parity[major + major_count] ^= s0;
+        }
+        ++count;
+    }
+
+    return count;
+}
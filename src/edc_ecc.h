@@ -0,0 +1,65 @@
+/*
+    CD-ROM sector EDC and ECC check and correction
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef EDC_ECC_H
+#define EDC_ECC_H
+
+/*--- Defines ---*/
+
+/* Status of a sector */
+#define EDC_OK    0 /* EDC matches */
+#define EDC_NONE  1 /* Nothing to check: mode 0, or form 2 without EDC */
+#define EDC_BAD   2 /* EDC does not match */
+#define EDC_FIXED 3 /* EDC matches after ECC correction */
+
+/*--- Functions ---*/
+
+/*
+    Build tables, must be called once before other functions
+*/
+void edc_ecc_init(void);
+
+/*
+    Compute EDC (CRC-32 of CD-ROM) of a buffer
+
+    data	Buffer
+    length	Length of buffer
+*/
+Uint32 edc_compute(const Uint8* data, Uint32 length);
+
+/*
+    Check EDC of a raw sector
+
+    sector	Sector, from sync for 2352 bytes sectors, from subheader for 2336
+    block_size	2352 or 2336
+    Returns EDC_OK, EDC_NONE or EDC_BAD
+*/
+int edc_ecc_check(const Uint8* sector, int block_size);
+
+/*
+    Correct a sector with P and Q parity, for mode 1 and mode 2 form 1 sectors
+
+    sector	Sector to correct, modified in place
+    block_size	2352 or 2336
+    Returns EDC_FIXED if EDC matches after correction, EDC_BAD if not
+*/
+int edc_ecc_correct(Uint8* sector, int block_size);
+
+#endif /* EDC_ECC_H */
@@ -21,7 +21,7 @@
 #ifndef EMD1_H
 #define EMD1_H 1
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "emd_common.h"
 
@@ -21,7 +21,7 @@
 #ifndef EMD2_H
 #define EMD2_H 1
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "emd_common.h"
 
@@ -21,7 +21,7 @@
 #ifndef EMD3_H
 #define EMD3_H 1
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "emd_common.h"
 
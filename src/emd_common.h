@@ -21,7 +21,7 @@
 #ifndef EMD_COMMON_H
 #define EMD_COMMON_H 1
 
-#include <SDL.h>
+#include "rw.h"
 
 /*--- Structures ---*/
 
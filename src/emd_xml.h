@@ -0,0 +1,37 @@
+/*
+    Convert EMD model to XML
+
+    Copyright (C) 2011	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef EMD_XML_H
+#define EMD_XML_H
+
+/*--- Functions ---*/
+
+/*
+    Convert EMD model in memory to XML. TIM image of RE1 models is saved
+    beside XML file, with .tim extension.
+
+    src	Model
+    srcLen	Length of model
+    filename	Name of XML file
+    Returns 0 if saved
+*/
+int emd_save_xml(Uint8* src, Uint32 srcLen, const char* filename);
+
+#endif /* EMD_XML_H */
@@ -26,29 +26,37 @@
 #    include "config.h"
 #endif
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "pack_pak.h"
 #include "file_functions.h"
 #include "param.h"
 #include "background_tim.h"
+#include "applets.h"
 
-/*--- Variables ---*/
+/*--- Functions prototypes ---*/
 
-/* Flag for image stored with 4 pixels less
+/* remove4pix: image stored with 4 pixels less
    (used for shaking rooms, like lifts or with rolling boulders)
  */
-static int remove4pix = 0;
-
-/*--- Functions prototypes ---*/
-
-int convert_image(const char* filename);
-void remove_4_pixels(Uint8* srcBuffer, int srcBufLen);
+static int convert_image(applet_context_t* ctxt, const char* filename, int remove4pix);
+static void remove_4_pixels(Uint8* srcBuffer, size_t srcBufLen);
 
 /*--- Functions ---*/
 
+#ifndef MULTICALL
 int main(int argc, char** argv) {
+    return file2pak_main(argc, argv);
+}
+#endif
+
+int file2pak_main(int argc, char** argv) {
+    return file2pak_main_ctxt(NULL, argc, argv);
+}
+
+int file2pak_main_ctxt(applet_context_t* ctxt, int argc, char** argv) {
     int retval;
+    int remove4pix = 0;
 
     if (argc < 2) {
         fprintf(stderr, "Usage: %s [-r4] /path/to/filename.ext\n", argv[0]);
@@ -59,51 +67,51 @@ int main(int argc, char** argv) {
         remove4pix = 1;
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Can not initialize SDL: %s\n", SDL_GetError());
-        return 1;
-    }
-    atexit(SDL_Quit);
-
-    retval = convert_image(argv[argc - 1]);
+    retval = convert_image(ctxt, argv[argc - 1], remove4pix);
 
-    SDL_Quit();
     return retval;
 }
 
-int convert_image(const char* filename) {
-    SDL_RWops* src;
+static int convert_image(applet_context_t* ctxt, const char* filename, int remove4pix) {
+    rw_t* src;
     Uint8 *dstBuffer, *srcBuffer;
-    int dstBufLen, srcBufLen;
+    size_t dstBufLen, srcBufLen;
     int retval = 1;
 
     /* Read file in memory */
-    src = SDL_RWFromFile(filename, "rb");
+    src = rw_from_file(filename, "rb");
     if (!src) {
         fprintf(stderr, "Can not open %s for reading\n", filename);
         return retval;
     }
 
-    SDL_RWseek(src, 0, RW_SEEK_END);
-    srcBufLen = SDL_RWtell(src);
-    SDL_RWseek(src, 0, RW_SEEK_SET);
+    rw_seek(src, 0, RW_SEEK_END);
+    srcBufLen = rw_tell(src);
+    rw_seek(src, 0, RW_SEEK_SET);
 
     srcBuffer = (Uint8*) malloc(srcBufLen);
     if (!srcBuffer) {
-        fprintf(stderr, "Can not allocate %d bytes in memory\n", srcBufLen);
+        fprintf(stderr, "Can not allocate %" PRIu64 " bytes in memory\n", (Uint64) srcBufLen);
         return retval;
     }
-    SDL_RWread(src, srcBuffer, srcBufLen, 1);
-    SDL_RWclose(src);
+    rw_read(src, srcBuffer, srcBufLen, 1);
+    rw_close(src);
 
     /* Remove 4 pixels ? */
     if (remove4pix) {
         remove_4_pixels(srcBuffer, srcBufLen);
     }
 
-    src = SDL_RWFromMem(srcBuffer, srcBufLen);
+    src = rw_from_mem(srcBuffer, srcBufLen);
     if (src) {
-        pak_pack(src, &dstBuffer, &dstBufLen);
+        if (ctxt && !ctxt->pack) {
+            ctxt->pack = pak_pack_context_create();
+        }
+        if (ctxt && ctxt->pack) {
+            pak_pack_ctxt(ctxt->pack, src, &dstBuffer, &dstBufLen);
+        } else {
+            pak_pack(src, &dstBuffer, &dstBufLen);
+        }
 
         if (dstBuffer && dstBufLen) {
             save_pak(filename, dstBuffer, dstBufLen);
@@ -114,7 +122,7 @@ int convert_image(const char* filename) {
             fprintf(stderr, "Error packing file\n");
         }
 
-        SDL_RWclose(src);
+        rw_close(src);
     }
 
     free(srcBuffer);
@@ -122,27 +130,27 @@ int convert_image(const char* filename) {
     return retval;
 }
 
-void remove_4_pixels(Uint8* srcBuffer, int srcBufLen) {
+static void remove_4_pixels(Uint8* srcBuffer, size_t srcBufLen) {
     tim_header_t* tim_header = (tim_header_t*) srcBuffer;
     tim_size_t* tim_size;
     Uint32 tim_type, img_offset;
     Uint16 *srcImage, *dstImage;
     int x, y, w, h;
 
-    if (SDL_SwapLE32(tim_header->magic) != MAGIC_TIM) {
+    if (rw_swap_le32(tim_header->magic) != MAGIC_TIM) {
         fprintf(stderr, "Not a TIM image\n");
         return;
     }
 
-    if (SDL_SwapLE32(tim_header->type) != TIM_TYPE_16) {
+    if (rw_swap_le32(tim_header->type) != TIM_TYPE_16) {
         fprintf(stderr, "Only 16 bpp TIM images can be reparsed\n");
         return;
     }
 
     img_offset = 16;
     tim_size = (tim_size_t*) (&((Uint8*) srcBuffer)[img_offset]);
-    w = SDL_SwapLE16(tim_size->width);
-    h = SDL_SwapLE16(tim_size->height);
+    w = rw_swap_le16(tim_size->width);
+    h = rw_swap_le16(tim_size->height);
 
     srcImage = dstImage = (Uint16*) (&((Uint8*) srcBuffer)[img_offset + sizeof(tim_size_t)]);
     srcImage += 2 + w * 2;
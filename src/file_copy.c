@@ -0,0 +1,229 @@
+/*
+    Copy part of a file to another file
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* For copy_file_range() */
+#ifndef _GNU_SOURCE
+#    define _GNU_SOURCE 1
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#if defined(HAVE_COPY_FILE_RANGE) || defined(HAVE_SYS_SENDFILE_H) \
+    || (defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H))
+#    include <errno.h>
+#    include <fcntl.h>
+#    include <unistd.h>
+#    define USE_FD 1
+#endif
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+#    include <sys/sendfile.h>
+#    define USE_SENDFILE 1
+#endif
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#    include <sys/mman.h>
+#    define USE_MMAP 1
+#endif
+
+#include "rw.h"
+
+#include "file_copy.h"
+
+/*--- Defines ---*/
+
+/* Bytes copied by each call */
+#define COPY_CHUNK (16 << 20)
+
+/*--- Functions prototypes ---*/
+
+#ifdef USE_FD
+static Sint64 copy_fd(int src, int dst, Sint64 offset, Sint64 length);
+#endif
+static int copy_rw(const char* src_filename, Sint64 offset, Sint64 length, const char* dst_filename);
+
+/*--- Functions ---*/
+
+int file_copy(const char* src_filename, Sint64 offset, Sint64 length, const char* dst_filename) {
+#ifdef USE_FD
+    int src, dst;
+    Sint64 done;
+
+    src = open(src_filename, O_RDONLY);
+    if (src < 0) {
+        fprintf(stderr, "Can not open %s for reading\n", src_filename);
+        return 1;
+    }
+    dst = open(dst_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dst < 0) {
+        fprintf(stderr, "Can not create %s for writing\n", dst_filename);
+        close(src);
+        return 1;
+    }
+
+    done = copy_fd(src, dst, offset, length);
+
+    close(dst);
+    close(src);
+
+    if (done < 0) {
+        fprintf(stderr, "Can not copy %s to %s\n", src_filename, dst_filename);
+        return 1;
+    }
+    if (done == length) {
+        return 0;
+    }
+    /* Not supported between these files, copied with a buffer */
+#endif
+
+    return copy_rw(src_filename, offset, length, dst_filename);
+}
+
+#ifdef USE_FD
+/* Each method continues where the previous one stopped, returns -1 on error */
+static Sint64 copy_fd(int src, int dst, Sint64 offset, Sint64 length) {
+    Sint64 done = 0;
+    ssize_t count;
+
+#    ifdef HAVE_COPY_FILE_RANGE
+    while (done < length) {
+        off_t src_offset = offset + done;
+        size_t chunk = (length - done > COPY_CHUNK ? COPY_CHUNK : length - done);
+
+        count = copy_file_range(src, &src_offset, dst, NULL, chunk, 0);
+        if (count <= 0) {
+            if ((count < 0) && (errno == EINTR)) {
+                continue;
+            }
+            if ((count < 0) && (errno == EIO)) {
+                return -1;
+            }
+            /* Source too short, or filesystems do not support it */
+            break;
+        }
+        done += count;
+    }
+#    endif
+
+#    ifdef USE_SENDFILE
+    while (done < length) {
+        off_t src_offset = offset + done;
+        size_t chunk = (length - done > COPY_CHUNK ? COPY_CHUNK : length - done);
+
+        count = sendfile(dst, src, &src_offset, chunk);
+        if (count <= 0) {
+            if ((count < 0) && (errno == EINTR)) {
+                continue;
+            }
+            if ((count < 0) && (errno == EIO)) {
+                return -1;
+            }
+            break;
+        }
+        done += count;
+    }
+#    endif
+
+#    ifdef USE_MMAP
+    if (done < length) {
+        long page = sysconf(_SC_PAGESIZE);
+        off_t start = ((offset + done) / page) * page;
+        size_t skip = (offset + done) - start;
+        size_t map_length = skip + (length - done);
+        Uint8* data;
+
+        /* Mapping past end of source would fault */
+        if ((Sint64) lseek(src, 0, SEEK_END) < offset + length) {
+            return done;
+        }
+
+        data = (Uint8*) mmap(NULL, map_length, PROT_READ, MAP_SHARED, src, start);
+        if (data != MAP_FAILED) {
+            while (done < length) {
+                count = write(dst, &data[skip], length - done);
+                if (count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    munmap(data, map_length);
+                    return -1;
+                }
+                skip += count;
+                done += count;
+            }
+            munmap(data, map_length);
+        }
+    }
+#    endif
+
+    return done;
+}
+#endif
+
+static int copy_rw(const char* src_filename, Sint64 offset, Sint64 length, const char* dst_filename) {
+    rw_t *src, *dst;
+    Uint8* buffer;
+    Sint64 done = 0;
+    int retval = 1;
+
+    buffer = (Uint8*) malloc(COPY_CHUNK);
+    if (!buffer) {
+        fprintf(stderr, "Can not allocate %d bytes in memory\n", COPY_CHUNK);
+        return 1;
+    }
+
+    src = rw_from_file(src_filename, "rb");
+    if (!src) {
+        fprintf(stderr, "Can not open %s for reading\n", src_filename);
+        free(buffer);
+        return 1;
+    }
+    dst = rw_from_file(dst_filename, "wb");
+    if (!dst) {
+        fprintf(stderr, "Can not create %s for writing\n", dst_filename);
+        rw_close(src);
+        free(buffer);
+        return 1;
+    }
+
+    rw_seek(src, offset, RW_SEEK_SET);
+    while (done < length) {
+        size_t chunk = (length - done > COPY_CHUNK ? COPY_CHUNK : length - done);
+
+        if ((rw_read(src, buffer, chunk, 1) != 1) || (rw_write(dst, buffer, chunk, 1) != 1)) {
+            break;
+        }
+        done += chunk;
+    }
+    if (done == length) {
+        retval = 0;
+    } else {
+        fprintf(stderr, "Can not copy %s to %s\n", src_filename, dst_filename);
+    }
+
+    rw_close(dst);
+    rw_close(src);
+    free(buffer);
+    return retval;
+}
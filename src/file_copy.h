@@ -0,0 +1,40 @@
+/*
+    Copy part of a file to another file
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef FILE_COPY_H
+#define FILE_COPY_H
+
+/*--- Functions ---*/
+
+/*
+    Copy a range of a file to a new file. The system copies it between
+    files if it can (copy_file_range, then sendfile), else it is written
+    from a mapping of the source file. Data is read in a buffer only on
+    systems without any of them.
+
+    src_filename	File to copy from
+    offset	Offset of range in source file
+    length	Length of range
+    dst_filename	File to create
+    Returns 0 if copied
+*/
+int file_copy(const char* src_filename, Sint64 offset, Sint64 length, const char* dst_filename);
+
+#endif /* FILE_COPY_H */
@@ -23,7 +23,9 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <SDL.h>
+#include "rw.h"
+
+#include "bmp.h"
 
 char* get_filename_ext(const char* src_filename, const char* new_ext) {
     int dst_namelength = strlen(src_filename) + 1;
@@ -63,7 +65,7 @@ char* get_filename_ext(const char* src_filename, const char* new_ext) {
     return dst_filename;
 }
 
-void save_file(const char* filename, void* buffer, int length) {
+void save_file(const char* filename, void* buffer, size_t length) {
     FILE* dst = NULL;
 
     dst = fopen(filename, "wb");
@@ -76,7 +78,7 @@ void save_file(const char* filename, void* buffer, int length) {
     fclose(dst);
 }
 
-void save_bmp(const char* src_filename, SDL_Surface* image) {
+void save_bmp(const char* src_filename, const bmp_image_t* image) {
     char* dst_filename;
 
     dst_filename = get_filename_ext(src_filename, ".bmp");
@@ -85,12 +87,12 @@ void save_bmp(const char* src_filename, SDL_Surface* image) {
     }
 
     printf("Saving to %s\n", dst_filename);
-    SDL_SaveBMP(image, dst_filename);
+    bmp_save(dst_filename, image);
 
     free(dst_filename);
 }
 
-void save_tim(const char* src_filename, Uint8* buffer, int length) {
+void save_tim(const char* src_filename, Uint8* buffer, size_t length) {
     char* dst_filename;
 
     dst_filename = get_filename_ext(src_filename, ".tim");
@@ -104,7 +106,7 @@ void save_tim(const char* src_filename, Uint8* buffer, int length) {
     free(dst_filename);
 }
 
-void save_pak(const char* src_filename, Uint8* buffer, int length) {
+void save_pak(const char* src_filename, Uint8* buffer, size_t length) {
     char* dst_filename;
 
     dst_filename = get_filename_ext(src_filename, ".pak");
@@ -118,7 +120,7 @@ void save_pak(const char* src_filename, Uint8* buffer, int length) {
     free(dst_filename);
 }
 
-void save_raw(const char* src_filename, Uint8* buffer, int length) {
+void save_raw(const char* src_filename, Uint8* buffer, size_t length) {
     char* dst_filename;
 
     dst_filename = get_filename_ext(src_filename, ".raw");
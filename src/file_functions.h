@@ -21,16 +21,18 @@
 #ifndef FILE_FUNCTIONS_H
 #define FILE_FUNCTIONS_H 1
 
+#include "bmp.h"
+
 char* get_filename_ext(const char* src_filename, const char* new_ext);
 
-void save_file(const char* filename, void* buffer, int length);
+void save_file(const char* filename, void* buffer, size_t length);
 
-void save_bmp(const char* src_filename, SDL_Surface* image);
+void save_bmp(const char* src_filename, const bmp_image_t* image);
 
-void save_tim(const char* src_filename, Uint8* buffer, int length);
+void save_tim(const char* src_filename, Uint8* buffer, size_t length);
 
-void save_pak(const char* src_filename, Uint8* buffer, int length);
+void save_pak(const char* src_filename, Uint8* buffer, size_t length);
 
-void save_raw(const char* src_filename, Uint8* buffer, int length);
+void save_raw(const char* src_filename, Uint8* buffer, size_t length);
 
 #endif /* FILE_FUNCTIONS_H */
@@ -0,0 +1,127 @@
+/*
+    Fast 64 bits hash, to reject files before computing their MD5
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#include "rw.h"
+
+#include "hash64.h"
+
+/*--- Defines ---*/
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+#define ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+/*--- Functions prototypes ---*/
+
+static Uint64 read64(const Uint8* src);
+static Uint32 read32(const Uint8* src);
+static Uint64 round64(Uint64 acc, Uint64 value);
+static Uint64 merge64(Uint64 acc, Uint64 value);
+
+/*--- Functions ---*/
+
+Uint64 hash64(const Uint8* data, Uint32 length) {
+    const Uint8* end = data + length;
+    Uint64 h;
+
+    if (length >= 32) {
+        const Uint8* limit = end - 32;
+        Uint64 v1 = PRIME64_1 + PRIME64_2;
+        Uint64 v2 = PRIME64_2;
+        Uint64 v3 = 0;
+        Uint64 v4 = 0 - PRIME64_1;
+
+        do {
+            v1 = round64(v1, read64(data));
+            v2 = round64(v2, read64(data + 8));
+            v3 = round64(v3, read64(data + 16));
+            v4 = round64(v4, read64(data + 24));
+            data += 32;
+        } while (data <= limit);
+
+        h = ROTL64(v1, 1) + ROTL64(v2, 7) + ROTL64(v3, 12) + ROTL64(v4, 18);
+        h = merge64(h, v1);
+        h = merge64(h, v2);
+        h = merge64(h, v3);
+        h = merge64(h, v4);
+    } else {
+        h = PRIME64_5;
+    }
+
+    h += length;
+
+    while (data + 8 <= end) {
+        h ^= round64(0, read64(data));
+        h = ROTL64(h, 27) * PRIME64_1 + PRIME64_4;
+        data += 8;
+    }
+    if (data + 4 <= end) {
+        h ^= (Uint64) read32(data) * PRIME64_1;
+        h = ROTL64(h, 23) * PRIME64_2 + PRIME64_3;
+        data += 4;
+    }
+    while (data < end) {
+        h ^= (*data) * PRIME64_5;
+        h = ROTL64(h, 11) * PRIME64_1;
+        data++;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static Uint64 read64(const Uint8* src) {
+    Uint64 value;
+
+    memcpy(&value, src, 8);
+    return rw_swap_le64(value);
+}
+
+static Uint32 read32(const Uint8* src) {
+    Uint32 value;
+
+    memcpy(&value, src, 4);
+    return rw_swap_le32(value);
+}
+
+static Uint64 round64(Uint64 acc, Uint64 value) {
+    acc += value * PRIME64_2;
+    acc = ROTL64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+static Uint64 merge64(Uint64 acc, Uint64 value) {
+    acc ^= round64(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
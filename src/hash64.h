@@ -0,0 +1,35 @@
+/*
+    Fast 64 bits hash, to reject files before computing their MD5
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef HASH64_H
+#define HASH64_H
+
+/*--- Functions ---*/
+
+/*
+    Compute hash of a buffer, same value as XXH64 with seed 0
+
+    data		Buffer to hash
+    length		Length of buffer
+    Returns hash
+*/
+Uint64 hash64(const Uint8* data, Uint32 length);
+
+#endif /* HASH64_H */
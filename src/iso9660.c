@@ -0,0 +1,251 @@
+/*
+    ISO9660 filesystem reader, for CD-ROM images
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "rw.h"
+
+#include "iso9660.h"
+
+/*--- Defines ---*/
+
+#define MAX_DIRS       4096       /* Directories read, against loops in broken images */
+#define MAX_DIR_LENGTH (1 << 20) /* Length of a directory */
+
+#define RECORD_DIRECTORY 2 /* Flag of directory record */
+
+/* Attributes in XA system use area */
+#define XA_FORM2       0x1000
+#define XA_INTERLEAVED 0x2000
+#define XA_CDDA        0x4000
+
+/*--- Types ---*/
+
+typedef struct {
+    char filename[256];
+    Uint32 extent;
+    Uint32 length;
+} iso9660_dir_t;
+
+/*--- Functions prototypes ---*/
+
+static int iso9660_read_sector(
+    rw_t* src, int block_size, int data_offset, Uint32 sector, Uint8* buffer);
+static int iso9660_read_dir(iso9660_t* iso, rw_t* src, int block_size, int data_offset,
+    iso9660_dir_t* dirs, int* num_dirs, int dir);
+static int iso9660_add_file(iso9660_t* iso, const char* filename, Uint32 extent, Uint32 length,
+    int flags);
+static int iso9660_compare(const void* a, const void* b);
+
+
+/*--- Functions ---*/
+
+iso9660_t* iso9660_open(rw_t* src, int block_size, int data_offset) {
+    iso9660_t* iso;
+    iso9660_dir_t* dirs;
+    Uint8 sector[ISO9660_SECTOR_SIZE];
+    Uint8* root;
+    int i, num_dirs = 1;
+
+    /* Primary volume descriptor */
+    if (!iso9660_read_sector(src, block_size, data_offset, ISO9660_PVD_SECTOR, sector)) {
+        return NULL;
+    }
+    if ((sector[0] != 1) || (memcmp(&sector[1], "CD001", 5) != 0) || (sector[6] != 1)) {
+        return NULL;
+    }
+    if ((sector[128] | (sector[129] << 8)) != ISO9660_SECTOR_SIZE) {
+        return NULL;
+    }
+
+    iso = (iso9660_t*) calloc(1, sizeof(iso9660_t));
+    dirs = (iso9660_dir_t*) calloc(MAX_DIRS, sizeof(iso9660_dir_t));
+    if (!iso || !dirs) {
+        fprintf(stderr, "Can not allocate memory for ISO9660 directory\n");
+        free(dirs);
+        free(iso);
+        return NULL;
+    }
+
+    /* Root directory record */
+    root = &sector[156];
+    dirs[0].extent = rw_get_le32(&root[2]);
+    dirs[0].length = rw_get_le32(&root[10]);
+
+    /* Directories found are added after the ones to read */
+    for (i = 0; i < num_dirs; i++) {
+        if (!iso9660_read_dir(iso, src, block_size, data_offset, dirs, &num_dirs, i)) {
+            break;
+        }
+    }
+    free(dirs);
+
+    qsort(iso->files, iso->num_files, sizeof(iso9660_file_t), iso9660_compare);
+    return iso;
+}
+
+static int iso9660_read_sector(
+    rw_t* src, int block_size, int data_offset, Uint32 sector, Uint8* buffer) {
+    if (rw_seek(src, (Sint64) sector * block_size + data_offset, RW_SEEK_SET) < 0) {
+        return 0;
+    }
+    return (rw_read(src, buffer, ISO9660_SECTOR_SIZE, 1) == 1);
+}
+
+/* Read records of a directory, records do not cross sectors */
+static int iso9660_read_dir(iso9660_t* iso, rw_t* src, int block_size, int data_offset,
+    iso9660_dir_t* dirs, int* num_dirs, int dir) {
+    Uint8 sector[ISO9660_SECTOR_SIZE];
+    iso9660_dir_t* parent = &dirs[dir];
+    Uint32 num_sectors, i, pos;
+
+    if (parent->length > MAX_DIR_LENGTH) {
+        return 1;
+    }
+    num_sectors = (parent->length + ISO9660_SECTOR_SIZE - 1) / ISO9660_SECTOR_SIZE;
+
+    for (i = 0; i < num_sectors; i++) {
+        if (!iso9660_read_sector(src, block_size, data_offset, parent->extent + i, sector)) {
+            return 1;
+        }
+
+        for (pos = 0; pos + 33 < ISO9660_SECTOR_SIZE;) {
+            Uint8* record = &sector[pos];
+            int record_length = record[0], name_length = record[32], flags = 0;
+            int su_offset;
+            char name[256], filename[256];
+            char* version;
+
+            /* End of records in this sector */
+            if ((record_length < 34) || (pos + record_length > ISO9660_SECTOR_SIZE)
+                || (33 + name_length > record_length)) {
+                break;
+            }
+            pos += record_length;
+
+            /* Current and parent directory */
+            if ((name_length == 1) && (record[33] <= 1)) {
+                continue;
+            }
+
+            memcpy(name, &record[33], name_length);
+            name[name_length] = '\0';
+            version = strchr(name, ';');
+            if (version) {
+                *version = '\0';
+            }
+            if ((strlen(name) > 0) && (name[strlen(name) - 1] == '.')) {
+                name[strlen(name) - 1] = '\0';
+            }
+            snprintf(filename, sizeof(filename), "%s%s%s", parent->filename,
+                parent->filename[0] ? "/" : "", name);
+
+            /* Mode 2 form 2, interleaved and audio files are not plain data */
+            su_offset = 33 + name_length + ((name_length & 1) ? 0 : 1);
+            if ((su_offset + 14 <= record_length) && (record[su_offset + 6] == 'X')
+                && (record[su_offset + 7] == 'A')) {
+                Uint16 attributes = rw_get_be16(&record[su_offset + 4]);
+
+                if (attributes & (XA_FORM2 | XA_INTERLEAVED | XA_CDDA)) {
+                    flags |= ISO9660_FORM2;
+                }
+            }
+
+            if (record[25] & RECORD_DIRECTORY) {
+                iso9660_dir_t* new_dir;
+
+                if (*num_dirs >= MAX_DIRS) {
+                    continue;
+                }
+                new_dir = &dirs[(*num_dirs)++];
+                snprintf(new_dir->filename, sizeof(new_dir->filename), "%s", filename);
+                new_dir->extent = rw_get_le32(&record[2]);
+                new_dir->length = rw_get_le32(&record[10]);
+                continue;
+            }
+
+            if (!iso9660_add_file(iso, filename, rw_get_le32(&record[2]), rw_get_le32(&record[10]),
+                    flags)) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+static int iso9660_add_file(iso9660_t* iso, const char* filename, Uint32 extent, Uint32 length,
+    int flags) {
+    iso9660_file_t* file;
+
+    if ((iso->num_files & 255) == 0) {
+        iso9660_file_t* files = (iso9660_file_t*) realloc(
+            iso->files, (iso->num_files + 256) * sizeof(iso9660_file_t));
+        if (!files) {
+            fprintf(stderr, "Can not allocate memory for ISO9660 directory\n");
+            return 0;
+        }
+        iso->files = files;
+    }
+
+    file = &iso->files[iso->num_files++];
+    snprintf(file->filename, sizeof(file->filename), "%s", filename);
+    file->extent = extent;
+    file->length = length;
+    file->flags = flags;
+    return 1;
+}
+
+static int iso9660_compare(const void* a, const void* b) {
+    const iso9660_file_t* file_a = (const iso9660_file_t*) a;
+    const iso9660_file_t* file_b = (const iso9660_file_t*) b;
+
+    return (file_a->extent > file_b->extent) - (file_a->extent < file_b->extent);
+}
+
+iso9660_file_t* iso9660_find_extent(iso9660_t* iso, Uint32 extent) {
+    int low = 0, high = iso->num_files;
+
+    while (low < high) {
+        int middle = (low + high) >> 1;
+
+        if (iso->files[middle].extent < extent) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if ((low < iso->num_files) && (iso->files[low].extent == extent)) {
+        return &iso->files[low];
+    }
+    return NULL;
+}
+
+void iso9660_close(iso9660_t* iso) {
+    if (!iso) {
+        return;
+    }
+
+    free(iso->files);
+    free(iso);
+}
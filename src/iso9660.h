@@ -0,0 +1,71 @@
+/*
+    ISO9660 filesystem reader, for CD-ROM images
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef ISO9660_H
+#define ISO9660_H
+
+/*--- Defines ---*/
+
+#define ISO9660_SECTOR_SIZE 2048
+#define ISO9660_PVD_SECTOR  16 /* Primary volume descriptor */
+
+#define ISO9660_FORM2 (1 << 0) /* Mode 2 form 2 or interleaved file, from XA attributes */
+
+/*--- Types ---*/
+
+typedef struct {
+    char filename[256]; /* DIR/SUBDIR/NAME.EXT, without version */
+    Uint32 extent;      /* First sector */
+    Uint32 length;      /* Length in bytes */
+    int flags;
+} iso9660_file_t;
+
+typedef struct {
+    int num_files;
+    iso9660_file_t* files; /* Sorted by extent */
+} iso9660_t;
+
+/*--- Functions ---*/
+
+/*
+    Read directory of ISO9660 filesystem of an image
+
+    src		Image to read
+    block_size	Size of a sector in image, 2048, 2336 or 2352
+    data_offset	Offset of user data in a sector
+    Returns NULL if image has no ISO9660 filesystem
+*/
+iso9660_t* iso9660_open(rw_t* src, int block_size, int data_offset);
+
+/*
+    Find file starting at given sector
+
+    iso		Filesystem
+    extent	First sector of file
+    Returns NULL if no file starts at this sector
+*/
+iso9660_file_t* iso9660_find_extent(iso9660_t* iso, Uint32 extent);
+
+/*
+    Close filesystem, free directory
+*/
+void iso9660_close(iso9660_t* iso);
+
+#endif /* ISO9660_H */
@@ -21,16 +21,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #ifdef HAVE_CONFIG_H
 #    include "config.h"
 #endif
 
-#include <SDL.h>
+#include "rw.h"
+#include "thread.h"
 
 #include "md5.h"
+#include "md5_db.h"
+#include "md5_batch.h"
+#include "hash64.h"
+#include "edc_ecc.h"
+#include "iso9660.h"
+#include "convert.h"
 #include "background_tim.h"
 #include "param.h"
+#include "applets.h"
 
 /*--- Defines ---*/
 
@@ -39,9 +48,46 @@
 #define FILE_TIM_16 2
 #define FILE_EMD    3
 #define FILE_DO3    4
+#define FILE_STR    5
+
+#define SECTOR_OTHER  0 /* Nothing found */
+#define SECTOR_LIMIT  1 /* Nothing found, may split too big files */
+#define SECTOR_DO3    2
+#define SECTOR_TIM_4  3
+#define SECTOR_TIM_8  4
+#define SECTOR_TIM_16 5
+#define SECTOR_EMD    6
+#define SECTOR_XA     7 /* XA audio or other form 2 sector */
+#define SECTOR_STR    8 /* Video sector of STR movie */
+#define SECTOR_SKIP   9 /* Not scanned, in a file found before in range */
+
+#define SECTOR_TYPE 0x1f /* Mask for type of sector */
+#define SECTOR_FS   0x20 /* In a TIM or EMD file of filesystem, not scanned */
+#define SECTOR_EOR  0x40 /* Last sector of record, from XA subheader */
+#define SECTOR_EOF  0x80 /* Last sector of file, from XA subheader */
+
+/* Submode byte of XA subheader */
+#define SUBMODE_EOF   0x80
+#define SUBMODE_FORM2 0x20
+#define SUBMODE_AUDIO 0x04
+#define SUBMODE_VIDEO 0x02
+#define SUBMODE_EOR   0x01
+
+#define MAGIC_STR 0x80010160UL /* First bytes of STR video sector */
 
 #define DATA_LENGTH   2048
-#define MAX_FILE_SIZE (512 << 10)
+#define MAX_FILE_SIZE (512 << 10) /* When length can not be read from header */
+#define CHUNK_SECTORS 2048 /* Sectors read at once, about 4MB */
+#define SCAN_SECTORS  8192 /* Sectors scanned by a thread at once */
+#define MAX_THREADS   64
+#define MAX_BATCH     64 /* Files hashed at once */
+#define MAX_DB        16 /* Catalogues given with -db */
+
+#define INDEX_MAGIC       "REISOIDX"
+#define INDEX_VERSION     3
+#define INDEX_HEADER_SIZE 48
+#define INDEX_FILE_SIZE   48
+#define INDEX_SAMPLES     64 /* Sectors read to identify image */
 
 /*--- Types ---*/
 
@@ -49,11 +95,58 @@ typedef struct {
     const char* value;    /* MD5 value */
     const char* filename; /* Filename */
     int found;
+    Uint32 size; /* Length of file, 0 if unknown */
+    Uint64 hash; /* hash64() of file, 0 if unknown */
 } md5_check_t;
 
+typedef struct {
+    md5_byte_t digest[16];
+    md5_check_t* check;
+} md5_index_t;
+
+typedef struct {
+    Uint32 start; /* First sector */
+    Uint32 end;   /* Sector after last one */
+    int file_type;
+    Uint32 length;
+    Uint32 header_length; /* Length read from header, 0 if unknown */
+    Uint64 hash;
+    int hashed; /* MD5 computed, file may be known */
+    md5_byte_t digest[16];
+    int done;                /* Length and MD5 computed */
+    iso9660_file_t* iso_file; /* File of filesystem starting at same sector, NULL if none */
+} iso_file_t;
+
+typedef struct {
+    const char* filename;
+    int block_size;
+    int data_offset;
+    Uint32 num_sectors;
+    Uint8* sectors;     /* Type of each sector */
+    Uint32* lengths;    /* Length of file read from header sector, 0 if unknown */
+    Uint32 next_sector; /* Next range of sectors to scan */
+    iso_file_t* files;
+    int num_files;
+    int next_file; /* Next file to check */
+    mutex_t* lock;
+    cond_t* file_done;
+    iso9660_t* iso; /* Filesystem of image, NULL if none */
+    Uint64 image_size; /* Image identification for index */
+    Sint64 image_mtime;
+    Uint64 image_hash;
+    int indexed; /* Files read from index */
+} iso_context_t;
+
+typedef struct {
+    rw_t* src;
+    Uint8* data;  /* Sectors read from image */
+    Uint32 first; /* First sector in chunk */
+    Uint32 count;
+} iso_chunk_t;
+
 /*--- Constants ---*/
 
-md5_check_t md5_checks_re3[] = { { "3199387aa01f9b4483859d7bdff1ba99", "data/etc/capcom.tim", 0 },
+static md5_check_t md5_checks_re3[] = { { "3199387aa01f9b4483859d7bdff1ba99", "data/etc/capcom.tim", 0 },
     { "e66a2dd333f61ba00359b070c5f55e47", "data/etc/continue.tim", 0 },
     { "ee67bc522607a3c707d0be2b6215a76d", "data/etc/eidos.tim", 0 },
     { "9f2f16eeb762d31cd857d7e4b5792f56", "data/etc/filei.tim", 0 },
@@ -355,7 +448,7 @@ md5_check_t md5_checks_re3[] = { { "3199387aa01f9b4483859d7bdff1ba99", "data/etc
     { "3bc3dac621d67b678141a3f606c303e2", "room/emd08/em3b.emd", 0 },
     { "0166fe0b59d0ccd56ff6370a20d5cbe2", "room/emd08/em3b.tim", 0 } };
 
-md5_check_t md5_checks_re2[] = {
+static md5_check_t md5_checks_re2[] = {
     { "8479ebef2e5e49489ece15227620f814", "pl0/emd0/em010.emd", 0 },
     { "4385f25501af1b41eb87df27ac515e26", "pl0/emd0/em010.tim", 0 },
     { "0594f2f8e99daf0fe1d4c33ff296404e", "pl0/emd0/em011.emd", 0 },
@@ -605,25 +698,115 @@ static int extract_src = 0;
 /* Extract RE3 by default */
 static int extract_version = 3;
 
-/*--- Functions prototypes ---*/
+/* Number of threads, 0 for one per CPU */
+static int num_threads = 0;
+
+/* Extract a single file, by sector or path */
+static const char* extract_one = NULL;
+
+/* Only check EDC of sectors */
+static int verify_image = 0;
+
+/* Correct sectors with bad EDC using ECC */
+static int correct_sectors = 0;
+
+/* Convert files found in this directory, without writing them first */
+static const char* convert_dir = NULL;
+
+/* Known files, sorted by MD5 */
+static md5_index_t* md5_index = NULL;
+static int md5_index_count = 0;
 
-int browse_iso(const char* filename);
-int get_sector_size(SDL_RWops* src);
-void extract_file(SDL_RWops* src, Uint32 start, Uint32 end, int block_size, int file_type);
+/* Known files of known length, sorted by length then hash */
+static md5_check_t** md5_sizes = NULL;
+static int md5_sizes_count = 0;
 
-Uint32 get_tim_length(Uint8* buffer, Uint32 buflen);
-Uint32 get_emd_length(Uint8* buffer, Uint32 buflen);
+/* Known files of unknown length, TIM and EMD ones */
+static int unknown_tims = 0;
+static int unknown_emds = 0;
+
+/* Catalogues, searched in command line order after known files */
+static md5_db_t* md5_dbs[MAX_DB];
+static int num_dbs = 0;
+
+/*--- Functions prototypes ---*/
+
+static int browse_iso(const char* filename);
+static int get_sector_size(rw_t* src);
+static void add_iso_files(iso_context_t* ctxt);
+
+static int start_threads(iso_context_t* ctxt, thread_func_t fn, thread_t** threads);
+static void wait_threads(thread_t** threads, int count);
+
+static int next_sector_range(iso_context_t* ctxt, Uint32* first, Uint32* last);
+static int scan_sectors(void* data);
+static Uint32 scan_sector(iso_context_t* ctxt, iso_chunk_t* chunk, Uint32 sector);
+static int rescan_sectors(iso_context_t* ctxt);
+static int get_sector_type(Uint8* data);
+static int get_xa_sector_type(iso_context_t* ctxt, Uint8* sector);
+static Uint32 get_header_length(iso_context_t* ctxt, iso_chunk_t* chunk, Uint32 sector, int type);
+static Uint32 get_block_length(Uint8* block);
+static int read_data(iso_context_t* ctxt, iso_chunk_t* chunk, Uint32 sector, Uint32 offset, Uint8* dst,
+    Uint32 length);
+
+static int find_files(iso_context_t* ctxt);
+static void add_file(iso_context_t* ctxt, Uint32 start, Uint32 end, int file_type, Uint32 length);
+
+static int check_files(void* data);
+static void check_batch(rw_t* src, iso_context_t* ctxt, int first, int last, Uint8** buffer,
+    Uint32* buflen);
+static void compact_file(iso_context_t* ctxt, iso_file_t* file, Uint8* buffer, Uint32 first);
+static Uint32 get_file_length(iso_file_t* file, Uint8* data);
+static void save_found_file(iso_file_t* file, Uint8* data);
+static void convert_found_file(iso_file_t* file, Uint8* data);
+static void report_file(iso_file_t* file);
+
+static char* get_index_filename(const char* filename);
+static void identify_image(iso_context_t* ctxt);
+static int load_index(iso_context_t* ctxt);
+static void save_index(iso_context_t* ctxt);
+static int extract_single_file(iso_context_t* ctxt, const char* name);
+static const char* get_known_name(iso_file_t* file);
+
+static int verify_sectors(iso_context_t* ctxt);
+static int check_sectors(void* data);
+static void check_file_sectors(iso_context_t* ctxt, iso_file_t* file, Uint8* buffer, Uint32 first);
+
+static int md5_index_init(void);
+static int md5_index_compare(const void* a, const void* b);
+static md5_check_t* md5_index_find(const md5_byte_t* digest);
+static int md5_size_compare(const void* a, const void* b);
+static int may_be_known(int file_type, Uint32 length, const Uint64* hash);
+
+static Uint32 get_tim_length(Uint8* buffer, Uint32 buflen);
+static Uint32 get_emd_length(Uint8* buffer, Uint32 buflen);
 
 /*--- Functions ---*/
 
+#ifndef MULTICALL
 int main(int argc, char** argv) {
-    int retval;
+    return iso_search_main(argc, argv);
+}
+#endif
+
+int iso_search_main(int argc, char** argv) {
+    int retval, i;
 
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s [-e] [-s] /path/to/filename.iso\n", argv[0]);
+        fprintf(stderr,
+            "Usage: %s [-e] [-c dir] [-s] [-re2] [-j threads] [-db file.db]... "
+            "[-x sector|path] [-verify] [-ecc] /path/to/filename.iso\n",
+            argv[0]);
         return 1;
     }
 
+    extract_files = extract_src = 0;
+    extract_version = 3;
+    num_threads = 0;
+    extract_one = convert_dir = NULL;
+    verify_image = correct_sectors = 0;
+    num_dbs = 0;
+
     if (param_check("-e", argc, argv) >= 0) {
         extract_files = 1;
     }
@@ -633,124 +816,217 @@ int main(int argc, char** argv) {
     if (param_check("-re2", argc, argv) >= 0) {
         extract_version = 2;
     }
+    i = param_check("-j", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        num_threads = atoi(argv[i + 1]);
+    }
+    i = param_check("-x", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        extract_one = argv[i + 1];
+        extract_files = 0;
+    }
+    if (param_check("-verify", argc, argv) >= 0) {
+        verify_image = 1;
+    }
+    if (param_check("-ecc", argc, argv) >= 0) {
+        correct_sectors = 1;
+    }
+    i = param_check("-c", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        convert_dir = argv[i + 1];
+        mkdir(convert_dir, 0755);
+    }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Can not initialize SDL: %s\n", SDL_GetError());
+    if (!md5_index_init()) {
         return 1;
     }
-    atexit(SDL_Quit);
+    edc_ecc_init();
+    if (convert_dir) {
+        convert_init();
+    }
+
+    retval = 0;
+    for (i = 1; i < argc - 2; i++) {
+        if (strcmp(argv[i], "-db") != 0) {
+            continue;
+        }
+        if (num_dbs == MAX_DB) {
+            fprintf(stderr, "Too many catalogues, %s ignored\n", argv[i + 1]);
+            continue;
+        }
+        md5_dbs[num_dbs] = md5_db_open(argv[i + 1]);
+        if (!md5_dbs[num_dbs]) {
+            retval = 1;
+            break;
+        }
+        ++num_dbs;
+    }
+
+    if (retval == 0) {
+        retval = browse_iso(argv[argc - 1]);
+    }
 
-    retval = browse_iso(argv[argc - 1]);
+    for (i = 0; i < num_dbs; i++) {
+        md5_db_close(md5_dbs[i]);
+    }
+    free(md5_sizes);
+    free(md5_index);
+    if (convert_dir) {
+        convert_quit();
+    }
 
-    SDL_Quit();
     return retval;
 }
 
-int browse_iso(const char* filename) {
-    SDL_RWops* src;
-    Uint32 /*length, blocks,*/ offset;
-    Uint8 data[2352];
-    int block_size, stop_extract = 0;
-    int i, extract_flag = 0, file_type = -1, new_file_type = -1;
-    Uint32 start = 0, end = 0;
+static int browse_iso(const char* filename) {
+    rw_t* src;
+    thread_t* threads[MAX_THREADS];
+    iso_context_t ctxt;
+    Sint64 image_length;
+    int i, count, need_read, retval = 0;
 
-    src = SDL_RWFromFile(filename, "rb");
+    src = rw_from_file(filename, "rb");
     if (!src) {
         fprintf(stderr, "Can not open %s for reading\n", filename);
         return 1;
     }
 
-    block_size = get_sector_size(src);
-    printf("Sector size: %d\n", block_size);
+    memset(&ctxt, 0, sizeof(ctxt));
+    ctxt.filename = filename;
 
-    start = end = 0;
-    offset = ((block_size == 2352) ? 16 + 8 : (block_size == 2336 ? 8 : 0));
-    for (i = 0; !stop_extract; offset += block_size, i++) {
-        Uint32 value;
+    ctxt.block_size = get_sector_size(src);
+    printf("Sector size: %d\n", ctxt.block_size);
 
-        SDL_RWseek(src, offset, RW_SEEK_SET);
-        if (SDL_RWread(src, data, block_size, 1) != 1) {
-            fprintf(stderr, "Block %d: end of CD\n", i);
-            stop_extract = 1;
-            continue;
+    ctxt.data_offset =
+        ((ctxt.block_size == 2352) ? 16 + 8 : (ctxt.block_size == 2336 ? 8 : 0));
+
+    /* Only sectors which can be read whole after their header are scanned */
+    image_length = rw_seek(src, 0, RW_SEEK_END);
+    if (image_length >= ctxt.data_offset + ctxt.block_size) {
+        ctxt.num_sectors = (image_length - ctxt.data_offset) / ctxt.block_size;
+    }
+
+    /* Files of filesystem are found from directory, not from headers */
+    ctxt.iso = iso9660_open(src, ctxt.block_size, ctxt.data_offset);
+    if (ctxt.iso) {
+        printf("ISO9660 filesystem: %d files\n", ctxt.iso->num_files);
+    }
+    rw_close(src);
+
+    ctxt.lock = mutex_create();
+    ctxt.file_done = cond_create();
+    if (!ctxt.lock || !ctxt.file_done) {
+        fprintf(stderr, "Can not allocate memory to scan image\n");
+        mutex_destroy(ctxt.lock);
+        cond_destroy(ctxt.file_done);
+        iso9660_close(ctxt.iso);
+        return 1;
+    }
+
+    if (verify_image) {
+        retval = verify_sectors(&ctxt);
+
+        iso9660_close(ctxt.iso);
+        cond_destroy(ctxt.file_done);
+        mutex_destroy(ctxt.lock);
+        return retval;
+    }
+
+    ctxt.image_size = image_length;
+    identify_image(&ctxt);
+
+    /* Use files found by a previous run, or scan image */
+    if (!load_index(&ctxt)) {
+        ctxt.sectors = (Uint8*) calloc(ctxt.num_sectors + 1, 1);
+        ctxt.lengths = (Uint32*) calloc(ctxt.num_sectors + 1, sizeof(Uint32));
+        if (!ctxt.sectors || !ctxt.lengths) {
+            fprintf(stderr, "Can not allocate memory to scan image\n");
+            free(ctxt.sectors);
+            free(ctxt.lengths);
+            mutex_destroy(ctxt.lock);
+            cond_destroy(ctxt.file_done);
+            iso9660_close(ctxt.iso);
+            return 1;
         }
+        add_iso_files(&ctxt);
 
-        value = (data[3] << 24) | (data[2] << 16) | (data[1] << 8) | data[0];
+        /* Find type of each sector, threads scan ranges of sectors */
+        count = start_threads(&ctxt, scan_sectors, threads);
+        wait_threads(threads, count);
+        rescan_sectors(&ctxt);
 
-        if (value == 0x00601408UL) {
-            value = (data[4 + 3] << 24) | (data[4 + 2] << 16) | (data[4 + 1] << 8) | data[4];
+        /* Then split image in files, in sector order */
+        find_files(&ctxt);
+    }
 
-            if (value == 0x00612408UL) {
-                end = i;
-                extract_flag = 1;
-                /*new_file_type = FILE_DO3;*/
-                new_file_type = -1;
-            }
-        } else if (value == MAGIC_TIM) {
-            /* TIM image ? */
-            value = (data[4 + 3] << 24) | (data[4 + 2] << 16) | (data[4 + 1] << 8) | data[4];
-
-            switch (value) {
-            case TIM_TYPE_4:
-                end = i;
-                extract_flag = 1;
-                new_file_type = FILE_TIM_4;
-                break;
-            case TIM_TYPE_8:
-                end = i;
-                extract_flag = 1;
-                new_file_type = FILE_TIM_8;
-                break;
-            case TIM_TYPE_16:
-                end = i;
-                extract_flag = 1;
-                new_file_type = FILE_TIM_16;
-                break;
-            }
-        } else if (value < 512 << 10) {
-            /* EMD model ? */
-            value = (data[4 + 3] << 24) | (data[4 + 2] << 16) | (data[4 + 1] << 8) | data[4];
-
-            if (value == 0x0f) {
-                end = i;
-                extract_flag = 1;
-                new_file_type = FILE_EMD;
-            }
-        } else if ((i - start) * block_size >= MAX_FILE_SIZE) {
-            end = i;
-            extract_flag = 1;
-            new_file_type = -1;
+    for (i = 0; (i < ctxt.num_files) && ctxt.iso; i++) {
+        ctxt.files[i].iso_file = iso9660_find_extent(ctxt.iso, ctxt.files[i].start);
+    }
+
+    /* Files from index are only read if needed */
+    need_read = !ctxt.indexed || extract_files || convert_dir;
+    for (i = 0; (i < ctxt.num_files) && !need_read; i++) {
+        iso_file_t* file = &ctxt.files[i];
+
+        if (!file->hashed && (extract_src || may_be_known(file->file_type, file->length, &file->hash))) {
+            need_read = 1;
         }
+    }
+    if (!need_read) {
+        for (i = 0; i < ctxt.num_files; i++) {
+            ctxt.files[i].done = 1;
+        }
+    }
 
-        if ((start != 0) && (end != 0) && extract_flag) {
-            if (file_type != -1) {
-                extract_file(src, start, end, block_size, file_type);
+    if (extract_one) {
+        /* Only identify files, then extract the one asked */
+        count = (need_read ? start_threads(&ctxt, check_files, threads) : 0);
+        wait_threads(threads, count);
+
+        retval = extract_single_file(&ctxt, extract_one);
+    } else {
+        /* Threads read and identify files, which are reported in order */
+        count = (need_read ? start_threads(&ctxt, check_files, threads) : 0);
+        for (i = 0; i < ctxt.num_files; i++) {
+            mutex_lock(ctxt.lock);
+            while (!ctxt.files[i].done) {
+                cond_wait(ctxt.file_done, ctxt.lock);
             }
-            extract_flag = 0;
-            file_type = new_file_type;
-        }
-        if (end != 0) {
-            start = end;
-            end = 0;
+            mutex_unlock(ctxt.lock);
+
+            report_file(&ctxt.files[i]);
         }
+        wait_threads(threads, count);
+
+        fprintf(stderr, "Block %d: end of CD\n", ctxt.num_sectors);
     }
 
-    SDL_RWclose(src);
-    return 0;
+    /* Files read again may have new MD5 */
+    if (need_read) {
+        save_index(&ctxt);
+    }
+
+    free(ctxt.files);
+    free(ctxt.sectors);
+    free(ctxt.lengths);
+    iso9660_close(ctxt.iso);
+    cond_destroy(ctxt.file_done);
+    mutex_destroy(ctxt.lock);
+    return retval;
 }
 
-int get_sector_size(SDL_RWops* src) {
+static int get_sector_size(rw_t* src) {
     char tmp[12];
     const char xamode[12] = { 0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0 };
 
-    SDL_RWseek(src, 0, RW_SEEK_SET);
-    SDL_RWread(src, tmp, 12, 1);
+    rw_seek(src, 0, RW_SEEK_SET);
+    rw_read(src, tmp, 12, 1);
     if (memcmp(tmp, xamode, 12) != 0) {
         return 2048;
     }
 
-    SDL_RWseek(src, 2352, RW_SEEK_SET);
-    SDL_RWread(src, tmp, 12, 1);
+    rw_seek(src, 2352, RW_SEEK_SET);
+    rw_read(src, tmp, 12, 1);
     if (memcmp(tmp, xamode, 12) != 0) {
         return 2336;
     }
@@ -758,154 +1034,1480 @@ int get_sector_size(SDL_RWops* src) {
     return 2352;
 }
 
-void extract_file(SDL_RWops* src, Uint32 start, Uint32 end, int block_size, int file_type) {
-    Uint8* buffer;
-    Uint32 length = DATA_LENGTH * (end - start);
-    int i, found, count, dumped;
-    char filename[16];
-    char* fileext = "%08x.bin";
-    SDL_RWops* dst;
-    md5_check_t* md5_checks = md5_checks_re3;
+/*
+    TIM and EMD files of filesystem are found from their extent, with the
+    type read from their header, and their sectors are not scanned
+*/
+static void add_iso_files(iso_context_t* ctxt) {
+    rw_t* src;
+    int i;
 
-    md5_state_t state;
-    md5_byte_t digest[16];
-    char md5_file[32 + 1];
+    if (!ctxt->iso) {
+        return;
+    }
 
-    buffer = (Uint8*) malloc(length);
-    if (!buffer) {
+    src = rw_from_file(ctxt->filename, "rb");
+    if (!src) {
+        fprintf(stderr, "Can not open %s for reading\n", ctxt->filename);
         return;
     }
 
-    for (i = 0; i < end - start; i++) {
-        if (block_size == 2352) {
-            SDL_RWseek(src, ((start + i) * 2352) + 16 + 8, RW_SEEK_SET);
-        } else if (block_size == 2336) {
-            SDL_RWseek(src, ((start + i) * 2336) + 8, RW_SEEK_SET);
-        } else {
-            SDL_RWseek(src, ((start + i) * 2048) + 0, RW_SEEK_SET);
+    for (i = 0; i < ctxt->iso->num_files; i++) {
+        iso9660_file_t* file = &ctxt->iso->files[i];
+        Uint32 count = (file->length + DATA_LENGTH - 1) / DATA_LENGTH;
+        const char* ext = strrchr(file->filename, '.');
+        Uint8 header[8];
+        int type, is_tim, is_emd;
+
+        if ((file->flags & ISO9660_FORM2) || (file->length < 8) || !ext
+            || (file->extent >= ctxt->num_sectors) || (count > ctxt->num_sectors - file->extent)) {
+            continue;
+        }
+#ifdef WIN32
+        is_tim = (_stricmp(ext, ".tim") == 0);
+        is_emd = (_stricmp(ext, ".emd") == 0);
+#else
+        is_tim = (strcasecmp(ext, ".tim") == 0);
+        is_emd = (strcasecmp(ext, ".emd") == 0);
+#endif
+        if (!is_tim && !is_emd) {
+            continue;
         }
-        SDL_RWread(src, &buffer[i * DATA_LENGTH], DATA_LENGTH, 1);
-    }
 
-    switch (file_type) {
-    case FILE_TIM_4:
-    case FILE_TIM_8:
-    case FILE_TIM_16:
-        fileext = "%08x.tim";
-        length = get_tim_length(buffer, length);
-        break;
-    case FILE_EMD:
-        fileext = "%08x.emd";
-        length = get_emd_length(buffer, length);
-        break;
-    case FILE_DO3:
-        fileext = "%08x.do3";
-        /*length = get_emd_length(buffer, length);*/
-        break;
+        rw_seek(src, (Sint64) file->extent * ctxt->block_size + ctxt->data_offset, RW_SEEK_SET);
+        if (rw_read(src, header, sizeof(header), 1) != 1) {
+            continue;
+        }
+
+        /* Files without a valid header are left to scan */
+        type = get_sector_type(header);
+        if (is_tim && (type != SECTOR_TIM_4) && (type != SECTOR_TIM_8) && (type != SECTOR_TIM_16)) {
+            continue;
+        }
+        if (is_emd && (type != SECTOR_EMD)) {
+            continue;
+        }
+
+        memset(&ctxt->sectors[file->extent], SECTOR_OTHER | SECTOR_FS, count);
+        ctxt->sectors[file->extent] = type | SECTOR_FS;
+        ctxt->lengths[file->extent] = file->length;
     }
-    sprintf(filename, fileext, start);
 
-    /* Check MD5 for a known file */
-    md5_init(&state);
-    md5_append(&state, (const md5_byte_t*) buffer, length);
-    md5_finish(&state, digest);
+    rw_close(src);
+}
+
+/* Run function in threads, or directly if none could be created */
+static int start_threads(iso_context_t* ctxt, thread_func_t fn, thread_t** threads) {
+    int i, count = num_threads;
 
-    for (i = 0; i < 16; i++) {
-        sprintf(&md5_file[i * 2], "%02x", digest[i]);
+    if (count <= 0) {
+        count = cpu_count();
+    }
+    if (count > MAX_THREADS) {
+        count = MAX_THREADS;
     }
 
-    found = -1;
-    dumped = 0;
-    count = sizeof(md5_checks_re3) / sizeof(md5_check_t);
-    if (extract_version == 2) {
-        count = sizeof(md5_checks_re2) / sizeof(md5_check_t);
-        md5_checks = md5_checks_re2;
+    for (i = 0; i < count; i++) {
+        threads[i] = thread_create(fn, ctxt);
+        if (!threads[i]) {
+            break;
+        }
     }
+
+    if (i == 0) {
+        fn(ctxt);
+    }
+
+    return i;
+}
+
+static void wait_threads(thread_t** threads, int count) {
+    int i;
+
     for (i = 0; i < count; i++) {
-        if (memcmp(md5_file, md5_checks[i].value, 32) != 0) {
-            /* Not this md5, continue */
+        thread_wait(threads[i]);
+    }
+}
+
+static int scan_sectors(void* data) {
+    iso_context_t* ctxt = (iso_context_t*) data;
+    iso_chunk_t chunk;
+    Uint32 first, last, i, j, skip_to;
+
+    chunk.src = rw_from_file(ctxt->filename, "rb");
+    if (!chunk.src) {
+        fprintf(stderr, "Can not open %s for reading\n", ctxt->filename);
+        return 1;
+    }
+
+    chunk.data = (Uint8*) malloc(CHUNK_SECTORS * ctxt->block_size);
+    if (!chunk.data) {
+        fprintf(stderr, "Can not allocate memory to read image\n");
+        rw_close(chunk.src);
+        return 1;
+    }
+
+    while (next_sector_range(ctxt, &first, &last)) {
+        skip_to = first;
+        for (i = first; i < last; i += chunk.count) {
+            /* Sectors of a file which length is known are not read */
+            if (i < skip_to) {
+                chunk.count = (skip_to < last ? skip_to : last) - i;
+                for (j = 0; j < chunk.count; j++) {
+                    if (!(ctxt->sectors[i + j] & SECTOR_FS)) {
+                        ctxt->sectors[i + j] = SECTOR_SKIP;
+                    }
+                }
+                continue;
+            }
+            if (ctxt->sectors[i] & SECTOR_FS) {
+                chunk.count = 1;
+                continue;
+            }
+
+            /* Chunk stops at next file of filesystem */
+            chunk.first = i;
+            for (chunk.count = 0;
+                 (chunk.count < CHUNK_SECTORS) && (i + chunk.count < last)
+                 && !(ctxt->sectors[i + chunk.count] & SECTOR_FS);
+                 chunk.count++) {
+            }
+
+            rw_seek(chunk.src, (Sint64) i * ctxt->block_size, RW_SEEK_SET);
+            if (rw_read(chunk.src, chunk.data, chunk.count * ctxt->block_size, 1) != 1) {
+                fprintf(stderr, "Block %d: can not read\n", i);
+                break;
+            }
+
+            for (j = 0; j < chunk.count; j++) {
+                Uint32 length;
+
+                if (i + j < skip_to) {
+                    ctxt->sectors[i + j] = SECTOR_SKIP;
+                    continue;
+                }
+
+                length = scan_sector(ctxt, &chunk, i + j);
+                if (length) {
+                    skip_to = i + j + (length + DATA_LENGTH - 1) / DATA_LENGTH;
+                }
+            }
+        }
+    }
+
+    free(chunk.data);
+    rw_close(chunk.src);
+    return 0;
+}
+
+/* Set type of a sector read in chunk, returns length of file if a header */
+static Uint32 scan_sector(iso_context_t* ctxt, iso_chunk_t* chunk, Uint32 sector) {
+    Uint8* data = &chunk->data[(sector - chunk->first) * ctxt->block_size];
+    int type;
+
+    /* Audio and video sectors are not searched for headers */
+    type = get_xa_sector_type(ctxt, data);
+    ctxt->sectors[sector] = type;
+    if ((type & SECTOR_TYPE) != SECTOR_OTHER) {
+        return 0;
+    }
+
+    type |= get_sector_type(&data[ctxt->data_offset]);
+    ctxt->sectors[sector] = type;
+
+    ctxt->lengths[sector] = get_header_length(ctxt, chunk, sector, type & SECTOR_TYPE);
+    return ctxt->lengths[sector];
+}
+
+/*
+    A range may start inside a file found in previous range, then files
+    found there may skip sectors which are not in a file for a scan of
+    whole image in order. Go through the image as such a scan would, and
+    scan the sectors which were skipped.
+*/
+static int rescan_sectors(iso_context_t* ctxt) {
+    iso_chunk_t chunk;
+    Uint32 i, skip_to = 0;
+
+    chunk.src = rw_from_file(ctxt->filename, "rb");
+    if (!chunk.src) {
+        fprintf(stderr, "Can not open %s for reading\n", ctxt->filename);
+        return 1;
+    }
+
+    chunk.data = (Uint8*) malloc(ctxt->block_size);
+    if (!chunk.data) {
+        fprintf(stderr, "Can not allocate memory to read image\n");
+        rw_close(chunk.src);
+        return 1;
+    }
+    chunk.count = 1;
+
+    for (i = 0; i < ctxt->num_sectors; i++) {
+        if ((i < skip_to) || (ctxt->sectors[i] & SECTOR_FS)) {
             continue;
         }
 
-        if (md5_checks[i].found) {
-            dumped = 1;
+        if (ctxt->sectors[i] == SECTOR_SKIP) {
+            chunk.first = i;
+            rw_seek(chunk.src, (Sint64) i * ctxt->block_size, RW_SEEK_SET);
+            if (rw_read(chunk.src, chunk.data, ctxt->block_size, 1) != 1) {
+                fprintf(stderr, "Block %d: can not read\n", i);
+                break;
+            }
+            scan_sector(ctxt, &chunk, i);
         }
 
-        /* Known md5 -> known file */
-        md5_checks[i].found = 1;
-        found = i;
-        break;
+        if (ctxt->lengths[i]) {
+            skip_to = i + (ctxt->lengths[i] + DATA_LENGTH - 1) / DATA_LENGTH;
+        }
     }
 
-    if (!extract_src) {
-        const char* filename = "";
-        const char* already = "";
-        if (found != -1) {
-            filename = md5_checks[i].filename;
+    free(chunk.data);
+    rw_close(chunk.src);
+    return 0;
+}
+
+/* Take next range of sectors to scan, returns 0 when whole image is taken */
+static int next_sector_range(iso_context_t* ctxt, Uint32* first, Uint32* last) {
+    mutex_lock(ctxt->lock);
+    *first = ctxt->next_sector;
+    if (ctxt->next_sector < ctxt->num_sectors) {
+        ctxt->next_sector += SCAN_SECTORS;
+    }
+    mutex_unlock(ctxt->lock);
+
+    if (*first >= ctxt->num_sectors) {
+        return 0;
+    }
+    *last = *first + SCAN_SECTORS;
+    if (*last > ctxt->num_sectors) {
+        *last = ctxt->num_sectors;
+    }
+    return 1;
+}
+
+static int get_sector_type(Uint8* data) {
+    Uint32 value;
+
+    value = (data[3] << 24) | (data[2] << 16) | (data[1] << 8) | data[0];
+
+    if (value == 0x00601408UL) {
+        value = (data[4 + 3] << 24) | (data[4 + 2] << 16) | (data[4 + 1] << 8) | data[4];
+
+        if (value == 0x00612408UL) {
+            return SECTOR_DO3;
         }
-        if (dumped) {
-            already = " already dumped";
+    } else if (value == MAGIC_TIM) {
+        /* TIM image ? */
+        value = (data[4 + 3] << 24) | (data[4 + 2] << 16) | (data[4 + 1] << 8) | data[4];
+
+        switch (value) {
+        case TIM_TYPE_4:
+            return SECTOR_TIM_4;
+        case TIM_TYPE_8:
+            return SECTOR_TIM_8;
+        case TIM_TYPE_16:
+            return SECTOR_TIM_16;
         }
-        switch (file_type) {
-        case FILE_TIM_4:
-            printf("Sector %d: 4 bits TIM image %s%s\n", start, filename, already);
-            break;
-        case FILE_TIM_8:
-            printf("Sector %d: 8 bits TIM image %s%s\n", start, filename, already);
-            break;
-        case FILE_TIM_16:
-            printf("Sector %d: 16 bits TIM image %s%s\n", start, filename, already);
-            break;
-        case FILE_EMD:
-            printf("Sector %d: EMD file %s%s\n", start, filename, already);
-            break;
-        case FILE_DO3:
-            printf("Sector %d: DO3 file %s%s\n", start, filename, already);
-            break;
+    } else if (value == MAGIC_STR) {
+        return SECTOR_STR;
+    } else if (value < 512 << 10) {
+        /* EMD model ? */
+        value = (data[4 + 3] << 24) | (data[4 + 2] << 16) | (data[4 + 1] << 8) | data[4];
+
+        if (value == 0x0f) {
+            return SECTOR_EMD;
         }
+    } else {
+        return SECTOR_LIMIT;
     }
 
-    if (extract_files) {
-        dst = SDL_RWFromFile(filename, "wb");
-        if (!dst) {
-            fprintf(stderr, "Can not create %s for writing\n", filename);
-            free(buffer);
-            return;
+    return SECTOR_OTHER;
+}
+
+/*
+    Type of sector from its XA subheader, for 2336 and 2352 bytes sectors:
+    SECTOR_XA or SECTOR_STR for audio and video, SECTOR_OTHER for data,
+    with SECTOR_EOR and SECTOR_EOF flags.
+*/
+static int get_xa_sector_type(iso_context_t* ctxt, Uint8* sector) {
+    Uint8* subheader = &sector[ctxt->data_offset - 8];
+    Uint8* data = &sector[ctxt->data_offset];
+    int type = SECTOR_OTHER;
+
+    /* Subheader is written twice, else it is not valid */
+    if ((ctxt->block_size == 2048) || (memcmp(subheader, subheader + 4, 4) != 0)) {
+        return SECTOR_OTHER;
+    }
+
+    if (subheader[2] & SUBMODE_AUDIO) {
+        type = SECTOR_XA;
+    } else if ((subheader[2] & SUBMODE_VIDEO)
+        || ((data[0] | (data[1] << 8) | (data[2] << 16) | ((Uint32) data[3] << 24)) == MAGIC_STR)) {
+        type = SECTOR_STR;
+    } else if (subheader[2] & SUBMODE_FORM2) {
+        type = SECTOR_XA;
+    }
+
+    if (subheader[2] & SUBMODE_EOR) {
+        type |= SECTOR_EOR;
+    }
+    if (subheader[2] & SUBMODE_EOF) {
+        type |= SECTOR_EOF;
+    }
+    return type;
+}
+
+/* Read length of file from its header, and check that layout is valid */
+static Uint32 get_header_length(iso_context_t* ctxt, iso_chunk_t* chunk, Uint32 sector, int type) {
+    Uint8 header[20], block[12];
+    Uint64 image_length = (Uint64) (ctxt->num_sectors - sector) * DATA_LENGTH;
+    Uint32 max_length = (image_length > 0xffffffffUL ? 0xffffffffUL : (Uint32) image_length);
+    Uint32 length, clut_length, img_length, emd_dir[15];
+    int i;
+
+    switch (type) {
+    case SECTOR_TIM_4:
+    case SECTOR_TIM_8:
+    case SECTOR_TIM_16:
+        if (!read_data(ctxt, chunk, sector, 0, header, 20)) {
+            return 0;
+        }
+
+        /* 4 and 8 bits images have a CLUT block before image block */
+        length = 8;
+        if (type != SECTOR_TIM_16) {
+            clut_length = get_block_length(header + 8);
+            if ((clut_length == 0) || (clut_length > max_length - length)) {
+                return 0;
+            }
+            length += clut_length;
+        }
+
+        if ((length + 12 > max_length) || !read_data(ctxt, chunk, sector, length, block, 12)) {
+            return 0;
+        }
+        img_length = get_block_length(block);
+        if ((img_length == 0) || (img_length > max_length - length)) {
+            return 0;
+        }
+        return length + img_length;
+
+    case SECTOR_EMD:
+        if (!read_data(ctxt, chunk, sector, 0, header, 8)) {
+            return 0;
+        }
+
+        /* Directory of 15 sections at end of file, sections are before it */
+        length = header[0] | (header[1] << 8) | (header[2] << 16) | (header[3] << 24);
+        if ((length < 8) || (length & 3) || (length + 4 * 15 > max_length)) {
+            return 0;
+        }
+        if (!read_data(ctxt, chunk, sector, length, (Uint8*) emd_dir, 4 * 15)) {
+            return 0;
         }
+        for (i = 0; i < 15; i++) {
+            Uint32 offset = rw_swap_le32(emd_dir[i]);
+
+            if ((offset < 8) || (offset >= length)) {
+                return 0;
+            }
+        }
+        return length + 4 * 15;
+    }
 
-        SDL_RWwrite(dst, buffer, length, 1);
-        SDL_RWclose(dst);
+    return 0;
+}
+
+/*
+    Length of a TIM block, from its header: length, x, y, width, height.
+    Returns 0 if block is empty, or length does not match its size.
+*/
+static Uint32 get_block_length(Uint8* block) {
+    Uint32 length = block[0] | (block[1] << 8) | (block[2] << 16) | ((Uint32) block[3] << 24);
+    Uint32 width = block[8] | (block[9] << 8);
+    Uint32 height = block[10] | (block[11] << 8);
+
+    if ((width == 0) || (height == 0) || (length != 12 + 2 * width * height)) {
+        return 0;
     }
+    return length;
+}
+
+/* Read data of a file, from chunk if possible */
+static int read_data(iso_context_t* ctxt, iso_chunk_t* chunk, Uint32 sector, Uint32 offset, Uint8* dst,
+    Uint32 length) {
+    while (length > 0) {
+        Uint32 s = sector + offset / DATA_LENGTH;
+        Uint32 pos = offset % DATA_LENGTH;
+        Uint32 count = DATA_LENGTH - pos;
 
-    if (extract_src) {
-        if (found == -1) {
-            /*fprintf(stderr,"\t{%d,%d,\"%s\"},\n",start,end-start, filename);*/
-            fprintf(stderr, "\t{%d,%d,\"\"},\n", start, end - start);
+        if (count > length) {
+            count = length;
+        }
+        if (s >= ctxt->num_sectors) {
+            return 0;
+        }
+
+        if ((s >= chunk->first) && (s < chunk->first + chunk->count)) {
+            memcpy(dst, &chunk->data[(s - chunk->first) * ctxt->block_size + ctxt->data_offset + pos],
+                count);
         } else {
-            fprintf(stderr, "\t{%d,%d,\"%s\"},\n", start, end - start, md5_checks[i].filename);
+            rw_seek(chunk->src, (Sint64) s * ctxt->block_size + ctxt->data_offset + pos,
+                RW_SEEK_SET);
+            if (rw_read(chunk->src, dst, count, 1) != 1) {
+                return 0;
+            }
         }
+
+        dst += count;
+        offset += count;
+        length -= count;
     }
 
-    free(buffer);
+    return 1;
 }
 
-Uint32 get_tim_length(Uint8* buffer, Uint32 buflen) {
-    tim_header_t* tim_header = (tim_header_t*) buffer;
-    tim_size_t* tim_size;
-    int w, h, img_offset;
+static int find_files(iso_context_t* ctxt) {
+    int file_type = -1, new_file_type, header;
+    Uint32 i, start = 0, count, str_start = 0, str_end = 0, str_sectors = 0;
 
-    img_offset = SDL_SwapLE32(tim_header->offset) + 20;
+    for (i = 0; i < ctxt->num_sectors; i++) {
+        int type = ctxt->sectors[i] & SECTOR_TYPE;
+
+        /* Audio and video sectors end data file */
+        if (((type == SECTOR_XA) || (type == SECTOR_STR)) && (file_type != -1)) {
+            add_file(ctxt, start, i, file_type, 0);
+            file_type = -1;
+        }
+
+        /* Video sectors of a movie, audio may be interleaved */
+        if (type == SECTOR_STR) {
+            if (str_sectors == 0) {
+                str_start = i;
+            }
+            ++str_sectors;
+            str_end = i + 1;
+            if (ctxt->sectors[i] & SECTOR_EOF) {
+                add_file(ctxt, str_start, str_end, FILE_STR, str_sectors * DATA_LENGTH);
+                str_sectors = 0;
+            }
+            continue;
+        }
+        if (type == SECTOR_XA) {
+            continue;
+        }
+
+        /* A data sector ends movie */
+        if (str_sectors) {
+            add_file(ctxt, str_start, str_end, FILE_STR, str_sectors * DATA_LENGTH);
+            str_sectors = 0;
+        }
+
+        header = 1;
+        switch (type) {
+        case SECTOR_DO3:
+            /*new_file_type = FILE_DO3;*/
+            new_file_type = -1;
+            break;
+        case SECTOR_TIM_4:
+            new_file_type = FILE_TIM_4;
+            break;
+        case SECTOR_TIM_8:
+            new_file_type = FILE_TIM_8;
+            break;
+        case SECTOR_TIM_16:
+            new_file_type = FILE_TIM_16;
+            break;
+        case SECTOR_EMD:
+            new_file_type = FILE_EMD;
+            break;
+        case SECTOR_LIMIT:
+            if ((file_type != -1) && ((i - start) * ctxt->block_size >= MAX_FILE_SIZE)) {
+                add_file(ctxt, start, i, file_type, 0);
+                file_type = -1;
+            }
+            header = 0;
+            break;
+        default:
+            header = 0;
+            break;
+        }
+
+        if (header) {
+            /* A new header ends previous file */
+            if (file_type != -1) {
+                add_file(ctxt, start, i, file_type, 0);
+            }
+            start = i;
+            file_type = new_file_type;
+
+            /* Length known from header, go to sector after file */
+            if ((file_type != -1) && ctxt->lengths[i]) {
+                count = (ctxt->lengths[i] + DATA_LENGTH - 1) / DATA_LENGTH;
+                add_file(ctxt, i, i + count, file_type, ctxt->lengths[i]);
+                file_type = -1;
+                i += count - 1;
+                continue;
+            }
+        }
+
+        /* Subheader marks last sector of file */
+        if ((file_type != -1) && (ctxt->sectors[i] & (SECTOR_EOR | SECTOR_EOF))) {
+            add_file(ctxt, start, i + 1, file_type, 0);
+            file_type = -1;
+        }
+    }
+
+    /* Last file ends with image */
+    if (file_type != -1) {
+        add_file(ctxt, start, ctxt->num_sectors, file_type, 0);
+    }
+    if (str_sectors) {
+        add_file(ctxt, str_start, str_end, FILE_STR, str_sectors * DATA_LENGTH);
+    }
+
+    return ctxt->num_files;
+}
+
+static void add_file(iso_context_t* ctxt, Uint32 start, Uint32 end, int file_type, Uint32 length) {
+    iso_file_t* file;
+
+    if ((ctxt->num_files & 255) == 0) {
+        iso_file_t* files =
+            (iso_file_t*) realloc(ctxt->files, (ctxt->num_files + 256) * sizeof(iso_file_t));
+        if (!files) {
+            fprintf(stderr, "Can not allocate memory for file list\n");
+            return;
+        }
+        ctxt->files = files;
+    }
+
+    file = &ctxt->files[ctxt->num_files++];
+    memset(file, 0, sizeof(iso_file_t));
+    file->start = start;
+    file->end = end;
+    file->file_type = file_type;
+    file->header_length = length;
+}
+
+static int check_files(void* data) {
+    iso_context_t* ctxt = (iso_context_t*) data;
+    rw_t* src;
+    Uint8* buffer = NULL;
+    Uint32 buflen = 0;
+    int first, last, i;
+
+    src = rw_from_file(ctxt->filename, "rb");
+
+    for (;;) {
+        /* Take next files, as many as fit in a chunk */
+        mutex_lock(ctxt->lock);
+        first = last = ctxt->next_file;
+        while ((last < ctxt->num_files) && (last - first < MAX_BATCH)) {
+            if ((last > first)
+                && (ctxt->files[last].end - ctxt->files[first].start > CHUNK_SECTORS)) {
+                break;
+            }
+            last++;
+        }
+        ctxt->next_file = last;
+        mutex_unlock(ctxt->lock);
+
+        if (first >= ctxt->num_files) {
+            break;
+        }
+
+        if (src) {
+            check_batch(src, ctxt, first, last, &buffer, &buflen);
+        }
+
+        mutex_lock(ctxt->lock);
+        for (i = first; i < last; i++) {
+            ctxt->files[i].done = 1;
+        }
+        cond_broadcast(ctxt->file_done);
+        mutex_unlock(ctxt->lock);
+    }
+
+    free(buffer);
+    if (src) {
+        rw_close(src);
+    }
+    return 0;
+}
+
+/* Read sectors of files from first to last-1 at once, then hash them together */
+static void check_batch(rw_t* src, iso_context_t* ctxt, int first, int last, Uint8** buffer,
+    Uint32* buflen) {
+    Uint32 start = ctxt->files[first].start;
+    Uint32 num_sectors = ctxt->files[last - 1].end - start;
+    Uint32 size = ctxt->block_size * num_sectors;
+    md5_batch_job_t jobs[MAX_BATCH];
+    Uint8 job_done[MAX_BATCH];
+    int i, num_jobs = 0;
+
+    /* Files from index are only read to compute missing MD5 */
+    if (ctxt->indexed && !extract_files && !convert_dir) {
+        for (i = first; i < last; i++) {
+            iso_file_t* file = &ctxt->files[i];
+
+            if (!file->hashed && (extract_src || may_be_known(file->file_type, file->length, &file->hash))) {
+                break;
+            }
+        }
+        if (i == last) {
+            return;
+        }
+    }
+
+    if (*buflen < size) {
+        Uint8* new_buffer = (Uint8*) realloc(*buffer, size);
+        if (!new_buffer) {
+            fprintf(stderr, "Can not allocate %d bytes for file\n", size);
+            return;
+        }
+        *buffer = new_buffer;
+        *buflen = size;
+    }
+
+    /* Read all sectors at once, then keep only data part */
+    rw_seek(src, (Sint64) start * ctxt->block_size, RW_SEEK_SET);
+    if (rw_read(src, *buffer, size, 1) != 1) {
+        for (i = first; i < last; i++) {
+            fprintf(stderr, "Block %d: can not read\n", ctxt->files[i].start);
+        }
+        return;
+    }
+    for (i = first; i < last; i++) {
+        if (extract_files || convert_dir || correct_sectors) {
+            check_file_sectors(ctxt, &ctxt->files[i], *buffer, start);
+        }
+        compact_file(ctxt, &ctxt->files[i], *buffer, start);
+    }
+
+    for (i = first; i < last; i++) {
+        iso_file_t* file = &ctxt->files[i];
+        Uint8* data = &(*buffer)[(file->start - start) * DATA_LENGTH];
+        int known;
+
+        job_done[i - first] = 0;
+
+        /* Length and fast hash are kept in index */
+        if (!ctxt->indexed) {
+            file->length = get_file_length(file, data);
+            file->hash = hash64(data, file->length);
+        }
+        if (file->hashed) {
+            continue;
+        }
+
+        /* Reject by size and fast hash before computing MD5 */
+        known = (extract_src ? 2 : may_be_known(file->file_type, file->length, &file->hash));
+        if (!known) {
+            continue;
+        }
+
+        job_done[i - first] = 1;
+        jobs[num_jobs].data = data;
+        jobs[num_jobs].length = file->length;
+        num_jobs++;
+    }
+
+    /* Check MD5 for known files */
+    md5_batch(jobs, num_jobs);
+
+    num_jobs = 0;
+    for (i = first; i < last; i++) {
+        iso_file_t* file = &ctxt->files[i];
+
+        if (job_done[i - first]) {
+            memcpy(file->digest, jobs[num_jobs++].digest, 16);
+            file->hashed = 1;
+        }
+
+        if (extract_files) {
+            save_found_file(file, &(*buffer)[(file->start - start) * DATA_LENGTH]);
+        }
+        if (convert_dir) {
+            convert_found_file(file, &(*buffer)[(file->start - start) * DATA_LENGTH]);
+        }
+    }
+}
+
+/*
+    Keep only data part of sectors of file, read in buffer from sector first.
+    Data is moved to its place for 2048 bytes sectors, audio sectors of
+    movies are removed.
+*/
+static void compact_file(iso_context_t* ctxt, iso_file_t* file, Uint8* buffer, Uint32 first) {
+    Uint8* dst = &buffer[(file->start - first) * DATA_LENGTH];
+    Uint32 i;
+
+    for (i = file->start - first; i < file->end - first; i++) {
+        Uint8* sector = &buffer[i * ctxt->block_size];
+
+        /* Subheader is checked before sector is overwritten */
+        if ((file->file_type == FILE_STR)
+            && ((get_xa_sector_type(ctxt, sector) & SECTOR_TYPE) == SECTOR_XA)) {
+            continue;
+        }
+
+        memmove(dst, &sector[ctxt->data_offset], DATA_LENGTH);
+        dst += DATA_LENGTH;
+    }
+}
+
+static Uint32 get_file_length(iso_file_t* file, Uint8* data) {
+    Uint32 length = DATA_LENGTH * (file->end - file->start);
+
+    if (file->header_length) {
+        return file->header_length;
+    }
+
+    switch (file->file_type) {
+    case FILE_TIM_4:
+    case FILE_TIM_8:
+    case FILE_TIM_16:
+        length = get_tim_length(data, length);
+        break;
+    case FILE_EMD:
+        length = get_emd_length(data, length);
+        break;
+    case FILE_DO3:
+        /*length = get_emd_length(data, length);*/
+        break;
+    }
+    if (length > DATA_LENGTH * (file->end - file->start)) {
+        length = DATA_LENGTH * (file->end - file->start);
+    }
+
+    return length;
+}
+
+static void save_found_file(iso_file_t* file, Uint8* data) {
+    char filename[16];
+    char* fileext = "%08x.bin";
+    rw_t* dst;
+
+    switch (file->file_type) {
+    case FILE_TIM_4:
+    case FILE_TIM_8:
+    case FILE_TIM_16:
+        fileext = "%08x.tim";
+        break;
+    case FILE_EMD:
+        fileext = "%08x.emd";
+        break;
+    case FILE_DO3:
+        fileext = "%08x.do3";
+        break;
+    case FILE_STR:
+        fileext = "%08x.str";
+        break;
+    }
+    sprintf(filename, fileext, file->start);
+
+    dst = rw_from_file(filename, "wb");
+    if (!dst) {
+        fprintf(stderr, "Can not create %s for writing\n", filename);
+        return;
+    }
+
+    rw_write(dst, data, file->length, 1);
+    rw_close(dst);
+}
+
+/* Files which have a converter are converted in memory, named by sector */
+static void convert_found_file(iso_file_t* file, Uint8* data) {
+    char name[16];
+
+    sprintf(name, "%08x", file->start);
+
+    switch (file->file_type) {
+    case FILE_TIM_4:
+    case FILE_TIM_8:
+    case FILE_TIM_16:
+        convert_file(convert_dir, name, CONVERT_TIM, data, file->length);
+        break;
+    case FILE_EMD:
+        convert_file(convert_dir, name, CONVERT_EMD, data, file->length);
+        break;
+    }
+}
+
+/* Build index of known files of selected game, sorted by MD5 */
+static int md5_index_init(void) {
+    md5_check_t* md5_checks = md5_checks_re3;
+    int i, j, count;
+
+    count = sizeof(md5_checks_re3) / sizeof(md5_check_t);
+    if (extract_version == 2) {
+        count = sizeof(md5_checks_re2) / sizeof(md5_check_t);
+        md5_checks = md5_checks_re2;
+    }
+
+    md5_index = (md5_index_t*) calloc(count + 1, sizeof(md5_index_t));
+    if (!md5_index) {
+        fprintf(stderr, "Can not allocate memory for MD5 index\n");
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < 16; j++) {
+            unsigned int value;
+
+            sscanf(&md5_checks[i].value[j * 2], "%2x", &value);
+            md5_index[i].digest[j] = value;
+        }
+        md5_checks[i].found = 0;
+        md5_index[i].check = &md5_checks[i];
+    }
+    md5_index_count = count;
+
+    qsort(md5_index, md5_index_count, sizeof(md5_index_t), md5_index_compare);
+
+    md5_sizes = (md5_check_t**) calloc(count + 1, sizeof(md5_check_t*));
+    if (!md5_sizes) {
+        fprintf(stderr, "Can not allocate memory for MD5 index\n");
+        free(md5_index);
+        md5_index = NULL;
+        return 0;
+    }
+
+    md5_sizes_count = unknown_tims = unknown_emds = 0;
+    for (i = 0; i < count; i++) {
+        size_t length = strlen(md5_checks[i].filename);
+
+        if (md5_checks[i].size != 0) {
+            md5_sizes[md5_sizes_count++] = &md5_checks[i];
+        } else if ((length > 4) && (strcmp(&md5_checks[i].filename[length - 4], ".emd") == 0)) {
+            ++unknown_emds;
+        } else {
+            ++unknown_tims;
+        }
+    }
+
+    qsort(md5_sizes, md5_sizes_count, sizeof(md5_check_t*), md5_size_compare);
+    return 1;
+}
+
+/* Sort by MD5, then by position in table, so the first entry of a duplicate MD5 is used */
+static int md5_index_compare(const void* a, const void* b) {
+    const md5_index_t* index_a = (const md5_index_t*) a;
+    const md5_index_t* index_b = (const md5_index_t*) b;
+    int result = memcmp(index_a->digest, index_b->digest, 16);
+
+    if (result == 0) {
+        result = (index_a->check > index_b->check) - (index_a->check < index_b->check);
+    }
+    return result;
+}
+
+static md5_check_t* md5_index_find(const md5_byte_t* digest) {
+    int low = 0, high = md5_index_count;
+
+    while (low < high) {
+        int middle = (low + high) >> 1;
+
+        if (memcmp(md5_index[middle].digest, digest, 16) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if ((low < md5_index_count) && (memcmp(md5_index[low].digest, digest, 16) == 0)) {
+        return md5_index[low].check;
+    }
+    return NULL;
+}
+
+/* Sort by length, then by hash, unknown hash first */
+static int md5_size_compare(const void* a, const void* b) {
+    const md5_check_t* check_a = *(md5_check_t* const*) a;
+    const md5_check_t* check_b = *(md5_check_t* const*) b;
+
+    if (check_a->size != check_b->size) {
+        return (check_a->size < check_b->size ? -1 : 1);
+    }
+    return (check_a->hash > check_b->hash) - (check_a->hash < check_b->hash);
+}
+
+/*
+    Tell if a file may be known from its length, and hash if computed.
+    Known files of unknown length only match files of the same kind.
+    Returns 0 if not, 1 if hash is needed to tell, 2 if MD5 is needed.
+*/
+static int may_be_known(int file_type, Uint32 length, const Uint64* hash) {
+    int low = 0, high = md5_sizes_count, i, result = 0;
+
+    switch (file_type) {
+    case FILE_TIM_4:
+    case FILE_TIM_8:
+    case FILE_TIM_16:
+        if (unknown_tims) {
+            result = 2;
+        }
+        break;
+    case FILE_EMD:
+        if (unknown_emds) {
+            result = 2;
+        }
+        break;
+    }
+
+    /* First known file of this length */
+    while (low < high) {
+        int middle = (low + high) >> 1;
+
+        if (md5_sizes[middle]->size < length) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    for (i = low; (i < md5_sizes_count) && (md5_sizes[i]->size == length) && (result < 2); i++) {
+        /* Files of unknown hash, sorted first, match any file of this length */
+        if (md5_sizes[i]->hash == 0) {
+            result = 2;
+        } else if (!hash) {
+            result = 1;
+            break;
+        } else if (md5_sizes[i]->hash == *hash) {
+            result = 2;
+        } else if (md5_sizes[i]->hash > *hash) {
+            break;
+        }
+    }
+
+    for (i = 0; (i < num_dbs) && (result < 2); i++) {
+        int db_result = md5_db_may_match(md5_dbs[i], length, hash);
+
+        if (db_result > result) {
+            result = db_result;
+        }
+    }
+
+    return result;
+}
+
+static void report_file(iso_file_t* file) {
+    int dumped = 0, i;
+    Uint32 start = file->start;
+    md5_check_t* check;
+    const char* found = NULL;
+    const char* game = "";
+
+    /* Known md5 -> known file */
+    check = (file->hashed ? md5_index_find(file->digest) : NULL);
+    if (check) {
+        if (check->found) {
+            dumped = 1;
+        }
+        check->found = 1;
+        found = check->filename;
+    }
+
+    for (i = 0; (i < num_dbs) && !found && file->hashed; i++) {
+        int index = md5_db_find(md5_dbs[i], file->digest);
+
+        if (index >= 0) {
+            if (md5_dbs[i]->found[index]) {
+                dumped = 1;
+            }
+            md5_dbs[i]->found[index] = 1;
+            found = md5_db_path(md5_dbs[i], index);
+            game = md5_db_game(md5_dbs[i], index);
+        }
+    }
+
+    if (!extract_src) {
+        const char* filename = "";
+        const char* already = "";
+        char from_game[64] = "";
+        if (found) {
+            filename = found;
+        } else if (file->iso_file && (file->iso_file->length == file->length)) {
+            filename = file->iso_file->filename;
+        }
+        if (dumped) {
+            already = " already dumped";
+        }
+        if (game[0]) {
+            /* Append game to name of file from catalogue */
+            snprintf(from_game, sizeof(from_game), " (%s)", game);
+        }
+        switch (file->file_type) {
+        case FILE_TIM_4:
+            printf("Sector %d: 4 bits TIM image %s%s%s\n", start, filename, from_game, already);
+            break;
+        case FILE_TIM_8:
+            printf("Sector %d: 8 bits TIM image %s%s%s\n", start, filename, from_game, already);
+            break;
+        case FILE_TIM_16:
+            printf("Sector %d: 16 bits TIM image %s%s%s\n", start, filename, from_game, already);
+            break;
+        case FILE_EMD:
+            printf("Sector %d: EMD file %s%s%s\n", start, filename, from_game, already);
+            break;
+        case FILE_DO3:
+            printf("Sector %d: DO3 file %s%s%s\n", start, filename, from_game, already);
+            break;
+        case FILE_STR:
+            printf("Sector %d: STR movie %s%s%s\n", start, filename, from_game, already);
+            break;
+        }
+    }
+
+    /* Line of table of known files, with length and hash */
+    if (extract_src && file->hashed) {
+        char value[33];
+
+        for (i = 0; i < 16; i++) {
+            sprintf(&value[i * 2], "%02x", file->digest[i]);
+        }
+        fprintf(stderr, "    { \"%s\", \"%s\", 0, %u, 0x%016" PRIx64 "ULL }, /* sector %u */\n", value,
+            (found ? found : ""), file->length, file->hash, start);
+    }
+}
+
+/*
+    Index is saved beside image, all values little endian:
+
+    Header, 48 bytes
+        magic[8]        "REISOIDX"
+        version         INDEX_VERSION
+        block_size
+        image_size      (64 bits)
+        image_mtime     (64 bits)
+        image_hash      hash64() of sampled sectors (64 bits)
+        num_files
+        num_sectors
+
+    Files, 48 bytes each, in sector order
+        start, end, file_type, length, header_length
+        flags           Bit 0: digest is valid
+        hash            (64 bits)
+        digest[16]
+
+    Names of known files are not saved, they are found from digest with
+    current known files and catalogues.
+*/
+
+static char* get_index_filename(const char* filename) {
+    char* index_filename = (char*) malloc(strlen(filename) + 5);
+
+    if (index_filename) {
+        sprintf(index_filename, "%s.idx", filename);
+    }
+    return index_filename;
+}
+
+/* Image is identified by its size, modification time, and some sectors spread over it */
+static void identify_image(iso_context_t* ctxt) {
+    rw_t* src;
+    struct stat st;
+    Uint8* buffer;
+    Uint32 i, sector;
+    int count = 0;
+
+    if (stat(ctxt->filename, &st) == 0) {
+        ctxt->image_mtime = st.st_mtime;
+    }
+
+    buffer = (Uint8*) malloc((INDEX_SAMPLES + 1) * ctxt->block_size);
+    src = rw_from_file(ctxt->filename, "rb");
+    if (buffer && src && (ctxt->num_sectors > 0)) {
+        for (i = 0; i <= INDEX_SAMPLES; i++) {
+            sector = (Uint32) (((Uint64) ctxt->num_sectors - 1) * i / INDEX_SAMPLES);
+
+            rw_seek(src, (Sint64) sector * ctxt->block_size, RW_SEEK_SET);
+            if (rw_read(src, &buffer[count * ctxt->block_size], ctxt->block_size, 1) == 1) {
+                ++count;
+            }
+        }
+        ctxt->image_hash = hash64(buffer, count * ctxt->block_size);
+    }
+
+    if (src) {
+        rw_close(src);
+    }
+    free(buffer);
+}
+
+/* Read files of a previous scan, if index matches image */
+static int load_index(iso_context_t* ctxt) {
+    rw_t* src;
+    char* index_filename;
+    char magic[8];
+    Uint32 num_files, i;
+    int valid;
+
+    index_filename = get_index_filename(ctxt->filename);
+    if (!index_filename) {
+        return 0;
+    }
+    src = rw_from_file(index_filename, "rb");
+    free(index_filename);
+    if (!src) {
+        return 0;
+    }
+
+    valid = (rw_read(src, magic, 8, 1) == 1) && (memcmp(magic, INDEX_MAGIC, 8) == 0);
+    valid = valid && (rw_read_le32(src) == INDEX_VERSION);
+    valid = valid && (rw_read_le32(src) == (Uint32) ctxt->block_size);
+    valid = valid && (rw_read_le64(src) == ctxt->image_size);
+    valid = valid && ((Sint64) rw_read_le64(src) == ctxt->image_mtime);
+    valid = valid && (rw_read_le64(src) == ctxt->image_hash);
+    num_files = rw_read_le32(src);
+    valid = valid && (rw_read_le32(src) == ctxt->num_sectors);
+
+    for (i = 0; (i < num_files) && valid; i++) {
+        Uint32 start, end, file_type, length, header_length, flags;
+        iso_file_t* file;
+
+        start = rw_read_le32(src);
+        end = rw_read_le32(src);
+        file_type = rw_read_le32(src);
+        length = rw_read_le32(src);
+        header_length = rw_read_le32(src);
+        flags = rw_read_le32(src);
+
+        if ((start >= end) || (end > ctxt->num_sectors) || (file_type > FILE_STR)
+            || (length > DATA_LENGTH * (end - start))) {
+            valid = 0;
+            break;
+        }
+
+        add_file(ctxt, start, end, file_type, header_length);
+        if (ctxt->num_files != (int) i + 1) {
+            valid = 0;
+            break;
+        }
+        file = &ctxt->files[i];
+        file->length = length;
+        file->hash = rw_read_le64(src);
+        file->hashed = flags & 1;
+        if (rw_read(src, file->digest, 16, 1) != 1) {
+            valid = 0;
+        }
+    }
+
+    rw_close(src);
+
+    if (!valid) {
+        free(ctxt->files);
+        ctxt->files = NULL;
+        ctxt->num_files = 0;
+        return 0;
+    }
+
+    ctxt->indexed = 1;
+    return 1;
+}
+
+static void save_index(iso_context_t* ctxt) {
+    rw_t* dst;
+    char* index_filename;
+    int i, retval;
+
+    index_filename = get_index_filename(ctxt->filename);
+    if (!index_filename) {
+        return;
+    }
+    dst = rw_from_file(index_filename, "wb");
+    if (!dst) {
+        fprintf(stderr, "Can not create %s for writing\n", index_filename);
+        free(index_filename);
+        return;
+    }
+
+    rw_write(dst, INDEX_MAGIC, 8, 1);
+    rw_write_le32(dst, INDEX_VERSION);
+    rw_write_le32(dst, ctxt->block_size);
+    rw_write_le64(dst, ctxt->image_size);
+    rw_write_le64(dst, ctxt->image_mtime);
+    rw_write_le64(dst, ctxt->image_hash);
+    rw_write_le32(dst, ctxt->num_files);
+    retval = rw_write_le32(dst, ctxt->num_sectors);
+
+    for (i = 0; (i < ctxt->num_files) && retval; i++) {
+        iso_file_t* file = &ctxt->files[i];
+
+        rw_write_le32(dst, file->start);
+        rw_write_le32(dst, file->end);
+        rw_write_le32(dst, file->file_type);
+        rw_write_le32(dst, file->length);
+        rw_write_le32(dst, file->header_length);
+        rw_write_le32(dst, file->hashed ? 1 : 0);
+        rw_write_le64(dst, file->hash);
+        retval = rw_write(dst, file->digest, 16, 1);
+    }
+
+    rw_close(dst);
+
+    /* A partial index would not match image, remove it */
+    if (!retval) {
+        fprintf(stderr, "Can not write %s\n", index_filename);
+        remove(index_filename);
+    }
+    free(index_filename);
+}
+
+/* Name of file from known files, catalogues or filesystem, NULL if unknown */
+static const char* get_known_name(iso_file_t* file) {
+    md5_check_t* check;
+    int i;
+
+    check = (file->hashed ? md5_index_find(file->digest) : NULL);
+    if (check) {
+        return check->filename;
+    }
+
+    for (i = 0; (i < num_dbs) && file->hashed; i++) {
+        int index = md5_db_find(md5_dbs[i], file->digest);
+
+        if (index >= 0) {
+            return md5_db_path(md5_dbs[i], index);
+        }
+    }
+
+    if (file->iso_file && (file->iso_file->length == file->length)) {
+        return file->iso_file->filename;
+    }
+    return NULL;
+}
+
+/* Extract file containing given sector, or known file with given path */
+static int extract_single_file(iso_context_t* ctxt, const char* name) {
+    rw_t* src;
+    iso_file_t* file = NULL;
+    Uint8* buffer;
+    Uint32 size, i;
+    int by_sector;
+
+    by_sector = (name[0] != '\0') && (strspn(name, "0123456789") == strlen(name));
+
+    for (i = 0; (i < (Uint32) ctxt->num_files) && !file; i++) {
+        if (by_sector) {
+            Uint32 sector = strtoul(name, NULL, 10);
+
+            if ((sector >= ctxt->files[i].start) && (sector < ctxt->files[i].end)) {
+                file = &ctxt->files[i];
+            }
+        } else {
+            const char* known = get_known_name(&ctxt->files[i]);
+
+#ifdef WIN32
+            if (known && (_stricmp(known, name) == 0)) {
+                file = &ctxt->files[i];
+            }
+#else
+            if (known && (strcasecmp(known, name) == 0)) {
+                file = &ctxt->files[i];
+            }
+#endif
+        }
+    }
+
+    if (!file) {
+        fprintf(stderr, "%s: file not found\n", name);
+        return 1;
+    }
+
+    /* Sectors of file are read at once */
+    size = ctxt->block_size * (file->end - file->start);
+    buffer = (Uint8*) malloc(size);
+    if (!buffer) {
+        fprintf(stderr, "Can not allocate %d bytes for file\n", size);
+        return 1;
+    }
+
+    src = rw_from_file(ctxt->filename, "rb");
+    if (!src) {
+        fprintf(stderr, "Can not open %s for reading\n", ctxt->filename);
+        free(buffer);
+        return 1;
+    }
+    rw_seek(src, (Sint64) file->start * ctxt->block_size, RW_SEEK_SET);
+    if (rw_read(src, buffer, size, 1) != 1) {
+        fprintf(stderr, "Block %d: can not read\n", file->start);
+        rw_close(src);
+        free(buffer);
+        return 1;
+    }
+    rw_close(src);
+
+    check_file_sectors(ctxt, file, buffer, file->start);
+    compact_file(ctxt, file, buffer, file->start);
+
+    report_file(file);
+    save_found_file(file, buffer);
+
+    free(buffer);
+    return 0;
+}
+
+/* Check EDC of all sectors, and report ranges of bad ones */
+static int verify_sectors(iso_context_t* ctxt) {
+    thread_t* threads[MAX_THREADS];
+    Uint32 i, j, count[4];
+    int num_threads;
+
+    if (ctxt->block_size == 2048) {
+        printf("No EDC in 2048 bytes sectors, nothing to verify\n");
+        return 0;
+    }
+
+    /* Status of each sector */
+    ctxt->sectors = (Uint8*) calloc(ctxt->num_sectors + 1, 1);
+    if (!ctxt->sectors) {
+        fprintf(stderr, "Can not allocate memory to verify image\n");
+        return 1;
+    }
+
+    num_threads = start_threads(ctxt, check_sectors, threads);
+    wait_threads(threads, num_threads);
+
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < ctxt->num_sectors; i = j) {
+        int status = ctxt->sectors[i];
+
+        for (j = i + 1; (j < ctxt->num_sectors) && (ctxt->sectors[j] == status); j++) {
+        }
+        count[status] += j - i;
+
+        if ((status != EDC_BAD) && (status != EDC_FIXED)) {
+            continue;
+        }
+        if (j - i > 1) {
+            printf("Sectors %d-%d: ", i, j - 1);
+        } else {
+            printf("Sector %d: ", i);
+        }
+        printf("%s\n", (status == EDC_FIXED ? "bad EDC, corrected with ECC" : "bad EDC"));
+    }
+
+    printf("%d sectors: %d good, %d without EDC, %d bad", ctxt->num_sectors, count[EDC_OK],
+        count[EDC_NONE], count[EDC_BAD] + count[EDC_FIXED]);
+    if (correct_sectors) {
+        printf(", %d corrected with ECC", count[EDC_FIXED]);
+    }
+    printf("\n");
+
+    free(ctxt->sectors);
+    ctxt->sectors = NULL;
+    return (count[EDC_BAD] > 0);
+}
+
+/* Threads check EDC of ranges of sectors */
+static int check_sectors(void* data) {
+    iso_context_t* ctxt = (iso_context_t*) data;
+    rw_t* src;
+    Uint8* buffer;
+    Uint32 first, last, i, j, count;
+
+    src = rw_from_file(ctxt->filename, "rb");
+    if (!src) {
+        fprintf(stderr, "Can not open %s for reading\n", ctxt->filename);
+        return 1;
+    }
+
+    buffer = (Uint8*) malloc(CHUNK_SECTORS * ctxt->block_size);
+    if (!buffer) {
+        fprintf(stderr, "Can not allocate memory to read image\n");
+        rw_close(src);
+        return 1;
+    }
+
+    while (next_sector_range(ctxt, &first, &last)) {
+        for (i = first; i < last; i += count) {
+            count = last - i;
+            if (count > CHUNK_SECTORS) {
+                count = CHUNK_SECTORS;
+            }
+
+            /* Sectors which can not be read are bad */
+            rw_seek(src, (Sint64) i * ctxt->block_size, RW_SEEK_SET);
+            if (rw_read(src, buffer, count * ctxt->block_size, 1) != 1) {
+                memset(&ctxt->sectors[i], EDC_BAD, count);
+                continue;
+            }
+
+            for (j = 0; j < count; j++) {
+                Uint8* sector = &buffer[j * ctxt->block_size];
+                int status = edc_ecc_check(sector, ctxt->block_size);
+
+                if ((status == EDC_BAD) && correct_sectors) {
+                    status = edc_ecc_correct(sector, ctxt->block_size);
+                }
+                ctxt->sectors[i + j] = status;
+            }
+        }
+    }
+
+    free(buffer);
+    rw_close(src);
+    return 0;
+}
+
+/* Check EDC of sectors of file read in buffer from sector first, before keeping data */
+static void check_file_sectors(iso_context_t* ctxt, iso_file_t* file, Uint8* buffer, Uint32 first) {
+    Uint32 i;
+    int bad = 0, fixed = 0;
+
+    if (ctxt->block_size == 2048) {
+        return;
+    }
+
+    for (i = file->start; i < file->end; i++) {
+        Uint8* sector = &buffer[(i - first) * ctxt->block_size];
+        int status = edc_ecc_check(sector, ctxt->block_size);
+
+        if ((status == EDC_BAD) && correct_sectors) {
+            status = edc_ecc_correct(sector, ctxt->block_size);
+        }
+        if (status == EDC_BAD) {
+            ++bad;
+        } else if (status == EDC_FIXED) {
+            ++fixed;
+        }
+    }
+
+    if (fixed) {
+        fprintf(stderr, "Block %d: %d sectors corrected with ECC\n", file->start, fixed);
+    }
+    if (bad) {
+        fprintf(stderr, "Block %d: %d sectors with bad EDC, file may be corrupted\n", file->start,
+            bad);
+    }
+}
+
+static Uint32 get_tim_length(Uint8* buffer, Uint32 buflen) {
+    tim_header_t* tim_header = (tim_header_t*) buffer;
+    tim_size_t* tim_size;
+    Uint32 w, h, img_offset;
+
+    /* Image block must start in file */
+    img_offset = rw_swap_le32(tim_header->offset);
+    if (img_offset > buflen - 20) {
+        return buflen;
+    }
+    img_offset += 20;
 
     tim_size = (tim_size_t*) (&((Uint8*) buffer)[img_offset - 4]);
-    w = SDL_SwapLE16(tim_size->width);
-    h = SDL_SwapLE16(tim_size->height);
+    w = rw_swap_le16(tim_size->width);
+    h = rw_swap_le16(tim_size->height);
 
     return img_offset + (w * h * 2);
 }
 
-Uint32 get_emd_length(Uint8* buffer, Uint32 buflen) {
+static Uint32 get_emd_length(Uint8* buffer, Uint32 buflen) {
     Uint32* emd_header = (Uint32*) buffer;
-    Uint32 dir_offset = SDL_SwapLE32(emd_header[0]);
+    Uint32 dir_offset = rw_swap_le32(emd_header[0]);
 
     return dir_offset + 4 * 15;
 }
@@ -0,0 +1,326 @@
+/*
+    Compute MD5 of many buffers at once
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#include "rw.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    include <emmintrin.h>
+#    define HAVE_MD5_SSE2 1
+#endif
+
+/* AVX2 code is compiled for its own function only, and used if CPU has it */
+#if defined(HAVE_MD5_SSE2) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    include <immintrin.h>
+#    define HAVE_MD5_AVX2 1
+#endif
+
+#include "md5.h"
+#include "md5_batch.h"
+
+/*--- Defines ---*/
+
+#define MAX_LANES 8
+
+/*--- Types ---*/
+
+typedef struct {
+    md5_batch_job_t* job; /* NULL if lane unused */
+    Uint32 block;
+    Uint32 num_blocks;
+    Uint32 full_blocks; /* Blocks read directly from job data */
+    Uint8 tail[128];    /* Last bytes of data, with padding and length */
+} md5_lane_t;
+
+typedef void (*md5_blocks_f)(Uint32 state[4][MAX_LANES], const Uint8* blocks[MAX_LANES]);
+
+/*--- Constants ---*/
+
+#ifdef HAVE_MD5_SSE2
+static const Uint32 md5_k[64] = { 0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf,
+    0x4787c62a, 0xa8304613, 0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122,
+    0xfd987193, 0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d,
+    0x02441453, 0xd8a1e681, 0xe7d3fbc8, 0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905,
+    0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44,
+    0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039,
+    0xe6db99e5, 0x1fa27cf8, 0xc4ac5665, 0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3,
+    0x8f0ccc92, 0xffeff47d, 0x85845dd1, 0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82,
+    0xbd3af235, 0x2ad7d2bb, 0xeb86d391 };
+
+/* Rotation of each step */
+static const int md5_s[64] = { 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 5, 9,
+    14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    4, 11, 16, 23, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21 };
+
+/* Message word used by each step */
+static const int md5_g[64] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 1, 6, 11, 0,
+    5, 10, 15, 4, 9, 14, 3, 8, 13, 2, 7, 12, 5, 8, 11, 14, 1, 4, 7, 10, 13, 0, 3, 6, 9, 12, 15, 2,
+    0, 7, 14, 5, 12, 3, 10, 1, 8, 15, 6, 13, 4, 11, 2, 9 };
+
+static const Uint8 md5_zero_block[64] = { 0 };
+#endif
+
+/*--- Functions prototypes ---*/
+
+static void md5_scalar(md5_batch_job_t* jobs, int count);
+
+#ifdef HAVE_MD5_SSE2
+static void md5_lanes(md5_batch_job_t* jobs, int count, int lanes, md5_blocks_f blocks_f);
+static void md5_lane_start(md5_lane_t* lane, md5_batch_job_t* job);
+static Uint32 md5_read32(const Uint8* src);
+
+static void md5_blocks_sse2(Uint32 state[4][MAX_LANES], const Uint8* blocks[MAX_LANES]);
+#endif
+#ifdef HAVE_MD5_AVX2
+static void md5_blocks_avx2(Uint32 state[4][MAX_LANES], const Uint8* blocks[MAX_LANES])
+    __attribute__((target("avx2")));
+#endif
+
+/*--- Functions ---*/
+
+void md5_batch(md5_batch_job_t* jobs, int count) {
+    if (count < 2) {
+        md5_scalar(jobs, count);
+        return;
+    }
+
+#ifdef HAVE_MD5_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        md5_lanes(jobs, count, 8, md5_blocks_avx2);
+        return;
+    }
+#endif
+#ifdef HAVE_MD5_SSE2
+    md5_lanes(jobs, count, 4, md5_blocks_sse2);
+#else
+    md5_scalar(jobs, count);
+#endif
+}
+
+static void md5_scalar(md5_batch_job_t* jobs, int count) {
+    md5_state_t state;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        md5_init(&state);
+        md5_append(&state, (const md5_byte_t*) jobs[i].data, jobs[i].length);
+        md5_finish(&state, jobs[i].digest);
+    }
+}
+
+#ifdef HAVE_MD5_SSE2
+
+/* Each lane hashes one job, and takes the next one when done */
+static void md5_lanes(md5_batch_job_t* jobs, int count, int lanes, md5_blocks_f blocks_f) {
+    md5_lane_t lane[MAX_LANES];
+    Uint32 state[4][MAX_LANES];
+    const Uint8* blocks[MAX_LANES];
+    int next_job = 0, active, i, j;
+
+    memset(lane, 0, sizeof(lane));
+
+    for (;;) {
+        active = 0;
+        for (i = 0; i < lanes; i++) {
+            md5_lane_t* l = &lane[i];
+
+            if (!l->job && (next_job < count)) {
+                md5_lane_start(l, &jobs[next_job++]);
+                state[0][i] = 0x67452301;
+                state[1][i] = 0xefcdab89;
+                state[2][i] = 0x98badcfe;
+                state[3][i] = 0x10325476;
+            }
+
+            blocks[i] = md5_zero_block;
+            if (l->job) {
+                if (l->block < l->full_blocks) {
+                    blocks[i] = &l->job->data[l->block << 6];
+                } else {
+                    blocks[i] = &l->tail[(l->block - l->full_blocks) << 6];
+                }
+                ++active;
+            }
+        }
+
+        if (!active) {
+            break;
+        }
+
+        blocks_f(state, blocks);
+
+        for (i = 0; i < lanes; i++) {
+            md5_lane_t* l = &lane[i];
+
+            if (!l->job || (++l->block < l->num_blocks)) {
+                continue;
+            }
+            for (j = 0; j < 16; j++) {
+                l->job->digest[j] = state[j >> 2][i] >> ((j & 3) << 3);
+            }
+            l->job = NULL;
+        }
+    }
+}
+
+static void md5_lane_start(md5_lane_t* lane, md5_batch_job_t* job) {
+    Uint32 remain = job->length & 63;
+    Uint32 tail_blocks = (remain + 9 > 64 ? 2 : 1);
+    Uint32 bits_lo = job->length << 3, bits_hi = job->length >> 29;
+    Uint8* length_pos;
+    int i;
+
+    lane->job = job;
+    lane->block = 0;
+    lane->full_blocks = job->length >> 6;
+    lane->num_blocks = lane->full_blocks + tail_blocks;
+
+    memset(lane->tail, 0, sizeof(lane->tail));
+    if (remain) {
+        memcpy(lane->tail, &job->data[lane->full_blocks << 6], remain);
+    }
+    lane->tail[remain] = 0x80;
+
+    length_pos = &lane->tail[(tail_blocks << 6) - 8];
+    for (i = 0; i < 4; i++) {
+        length_pos[i] = bits_lo >> (i << 3);
+        length_pos[4 + i] = bits_hi >> (i << 3);
+    }
+}
+
+static Uint32 md5_read32(const Uint8* src) {
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((Uint32) src[3] << 24);
+}
+
+static void md5_blocks_sse2(Uint32 state[4][MAX_LANES], const Uint8* blocks[MAX_LANES]) {
+    __m128i w[16], a, b, c, d, f, t;
+    __m128i ones = _mm_set1_epi32(-1);
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = _mm_set_epi32(md5_read32(&blocks[3][i << 2]), md5_read32(&blocks[2][i << 2]),
+            md5_read32(&blocks[1][i << 2]), md5_read32(&blocks[0][i << 2]));
+    }
+
+    a = _mm_loadu_si128((const __m128i*) state[0]);
+    b = _mm_loadu_si128((const __m128i*) state[1]);
+    c = _mm_loadu_si128((const __m128i*) state[2]);
+    d = _mm_loadu_si128((const __m128i*) state[3]);
+
+    for (i = 0; i < 64; i++) {
+        switch (i >> 4) {
+        case 0:
+            f = _mm_or_si128(_mm_and_si128(b, c), _mm_andnot_si128(b, d));
+            break;
+        case 1:
+            f = _mm_or_si128(_mm_and_si128(d, b), _mm_andnot_si128(d, c));
+            break;
+        case 2:
+            f = _mm_xor_si128(_mm_xor_si128(b, c), d);
+            break;
+        default:
+            f = _mm_xor_si128(c, _mm_or_si128(b, _mm_xor_si128(d, ones)));
+            break;
+        }
+
+        t = _mm_add_epi32(_mm_add_epi32(a, f), _mm_add_epi32(_mm_set1_epi32(md5_k[i]), w[md5_g[i]]));
+        t = _mm_or_si128(_mm_sll_epi32(t, _mm_cvtsi32_si128(md5_s[i])),
+            _mm_srl_epi32(t, _mm_cvtsi32_si128(32 - md5_s[i])));
+
+        a = d;
+        d = c;
+        c = b;
+        b = _mm_add_epi32(b, t);
+    }
+
+    _mm_storeu_si128((__m128i*) state[0],
+        _mm_add_epi32(a, _mm_loadu_si128((const __m128i*) state[0])));
+    _mm_storeu_si128((__m128i*) state[1],
+        _mm_add_epi32(b, _mm_loadu_si128((const __m128i*) state[1])));
+    _mm_storeu_si128((__m128i*) state[2],
+        _mm_add_epi32(c, _mm_loadu_si128((const __m128i*) state[2])));
+    _mm_storeu_si128((__m128i*) state[3],
+        _mm_add_epi32(d, _mm_loadu_si128((const __m128i*) state[3])));
+}
+
+#endif /* HAVE_MD5_SSE2 */
+
+#ifdef HAVE_MD5_AVX2
+
+static void md5_blocks_avx2(Uint32 state[4][MAX_LANES], const Uint8* blocks[MAX_LANES]) {
+    __m256i w[16], a, b, c, d, f, t;
+    __m256i ones = _mm256_set1_epi32(-1);
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = _mm256_set_epi32(md5_read32(&blocks[7][i << 2]), md5_read32(&blocks[6][i << 2]),
+            md5_read32(&blocks[5][i << 2]), md5_read32(&blocks[4][i << 2]),
+            md5_read32(&blocks[3][i << 2]), md5_read32(&blocks[2][i << 2]),
+            md5_read32(&blocks[1][i << 2]), md5_read32(&blocks[0][i << 2]));
+    }
+
+    a = _mm256_loadu_si256((const __m256i*) state[0]);
+    b = _mm256_loadu_si256((const __m256i*) state[1]);
+    c = _mm256_loadu_si256((const __m256i*) state[2]);
+    d = _mm256_loadu_si256((const __m256i*) state[3]);
+
+    for (i = 0; i < 64; i++) {
+        switch (i >> 4) {
+        case 0:
+            f = _mm256_or_si256(_mm256_and_si256(b, c), _mm256_andnot_si256(b, d));
+            break;
+        case 1:
+            f = _mm256_or_si256(_mm256_and_si256(d, b), _mm256_andnot_si256(d, c));
+            break;
+        case 2:
+            f = _mm256_xor_si256(_mm256_xor_si256(b, c), d);
+            break;
+        default:
+            f = _mm256_xor_si256(c, _mm256_or_si256(b, _mm256_xor_si256(d, ones)));
+            break;
+        }
+
+        t = _mm256_add_epi32(
+            _mm256_add_epi32(a, f), _mm256_add_epi32(_mm256_set1_epi32(md5_k[i]), w[md5_g[i]]));
+        t = _mm256_or_si256(_mm256_sll_epi32(t, _mm_cvtsi32_si128(md5_s[i])),
+            _mm256_srl_epi32(t, _mm_cvtsi32_si128(32 - md5_s[i])));
+
+        a = d;
+        d = c;
+        c = b;
+        b = _mm256_add_epi32(b, t);
+    }
+
+    _mm256_storeu_si256((__m256i*) state[0],
+        _mm256_add_epi32(a, _mm256_loadu_si256((const __m256i*) state[0])));
+    _mm256_storeu_si256((__m256i*) state[1],
+        _mm256_add_epi32(b, _mm256_loadu_si256((const __m256i*) state[1])));
+    _mm256_storeu_si256((__m256i*) state[2],
+        _mm256_add_epi32(c, _mm256_loadu_si256((const __m256i*) state[2])));
+    _mm256_storeu_si256((__m256i*) state[3],
+        _mm256_add_epi32(d, _mm256_loadu_si256((const __m256i*) state[3])));
+}
+
+#endif /* HAVE_MD5_AVX2 */
@@ -0,0 +1,43 @@
+/*
+    Compute MD5 of many buffers at once
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MD5_BATCH_H
+#define MD5_BATCH_H
+
+/*--- Types ---*/
+
+typedef struct {
+    const Uint8* data;
+    Uint32 length;
+    Uint8 digest[16]; /* Filled by md5_batch() */
+} md5_batch_job_t;
+
+/*--- Functions ---*/
+
+/*
+    Compute MD5 of each job. Buffers are hashed in parallel, 4 at a time
+    with SSE2 or 8 at a time with AVX2, one at a time otherwise.
+
+    jobs		Buffers to hash
+    count		Number of jobs
+*/
+void md5_batch(md5_batch_job_t* jobs, int count);
+
+#endif /* MD5_BATCH_H */
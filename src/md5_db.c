@@ -0,0 +1,294 @@
+/*
+    Known files catalogue, indexed by MD5
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#    include <fcntl.h>
+#    include <unistd.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    define USE_MMAP 1
+#endif
+
+#include "rw.h"
+
+#include "md5_db.h"
+
+/*--- Functions prototypes ---*/
+
+static int md5_db_load(md5_db_t* db, const char* filename);
+static int md5_db_check(md5_db_t* db);
+
+/*--- Functions ---*/
+
+md5_db_t* md5_db_open(const char* filename) {
+    md5_db_t* db;
+
+    db = (md5_db_t*) calloc(1, sizeof(md5_db_t));
+    if (!db) {
+        fprintf(stderr, "Can not allocate memory for catalogue\n");
+        return NULL;
+    }
+
+    if (!md5_db_load(db, filename)) {
+        md5_db_close(db);
+        return NULL;
+    }
+
+    if (!md5_db_check(db)) {
+        fprintf(stderr, "%s: not a valid catalogue\n", filename);
+        md5_db_close(db);
+        return NULL;
+    }
+
+    /* Pages are only touched for entries which are found */
+    db->found = (Uint8*) calloc(db->num_entries + 1, 1);
+    if (!db->found) {
+        fprintf(stderr, "Can not allocate memory for catalogue\n");
+        md5_db_close(db);
+        return NULL;
+    }
+
+    return db;
+}
+
+static int md5_db_load(md5_db_t* db, const char* filename) {
+    rw_t* src;
+    Sint64 length;
+
+#ifdef USE_MMAP
+    {
+        struct stat st;
+        int fd = open(filename, O_RDONLY);
+
+        if (fd >= 0) {
+            if ((fstat(fd, &st) == 0) && (st.st_size > 0) && (st.st_size <= (off_t) 0xffffffffUL)) {
+                void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+                if (data != MAP_FAILED) {
+                    close(fd);
+                    db->data = (Uint8*) data;
+                    db->length = st.st_size;
+                    db->mapped = 1;
+                    return 1;
+                }
+            }
+            close(fd);
+        }
+    }
+#endif
+
+    /* Read whole file in memory */
+    src = rw_from_file(filename, "rb");
+    if (!src) {
+        fprintf(stderr, "Can not open %s for reading\n", filename);
+        return 0;
+    }
+
+    rw_seek(src, 0, RW_SEEK_END);
+    length = rw_tell(src);
+    rw_seek(src, 0, RW_SEEK_SET);
+
+    if ((length <= 0) || (length > (Sint64) 0xffffffffUL)) {
+        fprintf(stderr, "%s: not a valid catalogue\n", filename);
+        rw_close(src);
+        return 0;
+    }
+
+    db->data = (Uint8*) malloc(length);
+    if (!db->data) {
+        fprintf(stderr, "Can not allocate %" PRId64 " bytes in memory\n", length);
+        rw_close(src);
+        return 0;
+    }
+    db->length = length;
+
+    if (rw_read(src, db->data, length, 1) != 1) {
+        fprintf(stderr, "Can not read %s\n", filename);
+        rw_close(src);
+        return 0;
+    }
+
+    rw_close(src);
+    return 1;
+}
+
+/* Only check the header, entries are not parsed */
+static int md5_db_check(md5_db_t* db) {
+    Uint32* header = (Uint32*) db->data;
+    Uint32 num_entries, entries_offset, strings_offset, strings_length, sizes_offset;
+
+    if (db->length < MD5_DB_HEADER_SIZE) {
+        return 0;
+    }
+    if (memcmp(db->data, MD5_DB_MAGIC, 8) != 0) {
+        return 0;
+    }
+    if (rw_swap_le32(header[2]) != MD5_DB_VERSION) {
+        return 0;
+    }
+
+    num_entries = rw_swap_le32(header[3]);
+    entries_offset = rw_swap_le32(header[4]);
+    strings_offset = rw_swap_le32(header[5]);
+    strings_length = rw_swap_le32(header[6]);
+    sizes_offset = rw_swap_le32(header[7]);
+
+    if ((entries_offset & 7) || (entries_offset > db->length)) {
+        return 0;
+    }
+    if (num_entries > (db->length - entries_offset) / MD5_DB_ENTRY_SIZE) {
+        return 0;
+    }
+    if ((sizes_offset & 7) || (sizes_offset > db->length)) {
+        return 0;
+    }
+    if (num_entries > (db->length - sizes_offset) / MD5_DB_SIZE_SIZE) {
+        return 0;
+    }
+    if ((strings_length == 0) || (strings_offset > db->length)
+        || (strings_length > db->length - strings_offset)) {
+        return 0;
+    }
+    /* Any offset in the table then gives a terminated string */
+    if (db->data[strings_offset + strings_length - 1] != 0) {
+        return 0;
+    }
+
+    db->entries = (const md5_db_entry_t*) &db->data[entries_offset];
+    db->num_entries = num_entries;
+    db->sizes = (const md5_db_size_t*) &db->data[sizes_offset];
+    db->strings = (const char*) &db->data[strings_offset];
+    db->strings_length = strings_length;
+    return 1;
+}
+
+int md5_db_find(md5_db_t* db, const Uint8* digest) {
+    Uint32 low = 0, high = db->num_entries;
+
+    while (low < high) {
+        Uint32 middle = (low + high) >> 1;
+
+        if (memcmp(db->entries[middle].digest, digest, 16) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if ((low < db->num_entries) && (memcmp(db->entries[low].digest, digest, 16) == 0)) {
+        return low;
+    }
+    return -1;
+}
+
+int md5_db_may_match(md5_db_t* db, Uint32 size, const Uint64* hash) {
+    Uint32 low = 0, high = db->num_entries;
+
+    if (db->num_entries == 0) {
+        return 0;
+    }
+    /* Entries of unknown size, sorted first, match anything */
+    if (rw_swap_le32(db->sizes[0].size) == 0) {
+        return 2;
+    }
+
+    /* First entry of this size */
+    while (low < high) {
+        Uint32 middle = (low + high) >> 1;
+
+        if (rw_swap_le32(db->sizes[middle].size) < size) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    for (; (low < db->num_entries) && (rw_swap_le32(db->sizes[low].size) == size); low++) {
+        Uint64 entry_hash = rw_swap_le64(db->sizes[low].hash);
+
+        /* Entries of unknown hash, sorted first, match any file of this size */
+        if (entry_hash == 0) {
+            return 2;
+        }
+        if (!hash) {
+            return 1;
+        }
+        if (entry_hash == *hash) {
+            return 2;
+        }
+        if (entry_hash > *hash) {
+            break;
+        }
+    }
+    return 0;
+}
+
+Uint32 md5_db_size(md5_db_t* db, int index) {
+    return rw_swap_le32(db->entries[index].size);
+}
+
+Uint64 md5_db_hash(md5_db_t* db, int index) {
+    return rw_swap_le64(db->entries[index].hash);
+}
+
+const char* md5_db_path(md5_db_t* db, int index) {
+    Uint32 offset = rw_swap_le32(db->entries[index].path);
+
+    if (offset >= db->strings_length) {
+        return "";
+    }
+    return &db->strings[offset];
+}
+
+const char* md5_db_game(md5_db_t* db, int index) {
+    Uint32 offset = rw_swap_le32(db->entries[index].game);
+
+    if (offset >= db->strings_length) {
+        return "";
+    }
+    return &db->strings[offset];
+}
+
+void md5_db_close(md5_db_t* db) {
+    if (!db) {
+        return;
+    }
+
+    if (db->data) {
+#ifdef USE_MMAP
+        if (db->mapped) {
+            munmap(db->data, db->length);
+        } else
+#endif
+        {
+            free(db->data);
+        }
+    }
+    free(db->found);
+    free(db);
+}
@@ -0,0 +1,136 @@
+/*
+    Known files catalogue, indexed by MD5
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef MD5_DB_H
+#define MD5_DB_H
+
+/*
+    File layout, all values little endian:
+
+    Header, 32 bytes
+        magic[8]        "REMD5DB\0"
+        version         MD5_DB_VERSION
+        num_entries
+        entries_offset  Offset of first entry, in file
+        strings_offset  Offset of strings table, in file
+        strings_length  Length of strings table, last byte is 0
+        sizes_offset    Offset of sizes table, in file
+
+    Entries, 40 bytes each, sorted by digest
+        digest[16]
+        hash            hash64() of file, 0 if unknown (64 bits)
+        size            Length of file, 0 if unknown
+        path            Offset of path in strings table
+        game            Offset of game/region in strings table
+        reserved
+
+    Sizes, 16 bytes each, one per entry, sorted by size then hash
+        size
+        reserved
+        hash            (64 bits)
+
+    Strings table, NUL terminated strings
+*/
+
+/*--- Defines ---*/
+
+#define MD5_DB_MAGIC   "REMD5DB"
+#define MD5_DB_VERSION 2
+
+#define MD5_DB_HEADER_SIZE 32
+#define MD5_DB_ENTRY_SIZE  40
+#define MD5_DB_SIZE_SIZE   16
+
+/*--- Types ---*/
+
+typedef struct {
+    Uint8 digest[16];
+    Uint64 hash;
+    Uint32 size;
+    Uint32 path;
+    Uint32 game;
+    Uint32 reserved;
+} md5_db_entry_t;
+
+typedef struct {
+    Uint32 size;
+    Uint32 reserved;
+    Uint64 hash;
+} md5_db_size_t;
+
+typedef struct {
+    Uint8* data; /* Whole file */
+    Uint32 length;
+    int mapped; /* data is mapped, not allocated */
+    const md5_db_entry_t* entries;
+    Uint32 num_entries;
+    const md5_db_size_t* sizes;
+    const char* strings;
+    Uint32 strings_length;
+    Uint8* found; /* Entries already reported */
+} md5_db_t;
+
+/*--- Functions ---*/
+
+/*
+    Open a catalogue, mapped in memory when possible
+
+    filename	Catalogue to open
+    Returns NULL if failed
+*/
+md5_db_t* md5_db_open(const char* filename);
+
+/*
+    Find first entry with given digest
+
+    db		Catalogue
+    digest	MD5 to look for
+    Returns index of entry, -1 if not found
+*/
+int md5_db_find(md5_db_t* db, const Uint8* digest);
+
+/*
+    Check if a file may be in catalogue, before computing its MD5
+
+    db		Catalogue
+    size	Length of file
+    hash	hash64() of file, NULL if not computed yet
+    Returns 0 if no entry can match, 1 if hash is needed to tell,
+    2 if MD5 is needed to tell
+*/
+int md5_db_may_match(md5_db_t* db, Uint32 size, const Uint64* hash);
+
+/*
+    Access fields of an entry
+
+    db		Catalogue
+    index	Index of entry, from 0 to db->num_entries-1
+*/
+Uint32 md5_db_size(md5_db_t* db, int index);
+Uint64 md5_db_hash(md5_db_t* db, int index);
+const char* md5_db_path(md5_db_t* db, int index);
+const char* md5_db_game(md5_db_t* db, int index);
+
+/*
+    Close catalogue
+*/
+void md5_db_close(md5_db_t* db);
+
+#endif /* MD5_DB_H */
@@ -0,0 +1,423 @@
+/*
+    Build a known files catalogue for iso_search, from a text listing
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#include "rw.h"
+
+#include "md5_db.h"
+#include "file_functions.h"
+#include "param.h"
+#include "applets.h"
+
+/*--- Types ---*/
+
+typedef struct {
+    Uint8 digest[16];
+    Uint64 hash;
+    Uint32 size;
+    Uint32 path;
+    Uint32 game;
+    int line; /* Keep order of listing for same digest */
+} db_entry_t;
+
+/*--- Variables ---*/
+
+static db_entry_t* entries = NULL;
+static int num_entries = 0;
+static int max_entries = 0;
+
+static char* strings = NULL;
+static Uint32 strings_length = 0;
+static Uint32 max_strings = 0;
+
+/* Offsets of game names already in strings table */
+static Uint32* games = NULL;
+static int num_games = 0;
+
+/*--- Functions prototypes ---*/
+
+static int list_db(const char* filename);
+
+static int read_listing(const char* filename);
+static int parse_line(char* line, int num_line);
+static int add_string(const char* str, Uint32* offset);
+static int add_game(const char* game, Uint32* offset);
+static int entry_compare(const void* a, const void* b);
+static int size_compare(const void* a, const void* b);
+static int write_db(const char* filename);
+
+/*--- Functions ---*/
+
+#ifndef MULTICALL
+int main(int argc, char** argv) {
+    return md5db_main(argc, argv);
+}
+#endif
+
+int md5db_main(int argc, char** argv) {
+    int retval = 1, i;
+    char* dst_filename = NULL;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s [-l] [-o output.db] /path/to/listing.txt\n", argv[0]);
+        return 1;
+    }
+
+    entries = NULL;
+    num_entries = max_entries = 0;
+    strings = NULL;
+    strings_length = max_strings = 0;
+    games = NULL;
+    num_games = 0;
+
+    if (param_check("-l", argc, argv) >= 0) {
+        retval = list_db(argv[argc - 1]);
+        return retval;
+    }
+
+    i = param_check("-o", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        dst_filename = strdup(argv[i + 1]);
+    } else {
+        dst_filename = get_filename_ext(argv[argc - 1], ".db");
+    }
+
+    if (dst_filename && read_listing(argv[argc - 1])) {
+        qsort(entries, num_entries, sizeof(db_entry_t), entry_compare);
+        if (write_db(dst_filename)) {
+            printf("%s: %d entries\n", dst_filename, num_entries);
+            retval = 0;
+        }
+    }
+
+    free(dst_filename);
+    free(entries);
+    free(strings);
+    free(games);
+
+    return retval;
+}
+
+/* Print catalogue in listing format */
+static int list_db(const char* filename) {
+    md5_db_t* db;
+    Uint64 hash;
+    Uint32 i;
+    int j;
+
+    db = md5_db_open(filename);
+    if (!db) {
+        return 1;
+    }
+
+    for (i = 0; i < db->num_entries; i++) {
+        for (j = 0; j < 16; j++) {
+            printf("%02x", db->entries[i].digest[j]);
+        }
+        hash = md5_db_hash(db, i);
+        printf(" %u %08x%08x %s %s\n", md5_db_size(db, i), (Uint32) (hash >> 32), (Uint32) hash,
+            md5_db_game(db, i), md5_db_path(db, i));
+    }
+
+    md5_db_close(db);
+    return 0;
+}
+
+/*
+    One entry per line:
+    md5 size hash game path
+
+    size and hash are 0 if unknown, hash is hash64() of file as 16 hex
+    digits, path is rest of line.
+    Empty lines and lines starting with # are ignored.
+*/
+static int read_listing(const char* filename) {
+    FILE* src;
+    char line[1024];
+    int num_line = 0, retval = 1;
+
+    src = fopen(filename, "r");
+    if (!src) {
+        fprintf(stderr, "Can not open %s for reading\n", filename);
+        return 0;
+    }
+
+    /* Offset 0 is empty string */
+    if (!add_string("", NULL)) {
+        fclose(src);
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), src)) {
+        ++num_line;
+        if (!parse_line(line, num_line)) {
+            retval = 0;
+            break;
+        }
+    }
+
+    fclose(src);
+    return retval;
+}
+
+static int parse_line(char* line, int num_line) {
+    char *game, *path, *end, *hash;
+    unsigned long size;
+    db_entry_t* entry;
+    int i;
+
+    /* Remove trailing spaces and end of line */
+    end = line + strlen(line);
+    while ((end > line) && isspace((unsigned char) end[-1])) {
+        *(--end) = '\0';
+    }
+    while (isspace((unsigned char) *line)) {
+        ++line;
+    }
+    if ((line[0] == '\0') || (line[0] == '#')) {
+        return 1;
+    }
+
+    if (num_entries >= max_entries) {
+        int new_max = (max_entries ? max_entries * 2 : 1024);
+        db_entry_t* new_entries = (db_entry_t*) realloc(entries, new_max * sizeof(db_entry_t));
+
+        if (!new_entries) {
+            fprintf(stderr, "Can not allocate memory for entries\n");
+            return 0;
+        }
+        entries = new_entries;
+        max_entries = new_max;
+    }
+    entry = &entries[num_entries];
+    entry->line = num_line;
+
+    /* MD5 */
+    for (i = 0; i < 32; i++) {
+        if (!isxdigit((unsigned char) line[i])) {
+            break;
+        }
+    }
+    if ((i != 32) || !isspace((unsigned char) line[32])) {
+        fprintf(stderr, "Line %d: invalid MD5\n", num_line);
+        return 0;
+    }
+    for (i = 0; i < 16; i++) {
+        unsigned int value;
+
+        sscanf(&line[i * 2], "%2x", &value);
+        entry->digest[i] = value;
+    }
+
+    /* Size */
+    size = strtoul(&line[32], &end, 10);
+    if ((end == &line[32]) || !isspace((unsigned char) *end) || (size > 0xffffffffUL)) {
+        fprintf(stderr, "Line %d: invalid size\n", num_line);
+        return 0;
+    }
+    entry->size = size;
+
+    /* Fast hash */
+    hash = end;
+    while (isspace((unsigned char) *hash)) {
+        ++hash;
+    }
+    entry->hash = 0;
+    for (i = 0; (i < 16) && isxdigit((unsigned char) hash[i]); i++) {
+        int digit = tolower((unsigned char) hash[i]);
+
+        digit = (digit <= '9' ? digit - '0' : digit - 'a' + 10);
+        entry->hash = (entry->hash << 4) | digit;
+    }
+    if ((i == 0) || !isspace((unsigned char) hash[i])) {
+        fprintf(stderr, "Line %d: invalid hash\n", num_line);
+        return 0;
+    }
+
+    /* Game, then path */
+    game = &hash[i];
+    while (isspace((unsigned char) *game)) {
+        ++game;
+    }
+    path = game;
+    while (*path && !isspace((unsigned char) *path)) {
+        ++path;
+    }
+    if (*path == '\0') {
+        fprintf(stderr, "Line %d: missing path\n", num_line);
+        return 0;
+    }
+    *path++ = '\0';
+    while (isspace((unsigned char) *path)) {
+        ++path;
+    }
+
+    if (!add_game(game, &entry->game) || !add_string(path, &entry->path)) {
+        return 0;
+    }
+
+    ++num_entries;
+    return 1;
+}
+
+static int add_string(const char* str, Uint32* offset) {
+    Uint32 length = strlen(str) + 1;
+
+    if (strings_length + length > max_strings) {
+        Uint32 new_max = (max_strings ? max_strings * 2 : 65536);
+        char* new_strings;
+
+        while (strings_length + length > new_max) {
+            new_max *= 2;
+        }
+        new_strings = (char*) realloc(strings, new_max);
+        if (!new_strings) {
+            fprintf(stderr, "Can not allocate memory for strings\n");
+            return 0;
+        }
+        strings = new_strings;
+        max_strings = new_max;
+    }
+
+    if (offset) {
+        *offset = strings_length;
+    }
+    memcpy(&strings[strings_length], str, length);
+    strings_length += length;
+    return 1;
+}
+
+/* Games are shared by many entries, store each name once */
+static int add_game(const char* game, Uint32* offset) {
+    Uint32* new_games;
+    int i;
+
+    for (i = 0; i < num_games; i++) {
+        if (strcmp(&strings[games[i]], game) == 0) {
+            *offset = games[i];
+            return 1;
+        }
+    }
+
+    new_games = (Uint32*) realloc(games, (num_games + 1) * sizeof(Uint32));
+    if (!new_games) {
+        fprintf(stderr, "Can not allocate memory for games\n");
+        return 0;
+    }
+    games = new_games;
+
+    if (!add_string(game, offset)) {
+        return 0;
+    }
+    games[num_games++] = *offset;
+    return 1;
+}
+
+static int entry_compare(const void* a, const void* b) {
+    const db_entry_t* entry_a = (const db_entry_t*) a;
+    const db_entry_t* entry_b = (const db_entry_t*) b;
+    int result = memcmp(entry_a->digest, entry_b->digest, 16);
+
+    if (result == 0) {
+        result = entry_a->line - entry_b->line;
+    }
+    return result;
+}
+
+/* Sizes table is sorted by size, then hash */
+static int size_compare(const void* a, const void* b) {
+    const db_entry_t* entry_a = *(const db_entry_t**) a;
+    const db_entry_t* entry_b = *(const db_entry_t**) b;
+
+    if (entry_a->size != entry_b->size) {
+        return (entry_a->size > entry_b->size) - (entry_a->size < entry_b->size);
+    }
+    return (entry_a->hash > entry_b->hash) - (entry_a->hash < entry_b->hash);
+}
+
+static int write_db(const char* filename) {
+    rw_t* dst;
+    db_entry_t** sizes;
+    Uint32 entries_offset = MD5_DB_HEADER_SIZE;
+    Uint32 sizes_offset = entries_offset + num_entries * MD5_DB_ENTRY_SIZE;
+    Uint32 strings_offset = sizes_offset + num_entries * MD5_DB_SIZE_SIZE;
+    int i, retval = 1;
+
+    sizes = (db_entry_t**) malloc((num_entries + 1) * sizeof(db_entry_t*));
+    if (!sizes) {
+        fprintf(stderr, "Can not allocate memory for sizes\n");
+        return 0;
+    }
+    for (i = 0; i < num_entries; i++) {
+        sizes[i] = &entries[i];
+    }
+    qsort(sizes, num_entries, sizeof(db_entry_t*), size_compare);
+
+    dst = rw_from_file(filename, "wb");
+    if (!dst) {
+        fprintf(stderr, "Can not create %s for writing\n", filename);
+        free(sizes);
+        return 0;
+    }
+
+    /* Header */
+    rw_write(dst, MD5_DB_MAGIC, 8, 1);
+    rw_write_le32(dst, MD5_DB_VERSION);
+    rw_write_le32(dst, num_entries);
+    rw_write_le32(dst, entries_offset);
+    rw_write_le32(dst, strings_offset);
+    rw_write_le32(dst, strings_length);
+    rw_write_le32(dst, sizes_offset);
+
+    /* Entries */
+    for (i = 0; i < num_entries; i++) {
+        rw_write(dst, entries[i].digest, 16, 1);
+        rw_write_le64(dst, entries[i].hash);
+        rw_write_le32(dst, entries[i].size);
+        rw_write_le32(dst, entries[i].path);
+        rw_write_le32(dst, entries[i].game);
+        rw_write_le32(dst, 0);
+    }
+
+    /* Sizes */
+    for (i = 0; i < num_entries; i++) {
+        rw_write_le32(dst, sizes[i]->size);
+        rw_write_le32(dst, 0);
+        rw_write_le64(dst, sizes[i]->hash);
+    }
+
+    /* Strings */
+    if (rw_write(dst, strings, strings_length, 1) != 1) {
+        fprintf(stderr, "Can not write %s\n", filename);
+        retval = 0;
+    }
+
+    rw_close(dst);
+    free(sizes);
+    return retval;
+}
@@ -0,0 +1,411 @@
+/*
+    Multi-call binary: run tools by name, or a batch of them
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#include "rw.h"
+#include "thread.h"
+
+#include "depack_adt.h"
+#include "depack_pak.h"
+#include "pack_pak.h"
+
+#include "applets.h"
+#include "param.h"
+
+/*--- Defines ---*/
+
+#define MAX_THREADS 64
+
+#define MAX_LINE 4096
+#define MAX_ARGS 64
+
+/* Tool keeps options in static variables, only one such tool runs at a time */
+#define APPLET_EXCLUSIVE (1 << 0)
+
+/*--- Types ---*/
+
+typedef struct {
+    const char* name;
+    int (*main)(int argc, char** argv);
+    int (*main_ctxt)(applet_context_t* ctxt, int argc, char** argv); /* NULL if none */
+    int flags;
+} applet_t;
+
+typedef struct {
+    int line; /* Line in manifest */
+    const applet_t* applet;
+    char* args; /* Arguments, split in place */
+    int argc;
+    char* argv[MAX_ARGS + 1];
+    int retval;
+} batch_job_t;
+
+typedef struct {
+    batch_job_t* jobs;
+    int num_jobs;
+    int next_job; /* Next job to run */
+    mutex_t* lock;
+    mutex_t* exclusive; /* Held while an exclusive tool runs */
+} batch_context_t;
+
+/*--- Const ---*/
+
+static const applet_t applets[] = { { "adt2img", adt2img_main, adt2img_main_ctxt, 0 },
+    { "bss2bmp", bss2bmp_main, NULL, 0 }, { "bsssld2tim", bsssld2tim_main, NULL, 0 },
+    { "convert", convert_main, convert_main_ctxt, 0 }, { "emd2xml", emd2xml_main, NULL, 0 },
+    { "extract_bin", bin_main, NULL, APPLET_EXCLUSIVE },
+    { "file2pak", file2pak_main, file2pak_main_ctxt, 0 },
+    { "iso_search", iso_search_main, NULL, APPLET_EXCLUSIVE },
+    { "md5db", md5db_main, NULL, APPLET_EXCLUSIVE }, { "pak2tim", pak2tim_main, pak2tim_main_ctxt, 0 },
+    { "pix2bmp", pix2bmp_main, NULL, 0 }, { "ptc2bmp", ptc2bmp_main, NULL, 0 },
+    { "rgb2bmp", rgb2bmp_main, NULL, 0 }, { "rofs", rofs_main, NULL, 0 },
+    { "sig_search", sig_search_main, NULL, APPLET_EXCLUSIVE },
+    { "sld", sld_main, NULL, APPLET_EXCLUSIVE } };
+
+#define NUM_APPLETS ((int) (sizeof(applets) / sizeof(applet_t)))
+
+/*--- Function prototypes ---*/
+
+static void usage(const char* name);
+static const applet_t* find_applet(const char* name, size_t length);
+static const char* get_basename(const char* path, size_t* length);
+static int batch_main(int argc, char** argv);
+static int read_manifest(const char* filename, batch_context_t* ctxt);
+static int split_args(char* line, char** argv);
+static int batch_thread(void* data);
+static int batch_run(const applet_t* applet, applet_context_t* ctxt, int argc, char** argv);
+
+/*--- Functions ---*/
+
+int main(int argc, char** argv) {
+    const applet_t* applet;
+    const char* name;
+    size_t length;
+
+    /* Called through a link named as a tool ? */
+    name = get_basename(argv[0], &length);
+    applet = find_applet(name, length);
+    if (applet) {
+        return applet->main(argc, argv);
+    }
+
+    if (argc < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (strcmp(argv[1], "batch") == 0) {
+        return batch_main(argc - 1, &argv[1]);
+    }
+
+    applet = find_applet(argv[1], strlen(argv[1]));
+    if (!applet) {
+        fprintf(stderr, "Unknown tool %s\n", argv[1]);
+        usage(argv[0]);
+        return 1;
+    }
+
+    return applet->main(argc - 1, &argv[1]);
+}
+
+static void usage(const char* name) {
+    int i;
+
+    fprintf(stderr, "Usage: %s tool [arguments]\n", name);
+    fprintf(stderr, "       %s batch [-j threads] /path/to/manifest.txt\n", name);
+    fprintf(stderr, "Tools:");
+    for (i = 0; i < NUM_APPLETS; i++) {
+        fprintf(stderr, " %s", applets[i].name);
+    }
+    fprintf(stderr, "\n");
+}
+
+static const applet_t* find_applet(const char* name, size_t length) {
+    int i;
+
+    for (i = 0; i < NUM_APPLETS; i++) {
+        if ((strlen(applets[i].name) == length) && (strncmp(applets[i].name, name, length) == 0)) {
+            return &applets[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Name of program without directory and .exe extension */
+static const char* get_basename(const char* path, size_t* length) {
+    const char* name = path;
+    const char* c;
+
+    for (c = path; *c; c++) {
+        if ((*c == '/') || (*c == '\\')) {
+            name = c + 1;
+        }
+    }
+
+    *length = strlen(name);
+    if ((*length > 4) && (strcmp(&name[*length - 4], ".exe") == 0)) {
+        *length -= 4;
+    }
+
+    return name;
+}
+
+/*--- Batch ---*/
+
+static int batch_main(int argc, char** argv) {
+    batch_context_t ctxt;
+    thread_t* threads[MAX_THREADS];
+    int i, count = 0, retval = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s [-j threads] /path/to/manifest.txt\n", argv[0]);
+        return 1;
+    }
+
+    i = param_check("-j", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        count = atoi(argv[i + 1]);
+    }
+
+    memset(&ctxt, 0, sizeof(ctxt));
+    if (!read_manifest(argv[argc - 1], &ctxt)) {
+        retval = 1;
+        goto error;
+    }
+
+    ctxt.lock = mutex_create();
+    ctxt.exclusive = mutex_create();
+    if (!ctxt.lock || !ctxt.exclusive) {
+        fprintf(stderr, "Can not create mutex\n");
+        retval = 1;
+        goto error;
+    }
+
+    if (count <= 0) {
+        count = cpu_count();
+    }
+    if (count > MAX_THREADS) {
+        count = MAX_THREADS;
+    }
+    if (count > ctxt.num_jobs) {
+        count = ctxt.num_jobs;
+    }
+
+    for (i = 0; i < count; i++) {
+        threads[i] = thread_create(batch_thread, &ctxt);
+        if (!threads[i]) {
+            break;
+        }
+    }
+    count = i;
+
+    if (count == 0) {
+        batch_thread(&ctxt);
+    }
+    for (i = 0; i < count; i++) {
+        thread_wait(threads[i]);
+    }
+
+    /* Report failed jobs once all are done */
+    for (i = 0; i < ctxt.num_jobs; i++) {
+        if (ctxt.jobs[i].retval != 0) {
+            fprintf(stderr, "%s:%d: %s failed\n", argv[argc - 1], ctxt.jobs[i].line, ctxt.jobs[i].argv[0]);
+            retval = 1;
+        }
+    }
+
+error:
+    mutex_destroy(ctxt.exclusive);
+    mutex_destroy(ctxt.lock);
+    for (i = 0; i < ctxt.num_jobs; i++) {
+        free(ctxt.jobs[i].args);
+    }
+    free(ctxt.jobs);
+
+    return retval;
+}
+
+/*
+    One job per line: a tool and its arguments, separated by spaces.
+    Arguments with spaces are enclosed in double quotes. Empty lines and
+    lines starting with # are ignored.
+*/
+static int read_manifest(const char* filename, batch_context_t* ctxt) {
+    FILE* f;
+    char line[MAX_LINE];
+    int max_jobs = 0, num_line = 0, retval = 1;
+
+    f = fopen(filename, "r");
+    if (!f) {
+        fprintf(stderr, "Can not open %s for reading\n", filename);
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        batch_job_t* job;
+        size_t length = strlen(line);
+
+        ++num_line;
+        if ((length == sizeof(line) - 1) && (line[length - 1] != '\n')) {
+            fprintf(stderr, "%s:%d: line too long\n", filename, num_line);
+            retval = 0;
+            break;
+        }
+        while ((length > 0) && ((line[length - 1] == '\n') || (line[length - 1] == '\r'))) {
+            line[--length] = '\0';
+        }
+
+        if (ctxt->num_jobs == max_jobs) {
+            batch_job_t* jobs;
+
+            max_jobs = (max_jobs ? max_jobs * 2 : 64);
+            jobs = (batch_job_t*) realloc(ctxt->jobs, max_jobs * sizeof(batch_job_t));
+            if (!jobs) {
+                fprintf(stderr, "Can not allocate memory for jobs\n");
+                retval = 0;
+                break;
+            }
+            ctxt->jobs = jobs;
+        }
+
+        job = &ctxt->jobs[ctxt->num_jobs];
+        memset(job, 0, sizeof(batch_job_t));
+        job->line = num_line;
+        job->args = strdup(line);
+        if (!job->args) {
+            fprintf(stderr, "Can not allocate memory for jobs\n");
+            retval = 0;
+            break;
+        }
+
+        job->argc = split_args(job->args, job->argv);
+        if (job->argc == 0) {
+            free(job->args);
+            continue;
+        }
+        ++ctxt->num_jobs;
+
+        if (job->argc < 0) {
+            fprintf(stderr, "%s:%d: too many arguments\n", filename, num_line);
+            retval = 0;
+            break;
+        }
+        job->applet = find_applet(job->argv[0], strlen(job->argv[0]));
+        if (!job->applet) {
+            fprintf(stderr, "%s:%d: unknown tool %s\n", filename, num_line, job->argv[0]);
+            retval = 0;
+            break;
+        }
+    }
+
+    fclose(f);
+    return retval;
+}
+
+/* Returns number of arguments, 0 for a comment, -1 if too many */
+static int split_args(char* line, char** argv) {
+    char* src = line;
+    char* dst = line;
+    int argc = 0;
+
+    for (;;) {
+        int quoted = 0;
+
+        while ((*src == ' ') || (*src == '\t')) {
+            src++;
+        }
+        if ((*src == '\0') || ((argc == 0) && (*src == '#'))) {
+            break;
+        }
+        if (argc == MAX_ARGS) {
+            return -1;
+        }
+
+        /* Copy argument over itself, without quotes */
+        argv[argc++] = dst;
+        while (*src) {
+            if (*src == '"') {
+                quoted = !quoted;
+                src++;
+                continue;
+            }
+            if (!quoted && ((*src == ' ') || (*src == '\t'))) {
+                src++;
+                break;
+            }
+            *dst++ = *src++;
+        }
+        *dst++ = '\0';
+    }
+
+    argv[argc] = NULL;
+    return argc;
+}
+
+static int batch_thread(void* data) {
+    batch_context_t* ctxt = (batch_context_t*) data;
+    applet_context_t applet_ctxt;
+
+    /* Depackers are created by first job needing them, reused by next ones */
+    memset(&applet_ctxt, 0, sizeof(applet_ctxt));
+
+    for (;;) {
+        batch_job_t* job;
+        int i;
+
+        mutex_lock(ctxt->lock);
+        i = ctxt->next_job++;
+        mutex_unlock(ctxt->lock);
+        if (i >= ctxt->num_jobs) {
+            break;
+        }
+
+        job = &ctxt->jobs[i];
+        if (job->applet->flags & APPLET_EXCLUSIVE) {
+            mutex_lock(ctxt->exclusive);
+            job->retval = batch_run(job->applet, &applet_ctxt, job->argc, job->argv);
+            mutex_unlock(ctxt->exclusive);
+        } else {
+            job->retval = batch_run(job->applet, &applet_ctxt, job->argc, job->argv);
+        }
+    }
+
+    adt_context_destroy(applet_ctxt.adt);
+    pak_context_destroy(applet_ctxt.pak);
+    pak_pack_context_destroy(applet_ctxt.pack);
+
+    return 0;
+}
+
+static int batch_run(const applet_t* applet, applet_context_t* ctxt, int argc, char** argv) {
+    if (applet->main_ctxt) {
+        return applet->main_ctxt(ctxt, argc, argv);
+    }
+
+    return applet->main(argc, argv);
+}
@@ -21,9 +21,13 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <fcntl.h>
 
-#include <SDL.h>
+#include "rw.h"
+
+#include "pack_pak.h"
 
 /*--- Defines ---*/
 
@@ -43,213 +47,231 @@ typedef struct {
     Uint8* enc_str; /* Encoded string */
 } re1_pack_t;
 
-/*--- Variables ---*/
+struct pak_pack_context_s {
+    Uint8* dstPointer;
+    size_t dstBufLen;
+    size_t dstOffset;
 
-static Uint8* dstPointer;
-static int dstBufLen;
-static int dstOffset;
-static int dstBit;
+    re1_pack_t dict[DECODE_SIZE];
 
-static re1_pack_t dict[DECODE_SIZE];
+    int out_code, out_code_bits;
 
-static int out_code, out_code_bits;
+    Uint8* curstr;
+    int curstr_pos, curstr_len;
 
-static Uint8* curstr;
-static int curstr_pos, curstr_len;
+    int output_bit_count;
+    Uint32 output_bit_buffer;
+};
 
 /*--- Functions prototypes ---*/
 
-static void dict_clear(void);
-static void dict_genstr(Uint8 new_char);
-static void dict_check(int* stronly, int* strandchar);
+static void dict_clear(pak_pack_context_t* ctxt);
+static void dict_genstr(pak_pack_context_t* ctxt, Uint8 new_char);
+static void dict_check(pak_pack_context_t* ctxt, int* stronly, int* strandchar);
 
-static void curstr_clear(void);
-static void curstr_addchar(Uint8 new_char);
-static void curstr_set(Uint8 new_char);
+static void curstr_clear(pak_pack_context_t* ctxt);
+static void curstr_addchar(pak_pack_context_t* ctxt, Uint8 new_char);
+static void curstr_set(pak_pack_context_t* ctxt, Uint8 new_char);
 
-static void pak_write_bits(Uint32 value, int num_bits);
+static void pak_write_bits(pak_pack_context_t* ctxt, Uint32 value, int num_bits);
 
 /*--- Functions ---*/
 
-static void dict_clear(void) {
+pak_pack_context_t* pak_pack_context_create(void) {
+    return (pak_pack_context_t*) calloc(1, sizeof(pak_pack_context_t));
+}
+
+void pak_pack_context_destroy(pak_pack_context_t* ctxt) {
+    if (!ctxt) {
+        return;
+    }
+
+    dict_clear(ctxt);
+    free(ctxt->curstr);
+    free(ctxt);
+}
+
+static void dict_clear(pak_pack_context_t* ctxt) {
     int i;
 
     for (i = LZW_FIRST; i < DECODE_SIZE; i++) {
-        if (dict[i].enc_str) {
-            free(dict[i].enc_str);
-            dict[i].enc_str = NULL;
-            dict[i].len = 0;
+        if (ctxt->dict[i].enc_str) {
+            free(ctxt->dict[i].enc_str);
+            ctxt->dict[i].enc_str = NULL;
+            ctxt->dict[i].len = 0;
         }
     }
 
-    out_code = LZW_FIRST;
-    out_code_bits = 9;
+    ctxt->out_code = LZW_FIRST;
+    ctxt->out_code_bits = 9;
 }
 
-static void dict_genstr(Uint8 new_char) {
-    if (dict[out_code].len <= curstr_pos) {
-        dict[out_code].len = curstr_pos + 1;
-        dict[out_code].enc_str = realloc(dict[out_code].enc_str, dict[out_code].len);
+static void dict_genstr(pak_pack_context_t* ctxt, Uint8 new_char) {
+    if (ctxt->dict[ctxt->out_code].len <= ctxt->curstr_pos) {
+        ctxt->dict[ctxt->out_code].len = ctxt->curstr_pos + 1;
+        ctxt->dict[ctxt->out_code].enc_str =
+            realloc(ctxt->dict[ctxt->out_code].enc_str, ctxt->dict[ctxt->out_code].len);
     }
 
-    if (curstr_pos > 0) {
-        memcpy(dict[out_code].enc_str, curstr, curstr_pos);
+    if (ctxt->curstr_pos > 0) {
+        memcpy(ctxt->dict[ctxt->out_code].enc_str, ctxt->curstr, ctxt->curstr_pos);
     }
-    dict[out_code].enc_str[curstr_pos] = new_char;
+    ctxt->dict[ctxt->out_code].enc_str[ctxt->curstr_pos] = new_char;
 }
 
-static void dict_check(int* stronly, int* strandchar) {
+static void dict_check(pak_pack_context_t* ctxt, int* stronly, int* strandchar) {
     int i;
 
     *stronly = *strandchar = -1;
 
     /* Check single char first */
-    if (dict[out_code].len == 1) {
-        *strandchar = dict[out_code].enc_str[0];
+    if (ctxt->dict[ctxt->out_code].len == 1) {
+        *strandchar = ctxt->dict[ctxt->out_code].enc_str[0];
     }
-    if (curstr_pos == 1) {
-        *stronly = curstr[0];
+    if (ctxt->curstr_pos == 1) {
+        *stronly = ctxt->curstr[0];
     }
 
     /* Check each prefix first */
-    for (i = LZW_FIRST; i < out_code; i++) {
-        if (dict[i].len == curstr_pos) {
-            if (memcmp(dict[i].enc_str, curstr, curstr_pos) == 0) {
+    for (i = LZW_FIRST; i < ctxt->out_code; i++) {
+        if (ctxt->dict[i].len == ctxt->curstr_pos) {
+            if (memcmp(ctxt->dict[i].enc_str, ctxt->curstr, ctxt->curstr_pos) == 0) {
                 *stronly = i;
             }
         }
-        if (dict[i].len == dict[out_code].len) {
-            if (memcmp(dict[i].enc_str, dict[out_code].enc_str, dict[out_code].len) == 0) {
+        if (ctxt->dict[i].len == ctxt->dict[ctxt->out_code].len) {
+            if (memcmp(ctxt->dict[i].enc_str, ctxt->dict[ctxt->out_code].enc_str,
+                    ctxt->dict[ctxt->out_code].len)
+                == 0) {
                 *strandchar = i;
             }
         }
     }
 }
 
-static void curstr_clear(void) { curstr_pos = 0; }
+static void curstr_clear(pak_pack_context_t* ctxt) { ctxt->curstr_pos = 0; }
 
-static void curstr_addchar(Uint8 new_char) {
-    if (curstr_pos >= curstr_len - 1) {
-        curstr_len += CHUNK_SIZE;
-        curstr = realloc(curstr, curstr_len);
-        if (curstr == NULL) {
-            fprintf(stderr, "pak: can not allocate %d bytes\n", curstr_len);
+static void curstr_addchar(pak_pack_context_t* ctxt, Uint8 new_char) {
+    if (ctxt->curstr_pos >= ctxt->curstr_len - 1) {
+        ctxt->curstr_len += CHUNK_SIZE;
+        ctxt->curstr = realloc(ctxt->curstr, ctxt->curstr_len);
+        if (ctxt->curstr == NULL) {
+            fprintf(stderr, "pak: can not allocate %d bytes\n", ctxt->curstr_len);
             return;
         }
     }
 
-    curstr[curstr_pos++] = new_char;
+    ctxt->curstr[ctxt->curstr_pos++] = new_char;
 }
 
-static void curstr_set(Uint8 new_char) {
-    curstr_pos = 0;
-    curstr_addchar(new_char);
+static void curstr_set(pak_pack_context_t* ctxt, Uint8 new_char) {
+    ctxt->curstr_pos = 0;
+    curstr_addchar(ctxt, new_char);
 }
 
-static int output_bit_count = 0;
-static Uint32 output_bit_buffer = 0;
-
-static void pak_write_bits(Uint32 value, int num_bits) {
-    output_bit_buffer |= (Uint32) value << (32 - num_bits - output_bit_count);
-    output_bit_count += num_bits;
+static void pak_write_bits(pak_pack_context_t* ctxt, Uint32 value, int num_bits) {
+    ctxt->output_bit_buffer |= (Uint32) value << (32 - num_bits - ctxt->output_bit_count);
+    ctxt->output_bit_count += num_bits;
 
-    while (output_bit_count >= 8) {
-        if ((dstPointer == NULL) || (dstOffset >= dstBufLen)) {
-            dstBufLen += CHUNK_SIZE;
-            dstPointer = realloc(dstPointer, dstBufLen);
-            if (dstPointer == NULL) {
-                fprintf(stderr, "pak: can not allocate %d bytes\n", dstBufLen);
+    while (ctxt->output_bit_count >= 8) {
+        if ((ctxt->dstPointer == NULL) || (ctxt->dstOffset >= ctxt->dstBufLen)) {
+            ctxt->dstBufLen += CHUNK_SIZE;
+            ctxt->dstPointer = realloc(ctxt->dstPointer, ctxt->dstBufLen);
+            if (ctxt->dstPointer == NULL) {
+                fprintf(stderr, "pak: can not allocate %" PRIu64 " bytes\n", (Uint64) ctxt->dstBufLen);
                 return;
             }
         }
 
-        dstPointer[dstOffset++] = output_bit_buffer >> 24;
-        output_bit_buffer <<= 8;
-        output_bit_count -= 8;
+        ctxt->dstPointer[ctxt->dstOffset++] = ctxt->output_bit_buffer >> 24;
+        ctxt->output_bit_buffer <<= 8;
+        ctxt->output_bit_count -= 8;
     }
 }
 
 static int is_pot(unsigned x) { return (x & (x - 1)) == 0; }
 
-void pak_pack(SDL_RWops* src, Uint8** dstBufPtr, int* dstLength) {
+void pak_pack_ctxt(pak_pack_context_t* ctxt, rw_t* src, Uint8** dstBufPtr, size_t* dstLength) {
     Uint8 src_char;
-    int i, dict_str, dict_strandchar;
-    Uint32 srclen, srcOffset = 0;
+    int dict_str, dict_strandchar = -1;
+    Uint32 srcOffset = 0;
 
-    *dstBufPtr = dstPointer = NULL;
-    *dstLength = dstBufLen = dstOffset = 0;
-    dstBit = 7;
-    curstr_len = 0;
+    *dstBufPtr = ctxt->dstPointer = NULL;
+    *dstLength = ctxt->dstBufLen = ctxt->dstOffset = 0;
+    ctxt->output_bit_count = 0;
+    ctxt->output_bit_buffer = 0;
 
-    SDL_RWseek(src, 0, RW_SEEK_END);
-    srclen = SDL_RWtell(src);
-    SDL_RWseek(src, 0, RW_SEEK_SET);
+    rw_seek(src, 0, RW_SEEK_SET);
 
-    /* Init base dict */
-    memset(dict, 0, sizeof(dict));
-    dict_clear();
+    /* Init base dict, strings of previous file were freed */
+    dict_clear(ctxt);
 
     /* Current string = empty */
-    curstr_clear();
+    curstr_clear(ctxt);
 
     /* While character in source */
     for (;;) {
-        if (SDL_RWread(src, &src_char, 1, 1) <= 0) {
+        if (rw_read(src, &src_char, 1, 1) <= 0) {
             break;
         }
         ++srcOffset;
 
         /* Generate new string = cur_string+src_char */
-        dict_genstr(src_char);
+        dict_genstr(ctxt, src_char);
 
         /* if cur_string+src_char in dict */
-        dict_check(&dict_str, &dict_strandchar);
+        dict_check(ctxt, &dict_str, &dict_strandchar);
 
         if (dict_strandchar >= 0) {
             /* cur_string += src_char */
-            curstr_addchar(src_char);
+            curstr_addchar(ctxt, src_char);
         } else {
             /* Need more bits ? */
-            if (is_pot(out_code)) {
-                pak_write_bits(LZW_NEXT, out_code_bits);
-                ++out_code_bits;
+            if (is_pot(ctxt->out_code)) {
+                pak_write_bits(ctxt, LZW_NEXT, ctxt->out_code_bits);
+                ++ctxt->out_code_bits;
             }
 
             /* write cur_string index to output */
-            pak_write_bits(dict_str, out_code_bits);
+            pak_write_bits(ctxt, dict_str, ctxt->out_code_bits);
 
             /* add cur_string+src_char to dict */
-            ++out_code;
+            ++ctxt->out_code;
 
             /* cur_string = src_char */
-            curstr_set(src_char);
-        }
-
-        if ((srcOffset & 31) == 0) {
-            printf("%d %%\r", (srcOffset * 100) / srclen);
+            curstr_set(ctxt, src_char);
         }
     }
-    printf("\n");
 
-    /* Output last code */
-    pak_write_bits(dict_strandchar, out_code_bits);
+    /* Output last code, cur_string is a single char if last one was not in dict */
+    if (srcOffset > 0) {
+        pak_write_bits(ctxt, (dict_strandchar >= 0 ? dict_strandchar : src_char), ctxt->out_code_bits);
+    }
     /* Output end of stream */
-    pak_write_bits(LZW_STOP, out_code_bits);
+    pak_write_bits(ctxt, LZW_STOP, ctxt->out_code_bits);
     /* Flush remaining bits */
-    pak_write_bits(0, output_bit_count + 8);
+    pak_write_bits(ctxt, 0, ctxt->output_bit_count + 8);
 
-    /* Free stuff */
-    if (curstr) {
-        free(curstr);
-    }
-
-    for (i = LZW_FIRST; i < DECODE_SIZE; i++) {
-        if (dict[i].enc_str) {
-            free(dict[i].enc_str);
-        }
-    }
+    /* Free strings, current string buffer is kept for next file */
+    dict_clear(ctxt);
 
     /* Return packed buffer */
-    *dstBufPtr = (Uint8*) dstPointer;
-    *dstLength = dstOffset;
+    *dstBufPtr = (Uint8*) ctxt->dstPointer;
+    *dstLength = ctxt->dstOffset;
+    ctxt->dstPointer = NULL;
+}
+
+void pak_pack(rw_t* src, Uint8** dstBufPtr, size_t* dstLength) {
+    pak_pack_context_t* ctxt;
+
+    *dstBufPtr = NULL;
+    *dstLength = 0;
+
+    ctxt = pak_pack_context_create();
+    if (!ctxt) {
+        fprintf(stderr, "pak: can not allocate memory for context\n");
+        return;
+    }
+    pak_pack_ctxt(ctxt, src, dstBufPtr, dstLength);
+    pak_pack_context_destroy(ctxt);
 }
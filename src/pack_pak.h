@@ -21,6 +21,32 @@
 #ifndef PACK_PAK_H
 #define PACK_PAK_H
 
-void pak_pack(SDL_RWops* src, Uint8** dstPointer, int* dstLength);
+/*--- Types ---*/
+
+typedef struct pak_pack_context_s pak_pack_context_t;
+
+/*--- Functions ---*/
+
+/*
+    Context holds the dictionary, it can be reused for several files, but
+    used by a single thread at a time.
+
+    Returns NULL on error
+*/
+pak_pack_context_t* pak_pack_context_create(void);
+void pak_pack_context_destroy(pak_pack_context_t* ctxt);
+
+/*
+    Pack a file to PAK format
+
+    ctxt	Context
+    src		Source file
+    dstPointer	Pointer to packed file buffer (NULL if failed)
+    dstLength	Length of packed file (0 if failed)
+*/
+void pak_pack_ctxt(pak_pack_context_t* ctxt, rw_t* src, Uint8** dstPointer, size_t* dstLength);
+
+/* Same, with a temporary context */
+void pak_pack(rw_t* src, Uint8** dstPointer, size_t* dstLength);
 
 #endif /* PACK_PAK_H */
@@ -26,29 +26,37 @@
 #    include "config.h"
 #endif
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "depack_pak.h"
 #include "file_functions.h"
 #include "param.h"
 #include "background_tim.h"
+#include "applets.h"
 
-/*--- Variables ---*/
+/*--- Functions prototypes ---*/
 
-/* Flag for image stored with 4 pixels less
+/* remove4pix: image stored with 4 pixels less
    (used for shaking rooms, like lifts or with rolling boulders)
  */
-static int remove4pix = 0;
-
-/*--- Functions prototypes ---*/
-
-int convert_image(const char* filename);
-void remove_4_pixels(Uint8** dstPointer, int* dstLength);
+static int convert_image(applet_context_t* ctxt, const char* filename, int remove4pix);
+static void remove_4_pixels(Uint8** dstPointer, size_t* dstLength);
 
 /*--- Functions ---*/
 
+#ifndef MULTICALL
 int main(int argc, char** argv) {
+    return pak2tim_main(argc, argv);
+}
+#endif
+
+int pak2tim_main(int argc, char** argv) {
+    return pak2tim_main_ctxt(NULL, argc, argv);
+}
+
+int pak2tim_main_ctxt(applet_context_t* ctxt, int argc, char** argv) {
     int retval;
+    int remove4pix = 0;
 
     if (argc < 2) {
         fprintf(stderr, "Usage: %s [-r4] /path/to/filename.pak\n", argv[0]);
@@ -59,31 +67,31 @@ int main(int argc, char** argv) {
         remove4pix = 1;
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Can not initialize SDL: %s\n", SDL_GetError());
-        return 1;
-    }
-    atexit(SDL_Quit);
-
-    retval = convert_image(argv[argc - 1]);
+    retval = convert_image(ctxt, argv[argc - 1], remove4pix);
 
-    SDL_Quit();
     return retval;
 }
 
-int convert_image(const char* filename) {
-    SDL_RWops* src;
+static int convert_image(applet_context_t* ctxt, const char* filename, int remove4pix) {
+    rw_t* src;
     Uint8* dstBuffer;
-    int dstBufLen;
+    size_t dstBufLen;
     int retval = 1;
 
-    src = SDL_RWFromFile(filename, "rb");
+    src = rw_from_file(filename, "rb");
     if (!src) {
         fprintf(stderr, "Can not open %s for reading\n", filename);
         return retval;
     }
-    pak_depack(src, &dstBuffer, &dstBufLen);
-    SDL_RWclose(src);
+    if (ctxt && !ctxt->pak) {
+        ctxt->pak = pak_context_create();
+    }
+    if (ctxt && ctxt->pak) {
+        pak_depack_ctxt(ctxt->pak, src, &dstBuffer, &dstBufLen);
+    } else {
+        pak_depack(src, &dstBuffer, &dstBufLen);
+    }
+    rw_close(src);
 
     if (dstBuffer && dstBufLen) {
         if (remove4pix) {
@@ -101,9 +109,9 @@ int convert_image(const char* filename) {
     return retval;
 }
 
-void remove_4_pixels(Uint8** dstPointer, int* dstLength) {
+static void remove_4_pixels(Uint8** dstPointer, size_t* dstLength) {
     Uint8* srcBuffer = *dstPointer;
-    int srcBufLen = *dstLength;
+    size_t srcBufLen = *dstLength;
     tim_header_t* tim_header = (tim_header_t*) srcBuffer;
     tim_size_t* tim_size;
     Uint32 tim_type, img_offset;
@@ -111,20 +119,20 @@ void remove_4_pixels(Uint8** dstPointer, int* dstLength) {
     Uint16 *srcRow, *dstRow;
     int x, y, w, h;
 
-    if (SDL_SwapLE32(tim_header->magic) != MAGIC_TIM) {
+    if (rw_swap_le32(tim_header->magic) != MAGIC_TIM) {
         fprintf(stderr, "Not a TIM image\n");
         return;
     }
 
-    if (SDL_SwapLE32(tim_header->type) != TIM_TYPE_16) {
+    if (rw_swap_le32(tim_header->type) != TIM_TYPE_16) {
         fprintf(stderr, "Only 16 bpp TIM images can be reparsed\n");
         return;
     }
 
     img_offset = 16;
     tim_size = (tim_size_t*) (&((Uint8*) srcBuffer)[img_offset]);
-    w = SDL_SwapLE16(tim_size->width);
-    h = SDL_SwapLE16(tim_size->height);
+    w = rw_swap_le16(tim_size->width);
+    h = rw_swap_le16(tim_size->height);
 
     srcImage = (Uint8*) malloc(w * h * 2);
     if (!srcImage) {
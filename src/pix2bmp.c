@@ -26,25 +26,26 @@
 #    include "config.h"
 #endif
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "file_functions.h"
+#include "applets.h"
 
-const Uint16 pal_font[16] = { 0x0000, 0xe77b, 0xdf39, 0xceb5, 0x31c2, 0xb5ce, 0xa94a, 0x9ce7,
+static const Uint16 pal_font[16] = { 0x0000, 0xe77b, 0xdf39, 0xceb5, 0x31c2, 0xb5ce, 0xa94a, 0x9ce7,
     0xa4c6, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000 };
 
-void convert_endianness(Uint16* src, int length) {
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+static void convert_endianness(Uint16* src, int length) {
+#ifdef RW_BIG_ENDIAN
     int i;
 
     for (i = 0; i < length >> 1; i++) {
         Uint16 v = *src;
-        *src++ = SDL_SwapLE16(v);
+        *src++ = rw_swap_le16(v);
     }
 #endif
 }
 
-void convert_alpha(Uint16* src, int length) {
+static void convert_alpha(Uint16* src, int length) {
     int i, r, g, b, a;
 
     for (i = 0; i < length >> 1; i++) {
@@ -66,28 +67,28 @@ void convert_alpha(Uint16* src, int length) {
     }
 }
 
-int convert_image(const char* filename) {
-    SDL_RWops* src;
+static int convert_image(const char* filename) {
+    rw_t* src;
     Uint8* dstBuffer;
     int dstBufLen;
     int width = 0, height = 0, bpp = 8, offset = 0;
     const Uint16* palette = NULL; /* palette to use */
     int num_pal = 0;              /* colors in palette */
-    SDL_Surface* image;
+    bmp_image_t image;
 
-    src = SDL_RWFromFile(filename, "rb");
+    src = rw_from_file(filename, "rb");
     if (!src) {
         fprintf(stderr, "Can not open %s for reading\n", filename);
         return 1;
     }
-    dstBufLen = SDL_RWseek(src, 0, SEEK_END);
-    SDL_RWseek(src, 0, SEEK_SET);
+    dstBufLen = rw_seek(src, 0, SEEK_END);
+    rw_seek(src, 0, SEEK_SET);
 
     dstBuffer = (Uint8*) malloc(dstBufLen);
     if (dstBuffer) {
-        SDL_RWread(src, dstBuffer, dstBufLen, 1);
+        rw_read(src, dstBuffer, dstBufLen, 1);
     }
-    SDL_RWclose(src);
+    rw_close(src);
 
     if (!dstBuffer) {
         return 1;
@@ -160,42 +161,32 @@ int convert_image(const char* filename) {
     if (bpp == 16) {
         convert_endianness((Uint16*) (&dstBuffer[offset]), dstBufLen);
         convert_alpha((Uint16*) (&dstBuffer[offset]), dstBufLen);
+        /* Back to little endian for BMP writer */
+        convert_endianness((Uint16*) (&dstBuffer[offset]), dstBufLen);
     }
 
-    image = SDL_CreateRGBSurfaceFrom(&dstBuffer[offset], width, height, bpp,
-        (bpp == 8 ? width : width << 1), 31, 31 << 5, 31 << 10, 1 << 15);
-
-    /* Set a palette ? */
-    if ((bpp == 8) && palette) {
-        SDL_Color* colors = image->format->palette->colors;
-        int i;
-        for (i = 0; i < 256; i++) {
-            colors[i].r = 0;
-            colors[i].g = 0;
-            colors[i].b = 0;
-            if (i < num_pal) {
-                int c;
-                c = palette[i] & 31;
-                colors[i].r = (c << 3) | (c >> 2);
-                c = (palette[i] >> 5) & 31;
-                colors[i].g = (c << 3) | (c >> 2);
-                c = (palette[i] >> 10) & 31;
-                colors[i].b = (c << 3) | (c >> 2);
-            }
-        }
-    }
-
-    if (image) {
-        save_bmp(filename, image);
-
-        SDL_FreeSurface(image);
-    }
+    /* Palette is set with PS1 colors, grey levels if none */
+    memset(&image, 0, sizeof(image));
+    image.width = width;
+    image.height = height;
+    image.format = (bpp == 8 ? BMP_PAL8 : BMP_PS1_16A);
+    image.pixels = &dstBuffer[offset];
+    image.pitch = (bpp == 8 ? width : width << 1);
+    image.palette = palette;
+    image.num_colors = num_pal;
+    save_bmp(filename, &image);
 
     free(dstBuffer);
     return 0;
 }
 
+#ifndef MULTICALL
 int main(int argc, char** argv) {
+    return pix2bmp_main(argc, argv);
+}
+#endif
+
+int pix2bmp_main(int argc, char** argv) {
     int retval;
 
     if (argc < 2) {
@@ -203,14 +194,7 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Can not initialize SDL: %s\n", SDL_GetError());
-        return 1;
-    }
-    atexit(SDL_Quit);
-
     retval = convert_image(argv[1]);
 
-    SDL_Quit();
     return retval;
 }
@@ -26,30 +26,31 @@
 #    include "config.h"
 #endif
 
-#include <SDL.h>
+#include "rw.h"
 
 #include "file_functions.h"
+#include "applets.h"
 
-int convert_image(const char* filename) {
-    SDL_RWops* src;
-    SDL_Surface* image;
+static int convert_image(const char* filename) {
+    rw_t* src;
+    bmp_image_t image;
     Uint8* dstBuffer;
     int dstBufLen;
     int width = 0, height = 0;
 
-    src = SDL_RWFromFile(filename, "rb");
+    src = rw_from_file(filename, "rb");
     if (!src) {
         fprintf(stderr, "Can not open %s for reading\n", filename);
         return 1;
     }
-    dstBufLen = SDL_RWseek(src, 0, SEEK_END);
-    SDL_RWseek(src, 0, SEEK_SET);
+    dstBufLen = rw_seek(src, 0, SEEK_END);
+    rw_seek(src, 0, SEEK_SET);
 
     dstBuffer = (Uint8*) malloc(dstBufLen);
     if (dstBuffer) {
-        SDL_RWread(src, dstBuffer, dstBufLen, 1);
+        rw_read(src, dstBuffer, dstBufLen, 1);
     }
-    SDL_RWclose(src);
+    rw_close(src);
 
     if ((dstBuffer == NULL) || (dstBufLen == 0)) {
         fprintf(stderr, "Error loading file\n");
@@ -71,25 +72,25 @@ int convert_image(const char* filename) {
         return 1;
     }
 
-    image = SDL_CreateRGBSurfaceFrom(dstBuffer, width, height, 24, width * 3,
-#if SDL_BYTEORDER == SDL_BIG_ENDIAN
-        255 << 16, 255 << 8, 255
-#else
-        255, 255 << 8, 255 << 16
-#endif
-        ,
-        0);
-    if (image) {
-        save_bmp(filename, image);
-
-        SDL_FreeSurface(image);
-    }
+    memset(&image, 0, sizeof(image));
+    image.width = width;
+    image.height = height;
+    image.format = BMP_RGB24;
+    image.pixels = dstBuffer;
+    image.pitch = width * 3;
+    save_bmp(filename, &image);
 
     free(dstBuffer);
     return 0;
 }
 
+#ifndef MULTICALL
 int main(int argc, char** argv) {
+    return ptc2bmp_main(argc, argv);
+}
+#endif
+
+int ptc2bmp_main(int argc, char** argv) {
     int retval;
 
     if (argc < 2) {
@@ -97,14 +98,7 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Can not initialize SDL: %s\n", SDL_GetError());
-        return 1;
-    }
-    atexit(SDL_Quit);
-
     retval = convert_image(argv[1]);
 
-    SDL_Quit();
     return retval;
 }
@@ -0,0 +1,60 @@
+/*
+    libreevengi, depackers and converters of Resident Evil files
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef REEVENGI_H
+#define REEVENGI_H
+
+/*
+    Functions keep no state between calls. Depackers with large tables
+    take a context, one per thread, which can be reused for several files;
+    functions without _ctxt suffix use a temporary one.
+*/
+
+/*--- Defines ---*/
+
+/* Incremented when a function or type of this API changes */
+#define REEVENGI_API_VERSION 2
+
+/*--- Includes ---*/
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "rw.h"
+
+#include "bmp.h"
+#include "depack_adt.h"
+#include "depack_bsssld.h"
+#include "depack_mdec.h"
+#include "depack_pak.h"
+#include "depack_rofs.h"
+#include "depack_sld.h"
+#include "depack_vlc.h"
+#include "detect.h"
+#include "pack_pak.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* REEVENGI_H */
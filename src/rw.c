@@ -0,0 +1,281 @@
+/*
+    Integer types, byte order and file/memory streams
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#include "rw.h"
+
+/*--- Defines ---*/
+
+/* 64 bits offsets in files */
+#if defined(_MSC_VER)
+#    define file_seek  _fseeki64
+#    define file_tell  _ftelli64
+#    define file_off_t __int64
+#elif defined(HAVE_FSEEKO)
+#    define file_seek  fseeko
+#    define file_tell  ftello
+#    define file_off_t off_t
+#else
+#    define file_seek  fseek
+#    define file_tell  ftell
+#    define file_off_t long
+#endif
+
+/*--- Types ---*/
+
+struct rw_s {
+    FILE* file; /* NULL for memory */
+    Uint8* mem;
+    size_t length;
+    size_t pos;
+};
+
+/*--- Functions ---*/
+
+Uint16 rw_swap16(Uint16 x) {
+    return (Uint16) ((x << 8) | (x >> 8));
+}
+
+Uint32 rw_swap32(Uint32 x) {
+    return (x << 24) | ((x << 8) & 0x00ff0000UL) | ((x >> 8) & 0x0000ff00UL) | (x >> 24);
+}
+
+Uint64 rw_swap64(Uint64 x) {
+    return ((Uint64) rw_swap32((Uint32) x) << 32) | rw_swap32((Uint32) (x >> 32));
+}
+
+rw_t* rw_from_file(const char* filename, const char* mode) {
+    rw_t* context;
+    FILE* file;
+
+    file = fopen(filename, mode);
+    if (!file) {
+        return NULL;
+    }
+
+    context = (rw_t*) calloc(1, sizeof(rw_t));
+    if (!context) {
+        fclose(file);
+        return NULL;
+    }
+    context->file = file;
+
+    return context;
+}
+
+rw_t* rw_from_mem(void* mem, size_t length) {
+    rw_t* context;
+
+    if (!mem) {
+        return NULL;
+    }
+
+    context = (rw_t*) calloc(1, sizeof(rw_t));
+    if (!context) {
+        return NULL;
+    }
+    context->mem = (Uint8*) mem;
+    context->length = length;
+
+    return context;
+}
+
+Sint64 rw_seek(rw_t* context, Sint64 offset, int whence) {
+    Sint64 pos;
+
+    if (context->file) {
+        static const int file_whence[3] = { SEEK_SET, SEEK_CUR, SEEK_END };
+
+        if ((whence < RW_SEEK_SET) || (whence > RW_SEEK_END)) {
+            return -1;
+        }
+        if (file_seek(context->file, (file_off_t) offset, file_whence[whence]) != 0) {
+            return -1;
+        }
+        return file_tell(context->file);
+    }
+
+    switch (whence) {
+    case RW_SEEK_SET:
+        pos = offset;
+        break;
+    case RW_SEEK_CUR:
+        pos = (Sint64) context->pos + offset;
+        break;
+    case RW_SEEK_END:
+        pos = (Sint64) context->length + offset;
+        break;
+    default:
+        return -1;
+    }
+    if ((pos < 0) || (pos > (Sint64) context->length)) {
+        return -1;
+    }
+    context->pos = (size_t) pos;
+
+    return pos;
+}
+
+Sint64 rw_tell(rw_t* context) {
+    if (context->file) {
+        return file_tell(context->file);
+    }
+    return context->pos;
+}
+
+size_t rw_read(rw_t* context, void* ptr, size_t size, size_t num) {
+    size_t avail;
+
+    if (context->file) {
+        return fread(ptr, size, num, context->file);
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+    avail = (context->length - context->pos) / size;
+    if (num > avail) {
+        num = avail;
+    }
+    memcpy(ptr, &context->mem[context->pos], num * size);
+    context->pos += num * size;
+
+    return num;
+}
+
+size_t rw_write(rw_t* context, const void* ptr, size_t size, size_t num) {
+    size_t avail;
+
+    if (context->file) {
+        return fwrite(ptr, size, num, context->file);
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+    avail = (context->length - context->pos) / size;
+    if (num > avail) {
+        num = avail;
+    }
+    memcpy(&context->mem[context->pos], ptr, num * size);
+    context->pos += num * size;
+
+    return num;
+}
+
+int rw_close(rw_t* context) {
+    int retval = 0;
+
+    if (!context) {
+        return 0;
+    }
+    if (context->file && (fclose(context->file) != 0)) {
+        retval = -1;
+    }
+    free(context);
+
+    return retval;
+}
+
+Uint8 rw_read_u8(rw_t* context) {
+    Uint8 value;
+
+    if (rw_read(context, &value, 1, 1) != 1) {
+        return 0;
+    }
+    return value;
+}
+
+Uint16 rw_read_le16(rw_t* context) {
+    Uint8 b[2];
+
+    if (rw_read(context, b, 2, 1) != 1) {
+        return 0;
+    }
+    return rw_get_le16(b);
+}
+
+Uint32 rw_read_le32(rw_t* context) {
+    Uint8 b[4];
+
+    if (rw_read(context, b, 4, 1) != 1) {
+        return 0;
+    }
+    return rw_get_le32(b);
+}
+
+Uint64 rw_read_le64(rw_t* context) {
+    Uint8 b[8];
+    Uint32 lo, hi;
+
+    if (rw_read(context, b, 8, 1) != 1) {
+        return 0;
+    }
+    lo = rw_get_le32(b);
+    hi = rw_get_le32(&b[4]);
+    return ((Uint64) hi << 32) | lo;
+}
+
+Uint16 rw_get_le16(const Uint8* src) {
+    return src[0] | (src[1] << 8);
+}
+
+Uint32 rw_get_le32(const Uint8* src) {
+    return src[0] | (src[1] << 8) | (src[2] << 16) | ((Uint32) src[3] << 24);
+}
+
+Uint16 rw_get_be16(const Uint8* src) {
+    return (src[0] << 8) | src[1];
+}
+
+size_t rw_write_le16(rw_t* context, Uint16 value) {
+    Uint8 b[2];
+
+    b[0] = value & 0xff;
+    b[1] = value >> 8;
+    return rw_write(context, b, 2, 1);
+}
+
+size_t rw_write_le32(rw_t* context, Uint32 value) {
+    Uint8 b[4];
+
+    b[0] = value & 0xff;
+    b[1] = (value >> 8) & 0xff;
+    b[2] = (value >> 16) & 0xff;
+    b[3] = value >> 24;
+    return rw_write(context, b, 4, 1);
+}
+
+size_t rw_write_le64(rw_t* context, Uint64 value) {
+    Uint8 b[8];
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        b[i] = (Uint8) (value >> (i * 8));
+    }
+    return rw_write(context, b, 8, 1);
+}
@@ -0,0 +1,133 @@
+/*
+    Integer types, byte order and file/memory streams
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef RW_H
+#define RW_H
+
+#include <stddef.h>
+
+/*--- Types ---*/
+
+#ifdef _MSC_VER
+typedef unsigned __int8 Uint8;
+typedef signed __int8 Sint8;
+typedef unsigned __int16 Uint16;
+typedef signed __int16 Sint16;
+typedef unsigned __int32 Uint32;
+typedef signed __int32 Sint32;
+typedef unsigned __int64 Uint64;
+typedef signed __int64 Sint64;
+
+#    define PRId64 "I64d"
+#    define PRIu64 "I64u"
+#    define PRIx64 "I64x"
+#    define SCNd64 "I64d"
+#    define SCNx64 "I64x"
+#else
+#    include <inttypes.h>
+
+typedef uint8_t Uint8;
+typedef int8_t Sint8;
+typedef uint16_t Uint16;
+typedef int16_t Sint16;
+typedef uint32_t Uint32;
+typedef int32_t Sint32;
+typedef uint64_t Uint64;
+typedef int64_t Sint64;
+#endif
+
+typedef struct rw_s rw_t;
+
+/*--- Defines ---*/
+
+/* WORDS_BIGENDIAN comes from configure */
+#if defined(WORDS_BIGENDIAN) \
+    || (defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__))
+#    define RW_BIG_ENDIAN 1
+#endif
+
+/* Values stored as little endian in files, to native order and back */
+#ifdef RW_BIG_ENDIAN
+#    define rw_swap_le16(x) rw_swap16(x)
+#    define rw_swap_le32(x) rw_swap32(x)
+#    define rw_swap_le64(x) rw_swap64(x)
+#else
+#    define rw_swap_le16(x) (x)
+#    define rw_swap_le32(x) (x)
+#    define rw_swap_le64(x) (x)
+#endif
+
+#define RW_SEEK_SET 0
+#define RW_SEEK_CUR 1
+#define RW_SEEK_END 2
+
+/*--- Functions ---*/
+
+Uint16 rw_swap16(Uint16 x);
+Uint32 rw_swap32(Uint32 x);
+Uint64 rw_swap64(Uint64 x);
+
+/*
+    Open a file
+
+    filename	Name of file
+    mode	Mode, as for fopen()
+    Returns NULL on error
+*/
+rw_t* rw_from_file(const char* filename, const char* mode);
+
+/*
+    Read and write a memory block as a file. Writing past end of block
+    fails.
+
+    mem	Block
+    length	Length of block
+    Returns NULL on error
+*/
+rw_t* rw_from_mem(void* mem, size_t length);
+
+/* Returns new position, -1 on error */
+Sint64 rw_seek(rw_t* context, Sint64 offset, int whence);
+Sint64 rw_tell(rw_t* context);
+
+/* Returns number of complete objects read or written */
+size_t rw_read(rw_t* context, void* ptr, size_t size, size_t num);
+size_t rw_write(rw_t* context, const void* ptr, size_t size, size_t num);
+
+/* Returns 0 if closed without error */
+int rw_close(rw_t* context);
+
+/* Read little endian values, 0 is returned on error */
+Uint8 rw_read_u8(rw_t* context);
+Uint16 rw_read_le16(rw_t* context);
+Uint32 rw_read_le32(rw_t* context);
+Uint64 rw_read_le64(rw_t* context);
+
+/* Values from a buffer, in little or big endian order */
+Uint16 rw_get_le16(const Uint8* src);
+Uint32 rw_get_le32(const Uint8* src);
+Uint16 rw_get_be16(const Uint8* src);
+
+/* Write little endian values, returns 1 if written */
+size_t rw_write_le16(rw_t* context, Uint16 value);
+size_t rw_write_le32(rw_t* context, Uint32 value);
+size_t rw_write_le64(rw_t* context, Uint64 value);
+
+#endif /* RW_H */
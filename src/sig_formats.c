@@ -0,0 +1,205 @@
+/*
+    Formats searched by sig_search
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "rw.h"
+
+#include "sig_scan.h"
+#include "sig_formats.h"
+
+/*--- Defines ---*/
+
+/* Playstation VRAM */
+#define VRAM_WIDTH  1024
+#define VRAM_HEIGHT 512
+
+#define TIM_CLUT 0x08 /* Flag of TIM with CLUT block */
+
+#define EMD_SECTIONS 15
+
+#define MAX_VLC_QUANT 63
+
+#define MAX_SLD_LENGTH (1 << 20) /* Depacked length */
+
+/*--- Functions prototypes ---*/
+
+static int check_tim(const Uint8* data, Uint32 avail, Uint32* length);
+static int check_emd(const Uint8* data, Uint32 avail, Uint32* length);
+static int check_bss(const Uint8* data, Uint32 avail, Uint32* length);
+static int check_do3(const Uint8* data, Uint32 avail, Uint32* length);
+static int check_sld(const Uint8* data, Uint32 avail, Uint32* length);
+
+static Uint32 get_tim_block_length(const Uint8* block, Uint32 avail);
+
+/*--- Variables ---*/
+
+const sig_format_t sig_formats[] = {
+    /* Magic, then type: 4, 8, 16 or 24 bits, with CLUT flag */
+    { "tim", "TIM image", 8, { 0x10, 0, 0, 0, 0x00, 0, 0, 0 },
+        { 0xff, 0xff, 0xff, 0xff, 0xf4, 0xff, 0xff, 0xff }, 1, check_tim },
+    /* Offset of directory, then number of sections */
+    { "emd", "EMD model", 8, { 0, 0, 0, 0, EMD_SECTIONS, 0, 0, 0 },
+        { 0x03, 0, 0, 0xff, 0xff, 0xff, 0xff, 0xff }, 1, check_emd },
+    /* Length, VLC_ID, quantization, version 2 or 3 */
+    { "bss", "BSS image", 8, { 0, 0, 0x00, 0x38, 0, 0, 0x02, 0 },
+        { 0, 0, 0xff, 0xff, 0xc0, 0xff, 0xfe, 0xff }, 4, check_bss },
+    { "do3", "DO3 door model", 8, { 0x08, 0x14, 0x60, 0x00, 0x08, 0x24, 0x61, 0x00 },
+        { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff }, 4, check_do3 },
+    /* Number of blocks, then literal block with start of TIM */
+    { "sld", "SLD packed TIM", 9, { 0, 0, 0, 0, 0x80, 0x10, 0, 0, 0 },
+        { 0, 0, 0xff, 0xff, 0x80, 0xff, 0xff, 0xff, 0xff }, 1, check_sld },
+};
+
+const int sig_formats_count = sizeof(sig_formats) / sizeof(sig_format_t);
+
+/*--- Functions ---*/
+
+static int check_tim(const Uint8* data, Uint32 avail, Uint32* length) {
+    Uint32 type = data[4], offset = 8, block_length;
+
+    /* 4 and 8 bits images need a CLUT */
+    if (((type & 3) < 2) && !(type & TIM_CLUT)) {
+        return 0;
+    }
+
+    if (type & TIM_CLUT) {
+        block_length = get_tim_block_length(&data[offset], avail - offset);
+        if (block_length == 0) {
+            return 0;
+        }
+        offset += block_length;
+    }
+
+    block_length = get_tim_block_length(&data[offset], avail - offset);
+    if (block_length == 0) {
+        return 0;
+    }
+
+    *length = offset + block_length;
+    return 1;
+}
+
+/*
+    Length of a TIM block: length, x, y, width, height, all in VRAM.
+    Returns 0 if block is not valid or not in buffer.
+*/
+static Uint32 get_tim_block_length(const Uint8* block, Uint32 avail) {
+    Uint32 length, x, y, width, height;
+
+    if (avail < 12) {
+        return 0;
+    }
+
+    length = rw_get_le32(block);
+    x = rw_get_le16(&block[4]);
+    y = rw_get_le16(&block[6]);
+    width = rw_get_le16(&block[8]);
+    height = rw_get_le16(&block[10]);
+
+    if ((width == 0) || (height == 0) || (x + width > VRAM_WIDTH) || (y + height > VRAM_HEIGHT)) {
+        return 0;
+    }
+    if ((length != 12 + 2 * width * height) || (length > avail)) {
+        return 0;
+    }
+    return length;
+}
+
+/* Directory of sections at end of file, sections are before it */
+static int check_emd(const Uint8* data, Uint32 avail, Uint32* length) {
+    Uint32 dir_offset = rw_get_le32(data);
+    int i;
+
+    if ((dir_offset < 8 + 4) || (dir_offset > avail) || (avail - dir_offset < 4 * EMD_SECTIONS)) {
+        return 0;
+    }
+
+    for (i = 0; i < EMD_SECTIONS; i++) {
+        Uint32 offset = rw_get_le32(&data[dir_offset + 4 * i]);
+
+        if ((offset < 8) || (offset >= dir_offset)) {
+            return 0;
+        }
+    }
+
+    *length = dir_offset + 4 * EMD_SECTIONS;
+    return 1;
+}
+
+/* Length of packed data is only known after depacking */
+static int check_bss(const Uint8* data, Uint32 avail, Uint32* length) {
+    Uint16 quant = rw_get_le16(&data[4]);
+
+    if ((rw_get_le16(data) == 0) || (quant == 0) || (quant > MAX_VLC_QUANT)) {
+        return 0;
+    }
+    return 1;
+}
+
+/* Whole magic is checked, length is unknown */
+static int check_do3(const Uint8* data, Uint32 avail, Uint32* length) {
+    return 1;
+}
+
+/* Follow blocks without depacking, copies must be from depacked data */
+static int check_sld(const Uint8* data, Uint32 avail, Uint32* length) {
+    Uint32 num_blocks = rw_get_le32(data), src_pos = 4, dst_pos = 0, i;
+
+    /* At least TIM header and one block */
+    if (num_blocks < 2) {
+        return 0;
+    }
+
+    for (i = 0; i < num_blocks; i++) {
+        Uint32 count, offset;
+
+        if (src_pos >= avail) {
+            return 0;
+        }
+
+        if (data[src_pos] & 0x80) {
+            count = data[src_pos++] & 0x7f;
+            src_pos += count;
+        } else {
+            if (src_pos + 2 > avail) {
+                return 0;
+            }
+            offset = (data[src_pos] << 8) | data[src_pos + 1];
+            src_pos += 2;
+            count = (offset >> 11) + 2;
+            offset = (offset & 0x7ff) + 4;
+            if (offset > dst_pos) {
+                return 0;
+            }
+        }
+
+        dst_pos += count;
+        if ((src_pos > avail) || (dst_pos > MAX_SLD_LENGTH)) {
+            return 0;
+        }
+    }
+
+    /* Room for TIM header and one block header */
+    if (dst_pos < 8 + 12) {
+        return 0;
+    }
+
+    *length = src_pos;
+    return 1;
+}
@@ -0,0 +1,35 @@
+/*
+    Formats searched by sig_search
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef SIG_FORMATS_H
+#define SIG_FORMATS_H
+
+/*--- Defines ---*/
+
+/* Structures checked by formats are in this many bytes from file start */
+#define SIG_FORMATS_WINDOW (2 << 20)
+
+/*--- Variables ---*/
+
+/* New formats are added at end of table */
+extern const sig_format_t sig_formats[];
+extern const int sig_formats_count;
+
+#endif /* SIG_FORMATS_H */
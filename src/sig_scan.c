@@ -0,0 +1,230 @@
+/*
+    Search signatures of files at any offset of a buffer
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#include "rw.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#    include <emmintrin.h>
+#    define HAVE_SIG_SSE2 1
+#endif
+
+#include "sig_scan.h"
+
+/*--- Defines ---*/
+
+#define MAX_FORMATS 32
+
+/*--- Types ---*/
+
+/* Candidates are offsets where both anchor bytes match */
+typedef struct {
+    const sig_format_t* format;
+    int anchor[2];
+} sig_entry_t;
+
+struct sig_scan_s {
+#ifdef HAVE_SIG_SSE2
+    __m128i anchors[MAX_FORMATS][2]; /* Anchor bytes, in each lane */
+#endif
+    int count;
+    sig_entry_t entries[MAX_FORMATS];
+};
+
+/*--- Functions prototypes ---*/
+
+static int sig_choose_anchors(sig_entry_t* entry);
+static int sig_try(const sig_entry_t* entry, const Uint8* data, Uint32 offset, Uint32 length,
+    Uint32 base, Uint32* file_length);
+
+/*--- Functions ---*/
+
+sig_scan_t* sig_scan_open(const sig_format_t* formats, int count) {
+    sig_scan_t* scan;
+    int i;
+
+    if (count > MAX_FORMATS) {
+        fprintf(stderr, "Too many formats to search\n");
+        return NULL;
+    }
+
+    scan = (sig_scan_t*) calloc(1, sizeof(sig_scan_t));
+    if (!scan) {
+        fprintf(stderr, "Can not allocate memory for search\n");
+        return NULL;
+    }
+
+    for (i = 0; i < count; i++) {
+        sig_entry_t* entry = &scan->entries[i];
+
+        entry->format = &formats[i];
+        if (!sig_choose_anchors(entry)) {
+            fprintf(stderr, "%s: no byte to search for\n", formats[i].name);
+            free(scan);
+            return NULL;
+        }
+#ifdef HAVE_SIG_SSE2
+        scan->anchors[i][0] = _mm_set1_epi8((char) formats[i].magic[entry->anchor[0]]);
+        scan->anchors[i][1] = _mm_set1_epi8((char) formats[i].magic[entry->anchor[1]]);
+#endif
+    }
+    scan->count = count;
+
+    return scan;
+}
+
+/* Bytes compared whole, preferring values which are not 0 or 0xff */
+static int sig_choose_anchors(sig_entry_t* entry) {
+    const sig_format_t* format = entry->format;
+    int i, pass, num_anchors = 0;
+
+    if ((format->magic_length <= 0) || (format->magic_length > SIG_MAX_MAGIC)) {
+        return 0;
+    }
+
+    for (pass = 0; (pass < 2) && (num_anchors < 2); pass++) {
+        for (i = 0; (i < format->magic_length) && (num_anchors < 2); i++) {
+            int common = (format->magic[i] == 0) || (format->magic[i] == 0xff);
+
+            if ((format->mask[i] != 0xff) || (common != pass)) {
+                continue;
+            }
+            if ((num_anchors == 1) && (entry->anchor[0] == i)) {
+                continue;
+            }
+            entry->anchor[num_anchors++] = i;
+        }
+    }
+
+    if (num_anchors == 0) {
+        return 0;
+    }
+    if (num_anchors == 1) {
+        entry->anchor[1] = entry->anchor[0];
+    }
+    return 1;
+}
+
+Uint32 sig_scan(sig_scan_t* scan, const Uint8* data, Uint32 start, Uint32 end, Uint32 length,
+    Uint32 base, sig_found_f found, void* user) {
+    Uint32 pos = start, file_length = 0;
+    int i;
+
+#ifdef HAVE_SIG_SSE2
+    /* 16 offsets at a time, while anchors can be loaded */
+    while ((pos + 16 <= end) && (pos + 16 + SIG_MAX_MAGIC <= length)) {
+        int candidates[MAX_FORMATS], any = 0, bit;
+        Uint32 next = pos + 16;
+
+        for (i = 0; i < scan->count; i++) {
+            const sig_entry_t* entry = &scan->entries[i];
+            __m128i a = _mm_loadu_si128((const __m128i*) &data[pos + entry->anchor[0]]);
+            __m128i b = _mm_loadu_si128((const __m128i*) &data[pos + entry->anchor[1]]);
+
+            a = _mm_cmpeq_epi8(a, scan->anchors[i][0]);
+            b = _mm_cmpeq_epi8(b, scan->anchors[i][1]);
+            candidates[i] = _mm_movemask_epi8(_mm_and_si128(a, b));
+            any |= candidates[i];
+        }
+
+        for (bit = 0; any; bit++, any >>= 1) {
+            if (!(any & 1)) {
+                continue;
+            }
+
+            for (i = 0; i < scan->count; i++) {
+                if (!(candidates[i] & (1 << bit))) {
+                    continue;
+                }
+                if (!sig_try(
+                        &scan->entries[i], data, pos + bit, length, base, &file_length)) {
+                    continue;
+                }
+
+                found(user, scan->entries[i].format, pos + bit, file_length);
+                if (file_length) {
+                    break;
+                }
+            }
+
+            /* Candidates inside file found are skipped */
+            if ((i < scan->count) && file_length) {
+                next = pos + bit + file_length;
+                if (next >= pos + 16) {
+                    break;
+                }
+                any >>= next - (pos + bit) - 1;
+                bit = next - pos - 1;
+            }
+        }
+
+        pos = next;
+    }
+#endif
+
+    while (pos < end) {
+        Uint32 next = pos + 1;
+
+        for (i = 0; i < scan->count; i++) {
+            if (!sig_try(&scan->entries[i], data, pos, length, base, &file_length)) {
+                continue;
+            }
+
+            found(user, scan->entries[i].format, pos, file_length);
+            if (file_length) {
+                next = pos + file_length;
+                break;
+            }
+        }
+
+        pos = next;
+    }
+
+    return pos;
+}
+
+/* Compare magic bytes, then let format check structure */
+static int sig_try(const sig_entry_t* entry, const Uint8* data, Uint32 offset, Uint32 length,
+    Uint32 base, Uint32* file_length) {
+    const sig_format_t* format = entry->format;
+    int i;
+
+    if ((offset + format->magic_length > length) || ((base + offset) % format->align)) {
+        return 0;
+    }
+    for (i = 0; i < format->magic_length; i++) {
+        if ((data[offset + i] ^ format->magic[i]) & format->mask[i]) {
+            return 0;
+        }
+    }
+
+    *file_length = 0;
+    return format->check(&data[offset], length - offset, file_length);
+}
+
+void sig_scan_close(sig_scan_t* scan) {
+    free(scan);
+}
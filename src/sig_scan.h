@@ -0,0 +1,88 @@
+/*
+    Search signatures of files at any offset of a buffer
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef SIG_SCAN_H
+#define SIG_SCAN_H
+
+/*--- Defines ---*/
+
+#define SIG_MAX_MAGIC 16
+
+/*--- Types ---*/
+
+/*
+    Check structure of a file found at data, avail bytes can be read,
+    magic_length bytes at least.
+    Returns 0 if not valid, else sets length of file (0 if unknown).
+*/
+typedef int (*sig_check_f)(const Uint8* data, Uint32 avail, Uint32* length);
+
+typedef struct {
+    const char* name;        /* Short name, also extension of extracted files */
+    const char* description;
+    int magic_length;
+    Uint8 magic[SIG_MAX_MAGIC];
+    Uint8 mask[SIG_MAX_MAGIC]; /* Bits of magic to compare, one byte at least must be 0xff */
+    int align;                 /* Alignment of file start, 1 for any byte */
+    sig_check_f check;
+} sig_format_t;
+
+/*
+    Called for each file found, offset in buffer, length 0 if unknown
+*/
+typedef void (*sig_found_f)(void* user, const sig_format_t* format, Uint32 offset, Uint32 length);
+
+typedef struct sig_scan_s sig_scan_t;
+
+/*--- Functions ---*/
+
+/*
+    Prepare search for a table of formats
+
+    formats	Formats to search, must stay valid until sig_scan_close()
+    count	Number of formats
+    Returns NULL if a format has no byte to search for, or too many formats
+*/
+sig_scan_t* sig_scan_open(const sig_format_t* formats, int count);
+
+/*
+    Search files starting in a buffer. Candidates are found 16 bytes at a
+    time with SSE2, then checked by their format. Search continues after
+    files of known length.
+
+    scan	Search
+    data	Buffer
+    start	First offset to search
+    end		Offset after last one to search
+    length	Length of buffer, files found may use bytes up to it
+    base	Offset of buffer in file, low 32 bits are enough for alignment
+    found	Called for each file found
+    user	Passed to found
+    Returns offset in buffer where search must continue, may be after end
+*/
+Uint32 sig_scan(sig_scan_t* scan, const Uint8* data, Uint32 start, Uint32 end, Uint32 length,
+    Uint32 base, sig_found_f found, void* user);
+
+/*
+    Free search
+*/
+void sig_scan_close(sig_scan_t* scan);
+
+#endif /* SIG_SCAN_H */
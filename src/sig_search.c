@@ -0,0 +1,310 @@
+/*
+    Search files at any offset of archives or CD-ROM images
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#include "rw.h"
+
+#include "param.h"
+#include "sig_scan.h"
+#include "sig_formats.h"
+#include "convert.h"
+#include "applets.h"
+
+/*--- Defines ---*/
+
+#define CHUNK_SIZE  (8 << 20) /* Bytes searched after each read */
+#define DATA_LENGTH 2048      /* User data of CD-ROM sector */
+
+#define MAX_FORMATS 32
+
+/*--- Types ---*/
+
+typedef struct {
+    rw_t* src;
+    int block_size;  /* 0 for a file, else size of sectors of CD-ROM image */
+    int data_offset; /* Offset of user data in sector */
+    Uint8* sectors;  /* Sectors read, user data is copied to buffer */
+    int eof;
+    Uint8* buffer; /* Data searched */
+    Uint32 length; /* Bytes in buffer */
+    Uint64 base;   /* Offset of buffer in data */
+    int num_found;
+} search_t;
+
+/*--- Variables ---*/
+
+/* Extract files */
+static int extract_files = 0;
+
+/* Convert files found in this directory, without writing them first */
+static const char* convert_dir = NULL;
+
+/* Formats searched, all by default */
+static sig_format_t formats[MAX_FORMATS];
+static int num_formats = 0;
+
+/*--- Functions prototypes ---*/
+
+static int search_file(const char* filename);
+static int get_sector_size(rw_t* src);
+static Uint32 read_data(search_t* search, Uint8* buffer, Uint32 length);
+static void found_file(void* user, const sig_format_t* format, Uint32 offset, Uint32 length);
+static void convert_found_file(
+    search_t* search, const sig_format_t* format, Uint32 offset, Uint32 length);
+
+/*--- Functions ---*/
+
+#ifndef MULTICALL
+int main(int argc, char** argv) {
+    return sig_search_main(argc, argv);
+}
+#endif
+
+int sig_search_main(int argc, char** argv) {
+    int retval, i, j;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s [-e] [-c dir] [-f format]... [-l] /path/to/filename\n", argv[0]);
+        return 1;
+    }
+
+    if (param_check("-l", argc, argv) >= 0) {
+        for (i = 0; i < sig_formats_count; i++) {
+            printf("%s\t%s\n", sig_formats[i].name, sig_formats[i].description);
+        }
+        return 0;
+    }
+    extract_files = 0;
+    convert_dir = NULL;
+    num_formats = 0;
+    if (param_check("-e", argc, argv) >= 0) {
+        extract_files = 1;
+    }
+    i = param_check("-c", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        convert_dir = argv[i + 1];
+        mkdir(convert_dir, 0755);
+        convert_init();
+    }
+
+    for (i = 1; i < argc - 2; i++) {
+        if (strcmp(argv[i], "-f") != 0) {
+            continue;
+        }
+        for (j = 0; j < sig_formats_count; j++) {
+            if (strcmp(argv[i + 1], sig_formats[j].name) == 0) {
+                break;
+            }
+        }
+        if (j == sig_formats_count) {
+            fprintf(stderr, "Unknown format %s, use -l to list them\n", argv[i + 1]);
+            return 1;
+        }
+        if (num_formats < MAX_FORMATS) {
+            formats[num_formats++] = sig_formats[j];
+        }
+    }
+    if (num_formats == 0) {
+        for (i = 0; (i < sig_formats_count) && (i < MAX_FORMATS); i++) {
+            formats[num_formats++] = sig_formats[i];
+        }
+    }
+
+    retval = search_file(argv[argc - 1]);
+
+    if (convert_dir) {
+        convert_quit();
+    }
+
+    return retval;
+}
+
+static int search_file(const char* filename) {
+    search_t search;
+    sig_scan_t* scan;
+    Uint32 length = 0, pos = 0, buflen = CHUNK_SIZE + SIG_FORMATS_WINDOW;
+
+    memset(&search, 0, sizeof(search));
+
+    search.src = rw_from_file(filename, "rb");
+    if (!search.src) {
+        fprintf(stderr, "Can not open %s for reading\n", filename);
+        return 1;
+    }
+
+    /* Only user data of sectors of CD-ROM images is searched */
+    search.block_size = get_sector_size(search.src);
+    if (search.block_size) {
+        printf("Sector size: %d\n", search.block_size);
+        search.data_offset = (search.block_size == 2352 ? 16 + 8 : 8);
+    }
+    rw_seek(search.src, 0, RW_SEEK_SET);
+
+    scan = sig_scan_open(formats, num_formats);
+    search.buffer = (Uint8*) malloc(buflen);
+    if (search.block_size) {
+        search.sectors = (Uint8*) malloc((buflen / DATA_LENGTH) * search.block_size);
+    }
+    if (!scan || !search.buffer || (search.block_size && !search.sectors)) {
+        fprintf(stderr, "Can not allocate memory to search file\n");
+        free(search.sectors);
+        free(search.buffer);
+        sig_scan_close(scan);
+        rw_close(search.src);
+        return 1;
+    }
+
+    for (;;) {
+        Uint32 end;
+
+        length += read_data(&search, &search.buffer[length], buflen - length);
+
+        /* Structures of files starting before end are in buffer */
+        end = (search.eof ? length : length - SIG_FORMATS_WINDOW);
+        search.length = length;
+        pos = sig_scan(
+            scan, search.buffer, pos, end, length, (Uint32) search.base, found_file, &search);
+        if (search.eof) {
+            break;
+        }
+
+        /* Keep bytes not searched yet */
+        memmove(search.buffer, &search.buffer[pos], length - pos);
+        search.base += pos;
+        length -= pos;
+        pos = 0;
+    }
+
+    printf("%d files found\n", search.num_found);
+
+    free(search.sectors);
+    free(search.buffer);
+    sig_scan_close(scan);
+    rw_close(search.src);
+    return 0;
+}
+
+/* Returns 0 if not a raw CD-ROM image */
+static int get_sector_size(rw_t* src) {
+    Uint8 tmp[12];
+    const Uint8 xamode[12] = { 0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0 };
+
+    rw_seek(src, 0, RW_SEEK_SET);
+    if ((rw_read(src, tmp, 12, 1) != 1) || (memcmp(tmp, xamode, 12) != 0)) {
+        return 0;
+    }
+
+    rw_seek(src, 2352, RW_SEEK_SET);
+    if ((rw_read(src, tmp, 12, 1) != 1) || (memcmp(tmp, xamode, 12) != 0)) {
+        return 2336;
+    }
+
+    return 2352;
+}
+
+/* Read data of file, or user data of whole sectors. Returns length read. */
+static Uint32 read_data(search_t* search, Uint8* buffer, Uint32 length) {
+    Uint32 count, i;
+
+    if (!search->block_size) {
+        count = rw_read(search->src, buffer, 1, length);
+        search->eof = (count < length);
+        return count;
+    }
+
+    count = rw_read(search->src, search->sectors, search->block_size, length / DATA_LENGTH);
+    search->eof = (count < length / DATA_LENGTH);
+    for (i = 0; i < count; i++) {
+        memcpy(&buffer[i * DATA_LENGTH],
+            &search->sectors[i * search->block_size + search->data_offset], DATA_LENGTH);
+    }
+    return count * DATA_LENGTH;
+}
+
+static void found_file(void* user, const sig_format_t* format, Uint32 offset, Uint32 length) {
+    search_t* search = (search_t*) user;
+    Uint64 file_offset = search->base + offset;
+    char filename[32];
+    rw_t* dst;
+
+    ++search->num_found;
+
+    if (search->block_size) {
+        printf("Sector %" PRIu64 "+0x%03x: %s", file_offset / DATA_LENGTH,
+            (int) (file_offset % DATA_LENGTH), format->description);
+    } else {
+        printf("Offset 0x%08" PRIx64 ": %s", file_offset, format->description);
+    }
+    if (length) {
+        printf(", %d bytes", length);
+    }
+    printf("\n");
+
+    if (convert_dir) {
+        convert_found_file(search, format, offset, length);
+    }
+
+    /* Files of unknown length are only reported */
+    if (!extract_files || !length) {
+        return;
+    }
+
+    sprintf(filename, "%08" PRIx64 ".%s", file_offset, format->name);
+    dst = rw_from_file(filename, "wb");
+    if (!dst) {
+        fprintf(stderr, "Can not create %s for writing\n", filename);
+        return;
+    }
+
+    rw_write(dst, &search->buffer[offset], length, 1);
+    rw_close(dst);
+}
+
+/* Converted from buffer, files of unknown length may use bytes until its end */
+static void convert_found_file(
+    search_t* search, const sig_format_t* format, Uint32 offset, Uint32 length) {
+    char name[32];
+    int type;
+
+    if (strcmp(format->name, "tim") == 0) {
+        type = CONVERT_TIM;
+    } else if (strcmp(format->name, "emd") == 0) {
+        type = CONVERT_EMD;
+    } else if (strcmp(format->name, "bss") == 0) {
+        type = CONVERT_BSS;
+    } else {
+        return;
+    }
+
+    if (!length) {
+        length = search->length - offset;
+    }
+
+    sprintf(name, "%08" PRIx64, search->base + offset);
+    convert_file(convert_dir, name, type, &search->buffer[offset], length);
+}
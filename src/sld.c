@@ -27,87 +27,293 @@
 #    include "config.h"
 #endif
 
-#include <SDL.h>
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+#    include <fcntl.h>
+#    include <unistd.h>
+#    include <sys/mman.h>
+#    define USE_MMAP 1
+#endif
+
+#include "rw.h"
+#include "thread.h"
 
 #include "file_functions.h"
 #include "depack_sld.h"
+#include "param.h"
+#include "applets.h"
+
+/*--- Defines ---*/
+
+#define MAX_THREADS 64
+
+#define SLD_HEADER_SIZE 8
 
 /*--- Types ---*/
 
 typedef struct {
-    Uint32 unknown;
-    Uint32 length;
-} sld_header_t;
+    Sint64 offset; /* Offset of header in archive */
+    Uint32 length; /* Length of file with header, 0 if empty */
+} sld_file_t;
+
+typedef struct {
+    Uint8* data; /* Archive, mapped or read in memory */
+    Sint64 length;
+    int mapped;
+    sld_file_t* files;
+    int num_files;
+    int next_file; /* Next file to depack */
+    mutex_t* lock;
+} sld_context_t;
 
 /*--- Const ---*/
 
 /*--- Variables ---*/
 
+/* Number of threads depacking files, 0 for one per CPU */
+static int num_threads = 0;
+
 /*--- Function prototypes ---*/
 
-void list_files(const char* filename);
+static int load_archive(sld_context_t* ctxt, const char* filename);
+static void unload_archive(sld_context_t* ctxt);
+static int list_files(sld_context_t* ctxt);
+static void depack_all(sld_context_t* ctxt);
+static int depack_thread(void* data);
 
 /*--- Functions ---*/
 
+#ifndef MULTICALL
 int main(int argc, char** argv) {
+    return sld_main(argc, argv);
+}
+#endif
+
+int sld_main(int argc, char** argv) {
+    sld_context_t ctxt;
+    int i;
+
     if (argc < 2) {
-        fprintf(stderr, "Usage: %s /path/to/file.sld\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-j threads] /path/to/file.sld\n", argv[0]);
         return 1;
     }
 
-    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
-        fprintf(stderr, "Can not initialize SDL: %s\n", SDL_GetError());
-        return 1;
+    num_threads = 0;
+    i = param_check("-j", argc, argv);
+    if ((i >= 0) && (i + 1 < argc - 1)) {
+        num_threads = atoi(argv[i + 1]);
     }
-    atexit(SDL_Quit);
 
-    list_files(argv[1]);
+    memset(&ctxt, 0, sizeof(ctxt));
+    if (load_archive(&ctxt, argv[argc - 1])) {
+        if (list_files(&ctxt)) {
+            depack_all(&ctxt);
+        }
+        free(ctxt.files);
+        unload_archive(&ctxt);
+    }
 
-    SDL_Quit();
     return 0;
 }
 
-void list_files(const char* filename) {
-    SDL_RWops* src;
-    sld_header_t sld_hdr;
-    Uint32 offset;
-    int i;
+/* Archive is mapped if possible, depackers read it directly */
+static int load_archive(sld_context_t* ctxt, const char* filename) {
+    rw_t* src;
+
+#ifdef USE_MMAP
+    {
+        struct stat st;
+        int fd = open(filename, O_RDONLY);
+
+        if (fd >= 0) {
+            if ((fstat(fd, &st) == 0) && (st.st_size > 0) && ((Uint64) st.st_size <= (size_t) -1)) {
+                void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
 
-    src = SDL_RWFromFile(filename, "rb");
+                if (data != MAP_FAILED) {
+                    close(fd);
+                    ctxt->data = (Uint8*) data;
+                    ctxt->length = st.st_size;
+                    ctxt->mapped = 1;
+                    return 1;
+                }
+            }
+            close(fd);
+        }
+    }
+#endif
+
+    src = rw_from_file(filename, "rb");
     if (!src) {
         fprintf(stderr, "Can not open %s\n", filename);
-        return;
+        return 0;
     }
 
-    offset = 0;
-    i = 0;
-    while (SDL_RWread(src, &sld_hdr, sizeof(sld_header_t), 1)) {
-        int fileLen = SDL_SwapLE32(sld_hdr.length);
+    rw_seek(src, 0, RW_SEEK_END);
+    ctxt->length = rw_tell(src);
+    rw_seek(src, 0, RW_SEEK_SET);
 
-        if (fileLen) {
-            Uint8* dstBuffer;
-            int dstBufLen;
-            char filename_tim[512];
+    if ((ctxt->length <= 0) || ((Uint64) ctxt->length > (size_t) -1)) {
+        fprintf(stderr, "Can not read %s\n", filename);
+        rw_close(src);
+        return 0;
+    }
 
-            sprintf(filename_tim, "tim%02x.tim", i);
-            printf("Depacking file %d to %s\n", i, filename_tim);
+    ctxt->data = (Uint8*) malloc(ctxt->length);
+    if (!ctxt->data) {
+        fprintf(stderr, "Can not allocate %" PRId64 " bytes in memory\n", ctxt->length);
+        rw_close(src);
+        return 0;
+    }
+
+    if (rw_read(src, ctxt->data, ctxt->length, 1) != 1) {
+        fprintf(stderr, "Can not read %s\n", filename);
+        free(ctxt->data);
+        ctxt->data = NULL;
+        rw_close(src);
+        return 0;
+    }
+
+    rw_close(src);
+    return 1;
+}
+
+static void unload_archive(sld_context_t* ctxt) {
+#ifdef USE_MMAP
+    if (ctxt->mapped) {
+        munmap(ctxt->data, ctxt->length);
+    } else
+#endif
+    {
+        free(ctxt->data);
+    }
+    ctxt->data = NULL;
+}
+
+/* Headers are read from memory, files are depacked later */
+static int list_files(sld_context_t* ctxt) {
+    Sint64 offset = 0;
+    int i = 0;
 
-            sld_depack(src, &dstBuffer, &dstBufLen);
-            if (dstBuffer && dstBufLen) {
-                save_file(filename_tim, dstBuffer, dstBufLen);
+    while (offset + SLD_HEADER_SIZE <= ctxt->length) {
+        const Uint8* header = &ctxt->data[offset];
+        Uint32 fileLen = header[4] | (header[5] << 8) | (header[6] << 16) | ((Uint32) header[7] << 24);
+        sld_file_t* file;
 
-                free(dstBuffer);
+        if (fileLen) {
+            if (fileLen < SLD_HEADER_SIZE) {
+                fprintf(stderr, "File %d: invalid length\n", i);
+                break;
             }
+            printf("Depacking file %d to tim%02x.tim\n", i, i);
         } else {
             printf("File %d is empty\n", i);
-            fileLen = 8;
         }
 
+        file = (sld_file_t*) realloc(ctxt->files, (ctxt->num_files + 1) * sizeof(sld_file_t));
+        if (!file) {
+            fprintf(stderr, "Can not allocate memory for file list\n");
+            return 0;
+        }
+        ctxt->files = file;
+        file = &ctxt->files[ctxt->num_files++];
+        file->offset = offset;
+        file->length = fileLen;
+
         /* Next file */
-        offset += fileLen;
-        SDL_RWseek(src, offset, RW_SEEK_SET);
+        offset += (fileLen ? fileLen : SLD_HEADER_SIZE);
         i++;
     }
 
-    SDL_RWclose(src);
+    return 1;
+}
+
+/* Files are independent, each thread depacks the next one */
+static void depack_all(sld_context_t* ctxt) {
+    thread_t* threads[MAX_THREADS];
+    int i, count = num_threads;
+
+    ctxt->lock = mutex_create();
+    if (!ctxt->lock) {
+        fprintf(stderr, "Can not create mutex\n");
+        return;
+    }
+
+    if (count <= 0) {
+        count = cpu_count();
+    }
+    if (count > MAX_THREADS) {
+        count = MAX_THREADS;
+    }
+    if (count > ctxt->num_files) {
+        count = ctxt->num_files;
+    }
+
+    for (i = 0; i < count; i++) {
+        threads[i] = thread_create(depack_thread, ctxt);
+        if (!threads[i]) {
+            break;
+        }
+    }
+    count = i;
+
+    if (count == 0) {
+        depack_thread(ctxt);
+    }
+    for (i = 0; i < count; i++) {
+        thread_wait(threads[i]);
+    }
+
+    mutex_destroy(ctxt->lock);
+}
+
+/* Each thread depacks to its own buffer, grown for largest file */
+static int depack_thread(void* data) {
+    sld_context_t* ctxt = (sld_context_t*) data;
+    Uint8* dstBuffer = NULL;
+    size_t dstCapacity = 0;
+
+    for (;;) {
+        sld_file_t* file;
+        const Uint8* src;
+        Sint64 length;
+        size_t dstBufLen;
+        char filename_tim[512];
+        int i;
+
+        mutex_lock(ctxt->lock);
+        i = ctxt->next_file++;
+        mutex_unlock(ctxt->lock);
+        if (i >= ctxt->num_files) {
+            break;
+        }
+
+        file = &ctxt->files[i];
+        if (!file->length) {
+            continue;
+        }
+
+        /* Last file may be truncated */
+        src = &ctxt->data[file->offset + SLD_HEADER_SIZE];
+        length = file->length - SLD_HEADER_SIZE;
+        if (file->offset + file->length > ctxt->length) {
+            length = ctxt->length - file->offset - SLD_HEADER_SIZE;
+        }
+
+        dstBufLen = sld_depack_size(src, length);
+        if (dstBufLen > dstCapacity) {
+            free(dstBuffer);
+            dstBuffer = (Uint8*) malloc(dstBufLen);
+            dstCapacity = (dstBuffer ? dstBufLen : 0);
+        }
+
+        dstBufLen = (dstBuffer ? sld_depack_span(src, length, dstBuffer, dstCapacity) : 0);
+        if (dstBufLen) {
+            sprintf(filename_tim, "tim%02x.tim", i);
+            save_file(filename_tim, dstBuffer, dstBufLen);
+        } else {
+            fprintf(stderr, "File %d: can not depack\n", i);
+        }
+    }
+
+    free(dstBuffer);
+    return 0;
 }
@@ -0,0 +1,238 @@
+/*
+    Threads, mutexes and condition variables
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include <stdlib.h>
+
+#ifdef HAVE_CONFIG_H
+#    include "config.h"
+#endif
+
+#ifdef WIN32
+/* Condition variables need Windows Vista */
+#    ifndef _WIN32_WINNT
+#        define _WIN32_WINNT 0x0600
+#    endif
+#    include <windows.h>
+#else
+#    include <pthread.h>
+#    include <unistd.h>
+#endif
+
+#include "thread.h"
+
+/*--- Types ---*/
+
+struct thread_s {
+#ifdef WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+    thread_func_t fn;
+    void* data;
+};
+
+struct mutex_s {
+#ifdef WIN32
+    CRITICAL_SECTION handle;
+#else
+    pthread_mutex_t handle;
+#endif
+};
+
+struct cond_s {
+#ifdef WIN32
+    CONDITION_VARIABLE handle;
+#else
+    pthread_cond_t handle;
+#endif
+};
+
+/*--- Functions prototypes ---*/
+
+#ifdef WIN32
+static DWORD WINAPI run_thread(LPVOID data);
+#else
+static void* run_thread(void* data);
+#endif
+
+/*--- Functions ---*/
+
+thread_t* thread_create(thread_func_t fn, void* data) {
+    thread_t* thread;
+
+    thread = (thread_t*) malloc(sizeof(thread_t));
+    if (!thread) {
+        return NULL;
+    }
+    thread->fn = fn;
+    thread->data = data;
+
+#ifdef WIN32
+    thread->handle = CreateThread(NULL, 0, run_thread, thread, 0, NULL);
+    if (!thread->handle) {
+        free(thread);
+        return NULL;
+    }
+#else
+    if (pthread_create(&thread->handle, NULL, run_thread, thread) != 0) {
+        free(thread);
+        return NULL;
+    }
+#endif
+
+    return thread;
+}
+
+void thread_wait(thread_t* thread) {
+#ifdef WIN32
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+#else
+    pthread_join(thread->handle, NULL);
+#endif
+    free(thread);
+}
+
+#ifdef WIN32
+static DWORD WINAPI run_thread(LPVOID data) {
+    thread_t* thread = (thread_t*) data;
+
+    return (DWORD) thread->fn(thread->data);
+}
+#else
+static void* run_thread(void* data) {
+    thread_t* thread = (thread_t*) data;
+
+    thread->fn(thread->data);
+    return NULL;
+}
+#endif
+
+mutex_t* mutex_create(void) {
+    mutex_t* mutex;
+
+    mutex = (mutex_t*) malloc(sizeof(mutex_t));
+    if (!mutex) {
+        return NULL;
+    }
+
+#ifdef WIN32
+    InitializeCriticalSection(&mutex->handle);
+#else
+    if (pthread_mutex_init(&mutex->handle, NULL) != 0) {
+        free(mutex);
+        return NULL;
+    }
+#endif
+
+    return mutex;
+}
+
+void mutex_destroy(mutex_t* mutex) {
+    if (!mutex) {
+        return;
+    }
+
+#ifdef WIN32
+    DeleteCriticalSection(&mutex->handle);
+#else
+    pthread_mutex_destroy(&mutex->handle);
+#endif
+    free(mutex);
+}
+
+void mutex_lock(mutex_t* mutex) {
+#ifdef WIN32
+    EnterCriticalSection(&mutex->handle);
+#else
+    pthread_mutex_lock(&mutex->handle);
+#endif
+}
+
+void mutex_unlock(mutex_t* mutex) {
+#ifdef WIN32
+    LeaveCriticalSection(&mutex->handle);
+#else
+    pthread_mutex_unlock(&mutex->handle);
+#endif
+}
+
+cond_t* cond_create(void) {
+    cond_t* cond;
+
+    cond = (cond_t*) malloc(sizeof(cond_t));
+    if (!cond) {
+        return NULL;
+    }
+
+#ifdef WIN32
+    InitializeConditionVariable(&cond->handle);
+#else
+    if (pthread_cond_init(&cond->handle, NULL) != 0) {
+        free(cond);
+        return NULL;
+    }
+#endif
+
+    return cond;
+}
+
+void cond_destroy(cond_t* cond) {
+    if (!cond) {
+        return;
+    }
+
+#ifndef WIN32
+    pthread_cond_destroy(&cond->handle);
+#endif
+    free(cond);
+}
+
+void cond_wait(cond_t* cond, mutex_t* mutex) {
+#ifdef WIN32
+    SleepConditionVariableCS(&cond->handle, &mutex->handle, INFINITE);
+#else
+    pthread_cond_wait(&cond->handle, &mutex->handle);
+#endif
+}
+
+void cond_broadcast(cond_t* cond) {
+#ifdef WIN32
+    WakeAllConditionVariable(&cond->handle);
+#else
+    pthread_cond_broadcast(&cond->handle);
+#endif
+}
+
+int cpu_count(void) {
+    int count = 1;
+
+#if defined(WIN32)
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    count = (int) info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    count = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return (count > 0 ? count : 1);
+}
@@ -0,0 +1,55 @@
+/*
+    Threads, mutexes and condition variables
+
+    Copyright (C) 2010	Patrice Mandin
+
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef THREAD_H
+#define THREAD_H
+
+/*--- Types ---*/
+
+typedef struct thread_s thread_t;
+typedef struct mutex_s mutex_t;
+typedef struct cond_s cond_t;
+
+typedef int (*thread_func_t)(void* data);
+
+/*--- Functions ---*/
+
+/* Returns NULL on error */
+thread_t* thread_create(thread_func_t fn, void* data);
+
+/* Wait end of thread, and free it */
+void thread_wait(thread_t* thread);
+
+/* Returns NULL on error */
+mutex_t* mutex_create(void);
+void mutex_destroy(mutex_t* mutex);
+void mutex_lock(mutex_t* mutex);
+void mutex_unlock(mutex_t* mutex);
+
+/* Returns NULL on error */
+cond_t* cond_create(void);
+void cond_destroy(cond_t* cond);
+void cond_wait(cond_t* cond, mutex_t* mutex);
+void cond_broadcast(cond_t* cond);
+
+/* Number of online processors, at least 1 */
+int cpu_count(void);
+
+#endif /* THREAD_H */
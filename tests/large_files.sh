@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Files longer than 4GB: files past 4GB must be found and extracted.
+# Files are sparse, test is skipped if filesystem can not hold them.
+
+bindir=`pwd`/${top_builddir:-..}/src
+tmpdir=large_files.tmp
+
+rm -rf $tmpdir
+mkdir $tmpdir || exit 1
+cd $tmpdir || exit 1
+trap 'cd .. && rm -rf $tmpdir' 0
+
+# 16 bits TIM image of 4x4 pixels
+printf '\020\000\000\000\002\000\000\000\054\000\000\000\000\000\000\000\004\000\004\000' >a.tim
+dd if=/dev/zero bs=32 count=1 2>/dev/null >>a.tim
+
+# Image of 4GB+64KB, TIM image at 4GB+4KB
+truncate -s 4295032832 image.dat || exit 77
+dd if=a.tim of=image.dat bs=4096 seek=1048577 conv=notrunc 2>/dev/null || exit 77
+
+$bindir/sig_search image.dat >sig_search.txt || exit 1
+grep "Offset 0x100001000: TIM image, 52 bytes" sig_search.txt >/dev/null || {
+	echo "sig_search: TIM image past 4GB not found"
+	cat sig_search.txt
+	exit 1
+}
+
+# Archive of 4GB+8KB: first file fills 4GB, second one is the TIM image
+bin_header() {
+	dd if=/dev/zero bs=2048 count=1 2>/dev/null >header.tmp
+	printf "$1" | dd of=header.tmp conv=notrunc 2>/dev/null
+	printf "$2" | dd of=header.tmp bs=64 seek=1 conv=notrunc 2>/dev/null
+	dd if=header.tmp of=archive.bin bs=2048 seek=$3 conv=notrunc 2>/dev/null
+}
+
+truncate -s 4294975488 archive.bin || exit 77
+bin_header '\002\000\000\000\000\370\377\377\000\000\040\000' 'FILL.DAT' 0
+bin_header '\002\000\000\000\064\000\000\000\002\000\000\000' 'A.TIM' 2097152
+dd if=a.tim of=archive.bin bs=2048 seek=2097153 conv=notrunc 2>/dev/null || exit 77
+bin_header '\377\377\377\377' '' 2097154
+
+$bindir/extract_bin -x A.TIM archive.bin >extract_bin.txt || {
+	echo "extract_bin: can not extract file past 4GB"
+	cat extract_bin.txt
+	exit 1
+}
+cmp a.tim A.TIM || exit 1
+
+exit 0